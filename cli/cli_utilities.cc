@@ -33,69 +33,17 @@ PsiData * allocateDataFromFile ( std::string fname, int nafc ) {
 }
 
 PsiPsychometric * allocatePsychometric ( std::string core, std::string sigmoid, int nafc, PsiData* data, bool verbose=false ) {
-	PsiSigmoid *psisigmoid;
-	PsiCore *psicore;
-	double alpha;
 	PsiPsychometric * out;
 
-	if ( verbose ) std::cerr << "setting up psychometric function model (";
-
-	if ( !sigmoid.compare("cauchy") ) {
-		if (verbose) std::cerr <<  PsiCauchy::getDescriptor();
-		psisigmoid = new PsiCauchy();
-	} else if ( !sigmoid.compare("exponential") ) {
-		if (verbose) std::cerr <<  PsiExponential::getDescriptor();
-		psisigmoid = new PsiExponential();
-	} else if ( !sigmoid.compare("gauss") ) {
-		if (verbose) std::cerr <<  PsiGauss::getDescriptor();
-		psisigmoid = new PsiGauss();
-	} else if ( !sigmoid.compare("gumbel_l") ) {
-		if (verbose) std::cerr <<  PsiGumbelL::getDescriptor();
-		psisigmoid = new PsiGumbelL();
-	} else if ( !sigmoid.compare("gumbel_r") ) {
-		if (verbose) std::cerr <<  PsiGumbelR::getDescriptor();
-		psisigmoid = new PsiGumbelR();
-	} else if ( !sigmoid.compare("logistic") ) {
-		if (verbose) std::cerr <<  PsiLogistic::getDescriptor();
-		psisigmoid = new PsiLogistic();
-	} else {
-		std::cerr << "Unknown sigmoid " << sigmoid << "\n";
-		exit ( -1 );
-	}
+	if ( verbose ) std::cerr << "setting up psychometric function model (" << sigmoid << "," << core << ") ";
 
-	if ( verbose ) std::cerr << ",";
-
-	if ( !core.compare("ab") ) {
-		if (verbose) std::cerr << abCore::getDescriptor();
-		psicore = new abCore ();
-	} else if ( !core.compare ( 0, 2, "mw" ) ) {
-		alpha = atof ( core.substr( 2, 100 ).c_str() );
-		if (verbose) std::cerr << mwCore::getDescriptor() << alpha;
-		psicore = new mwCore ( data, psisigmoid->getcode(), alpha );
-	} else if ( !core.compare ( "linear" ) ) {
-		if (verbose) std::cerr << linearCore::getDescriptor();
-		psicore = new linearCore ();
-	} else if ( !core.compare ( "log" ) ) {
-		if (verbose) std::cerr << logCore::getDescriptor();
-		psicore = new logCore ( data );
-	} else if ( !core.compare ( "poly" ) ) {
-		if (verbose) std::cerr << polyCore::getDescriptor();
-		psicore = new polyCore ( data );
-	} else if ( !core.compare ( "weibull" ) ) {
-		if (verbose) std::cerr << weibullCore::getDescriptor();
-		psicore = new weibullCore ( data );
-	} else {
-		std::cerr << "Unknown core " << sigmoid << "\n";
+	try {
+		out = allocateSpecializedPsychometric ( core, sigmoid, nafc, data );
+	} catch ( BadArgumentError& e ) {
+		std::cerr << e.message << " " << core << "," << sigmoid << "\n";
 		exit ( -1 );
 	}
 
-	if ( verbose ) std::cerr << ") ";
-
-	out = new PsiPsychometric ( nafc, psicore, psisigmoid );
-
-	delete psisigmoid;
-	delete psicore;
-
 	return out;
 }
 
@@ -147,6 +95,30 @@ void setPriors ( PsiPsychometric * pmf, std::string prior1, std::string prior2,
 	}
 }
 
+PsiFitCache * allocateFitCache ( std::string fname ) {
+	if ( fname=="None" )
+		return NULL;
+	return new PsiFitCache ( fname );
+}
+
+std::string fitCacheKey ( const PsiData * data, const PsiPsychometric * pmf, std::string core, std::string sigmoid, bool gammaislambda,
+		std::string prior1, std::string prior2, std::string prior3, std::string prior4 ) {
+	std::string priors ( prior1 + "," + prior2 + "," + prior3 );
+	if ( pmf->getNparams()>3 ) priors += "," + prior4;
+	return PsiFitCache::makekey ( data, core, sigmoid, gammaislambda, priors, OPTIMIZER_SIMPLEX );
+}
+
+std::string checkpointName ( std::string fname, unsigned int nfile ) {
+	// The first input file uses the name as given, later input files get a checkpoint of their own
+	char suffix[20];
+	if ( fname=="None" )
+		return "";
+	if ( nfile==0 )
+		return fname;
+	sprintf ( suffix, ".%u", nfile+1 );
+	return fname + suffix;
+}
+
 std::vector<double> getCuts ( std::string cuts ) {
 	size_t pos0(0),pos1(0);
 	unsigned int nfound(1);
@@ -341,3 +313,17 @@ void print ( std::vector< std::vector<double> >& theta, bool matlabformat, std::
 		fprintf ( ofile, "\n" );
 	}
 }
+
+std::vector<double> optimizer_report ( const PsiOptimizerReport& report ) {
+	// Columns: evaluations, gradients, iterations, shrinks, simplex size, function value spread, wall time, termination
+	std::vector<double> out ( 8 );
+	out[0] = report.nevaluations;
+	out[1] = report.ngradients;
+	out[2] = report.niterations;
+	out[3] = report.nshrinks;
+	out[4] = report.simplexsize;
+	out[5] = report.fspread;
+	out[6] = report.walltime;
+	out[7] = report.termination;
+	return out;
+}
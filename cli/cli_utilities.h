@@ -14,6 +14,12 @@ PsiPsychometric * allocatePsychometric ( std::string core, std::string sigmoid,
 PsiPrior * allocatePrior ( std::string prior );
 void setPriors ( PsiPsychometric * pmf, std::string prior1, std::string prior2, std::string prior3, std::string prior4 );
 
+PsiFitCache * allocateFitCache ( std::string fname );
+std::string fitCacheKey ( const PsiData * data, const PsiPsychometric * pmf, std::string core, std::string sigmoid, bool gammaislambda,
+		std::string prior1, std::string prior2, std::string prior3, std::string prior4 );
+
+std::string checkpointName ( std::string fname, unsigned int nfile );
+
 std::vector<double> getCuts ( std::string cuts );
 
 void print ( std::vector<double> theta, bool matlabformat, std::string varname, FILE *ofile );
@@ -24,4 +30,6 @@ void print ( std::vector<int> theta, bool matlabformat, std::string varname, FIL
 
 void print_fisher ( PsiPsychometric *pmf, std::vector<double> theta, PsiData *data, FILE* ofile, bool matlabformat );
 
+std::vector<double> optimizer_report ( const PsiOptimizerReport& report );
+
 #endif
@@ -26,11 +26,16 @@ int main ( int argc, char ** argv ) {
 	parser.add_option ( "-nsamples","number of bootstrap samples to be generated","2000" );
 	parser.add_option ( "-o",      "write output to this file", "stdout" );
 	parser.add_option ( "-cuts",   "cuts to be determined", "0.25,0.50,0.75" );
+	parser.add_option ( "-nthreads", "number of threads used to fit the bootstrap samples", "1" );
+	parser.add_option ( "-fitcache", "file in which MAP estimates are cached across invocations (with --optimizer-report, the model is fitted anyway)", "None" );
+	parser.add_option ( "-checkpoint", "file in which the progress is saved (samples go to <file>.samples); an existing checkpoint is resumed (further input files use <file>.2, <file>.3, ...)", "None" );
+	parser.add_option ( "-checkpointinterval", "number of bootstrap samples between checkpoints", "100" );
 	parser.add_switch ( "-v", "display status messages", false );
 	parser.add_switch ( "--summary", "write a short summary to stdout" );
 	parser.add_switch ( "-e", "In yes-no tasks: set gamma==lambda", false );
 	parser.add_switch ( "-nonparametric", "Use nonparametric bootstrap instead of the default parametric bootstrap", false );
 	parser.add_switch ( "--matlab", "format output to be parsable by matlab", false );
+	parser.add_switch ( "--optimizer-report", "write counts of evaluations, gradients, iterations and shrink steps, final simplex size and function value spread, wall time and termination reason (0: simplex size, 1: function values, 2: maximum number of iterations, 3: predicted decrease) of the fits", false );
 
 	parser.parse_args ( argc, argv );
 
@@ -45,6 +50,10 @@ int main ( int argc, char ** argv ) {
 	BootstrapList *bs_list;
 	JackKnifeList *jk_list;
 	unsigned int nsamples ( atoi ( parser.getOptArg("-nsamples").c_str() ) );
+	unsigned int nthreads ( atoi ( parser.getOptArg("-nthreads").c_str() ) );
+	unsigned int checkpointinterval ( atoi ( parser.getOptArg("-checkpointinterval").c_str() ) );
+	unsigned int nfile ( 0 );
+	std::string checkpointfile;
 	double th;
 	double sl;
 	double th_m;
@@ -71,6 +80,9 @@ int main ( int argc, char ** argv ) {
 	std::vector<double> *ci_lower;
 	std::vector<double> *ci_upper;
 	std::vector<double> *devianceresiduals;
+	std::vector< std::vector<double> > mcoptimizer ( nsamples );
+	PsiOptimizerReport report;
+	PsiFitCache * fitcache ( allocateFitCache ( parser.getOptArg ( "-fitcache" ) ) );
 
 	// Use matlabformat?
 	bool matlabformat ( parser.getOptSet ( "--matlab" ) );
@@ -140,7 +152,12 @@ int main ( int argc, char ** argv ) {
 
 		// Determine starting value
 		opt = new PsiOptimizer ( pmf, data );
-		theta = opt->optimize ( pmf, data );
+		// The optimizer report needs a fit: cached estimates would come without one
+		if ( fitcache!=NULL && !parser.getOptSet ( "--optimizer-report" ) )
+			theta = fitcache->fit ( fitCacheKey ( data, pmf, parser.getOptArg ( "-c" ), parser.getOptArg ( "-s" ), parser.getOptSet ( "-e" ),
+						parser.getOptArg ( "-prior1" ), parser.getOptArg ( "-prior2" ), parser.getOptArg ( "-prior3" ), parser.getOptArg ( "-prior4" ) ), pmf, data );
+		else
+			theta = opt->optimize ( pmf, data, NULL, &report );
 
 		// Sample
 		if ( verbose ) {
@@ -148,10 +165,11 @@ int main ( int argc, char ** argv ) {
 			std::cerr << "bs...";
 			std::cerr.flush();
 		}
+		checkpointfile = checkpointName ( parser.getOptArg ( "-checkpoint" ), nfile++ );
 		bs_list = new BootstrapList ( bootstrap ( atoi(parser.getOptArg("-nsamples").c_str()),
-				data, pmf, cuts, &theta,true,!(parser.getOptSet("-nonparametric")) ) );
+				data, pmf, cuts, &theta,true,!(parser.getOptSet("-nonparametric")), nthreads, OPTIMIZER_SIMPLEX, checkpointfile, checkpointinterval ) );
 		if ( verbose ) { std::cerr << "jk..."; std::cerr.flush(); }
-		jk_list = new JackKnifeList ( jackknifedata ( data, pmf ) );
+		jk_list = new JackKnifeList ( jackknifedata ( data, pmf, OPTIMIZER_SIMPLEX, &theta ) );
 		if ( verbose ) { std::cerr << " Done"; std::cerr.flush(); }
 
 		if ( verbose ) std::cerr << "\n";
@@ -168,6 +186,7 @@ int main ( int argc, char ** argv ) {
 		for ( i=0; i<nsamples; i++ ) {
 			(*mcestimates)[i] = bs_list->getEst ( i );
 			(*mcdata)[i]      = bs_list->getData ( i );
+			mcoptimizer[i]    = optimizer_report ( bs_list->getOptimizerReport ( i ) );
 			for ( j=0; j<ncuts; j++ ) {
 				mcthres[i][j] = bs_list->getThres_byPos ( i, j );
 				mcslopes[i][j] = bs_list->getSlope_byPos ( i, j );
@@ -188,6 +207,10 @@ int main ( int argc, char ** argv ) {
 			(*outliers)[i]     = jk_list->outlier ( i );
 		}
 
+		// The bootstrap was started from theta and did not fit the original data itself
+		report.add ( bs_list->getOptimizerTotal () );
+		report.add ( jk_list->getOptimizerTotal () );
+
 		// Write a summary of the parameter estimation if requested.
 		if ( summary ) {
 			std::cerr << "Parameter estimates:\n";
@@ -228,7 +251,9 @@ int main ( int argc, char ** argv ) {
 			// redo bootstrap to obtain goodness of fit form parametric simulations
 			delete bs_list;
 			bs_list = new BootstrapList ( bootstrap ( atoi(parser.getOptArg("-nsamples").c_str()),
-					data, pmf, cuts, &theta, true, true ) );
+					data, pmf, cuts, &theta, true, true, nthreads, OPTIMIZER_SIMPLEX,
+					( checkpointfile.empty() ? "" : checkpointfile+".gof" ), checkpointinterval ) );
+			report.add ( bs_list->getOptimizerTotal () );
 		}
 
 		// Now store everything related to goodness of fit
@@ -268,6 +293,10 @@ int main ( int argc, char ** argv ) {
 		print ( acc_slope,    matlabformat, "acc_slope",   ofile );
 		print ( thresholds,   matlabformat, "thresholds",  ofile );
 		print ( slopes,       matlabformat, "slopes",      ofile );
+		if ( parser.getOptSet ( "--optimizer-report" ) ) {
+			print ( mcoptimizer,  matlabformat, "mcoptimizer", ofile );
+			print ( optimizer_report ( report ), matlabformat, "optimizer", ofile );
+		}
 
 
 		// Get the next input file (if there is one)
@@ -283,5 +312,7 @@ int main ( int argc, char ** argv ) {
 		delete opt;
 	}
 
+	delete fitcache;
+
 	return 0;
 }
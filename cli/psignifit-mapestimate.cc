@@ -25,9 +25,11 @@ int main ( int argc, char ** argv ) {
 	parser.add_option ( "-nafc",   "number of response alternatives in forced choice designs (set this to 1 for yes-no tasks)", "2" );
 	parser.add_option ( "-o",      "write output to this file", "stdout" );
 	parser.add_option ( "-cuts",   "cuts to be determined", "0.25,0.50,0.75" );
+	parser.add_option ( "-fitcache", "file in which MAP estimates are cached across invocations (with --optimizer-report, the model is fitted anyway)", "None" );
 	parser.add_switch ( "-v", "display status messages", false );
 	parser.add_switch ( "-e", "In yes-no tasks: set gamma==lambda", false );
 	parser.add_switch ( "--matlab", "format output to be parsable by matlab", false );
+	parser.add_switch ( "--optimizer-report", "write counts of evaluations, gradients, iterations and shrink steps, final simplex size and function value spread, wall time and termination reason (0: simplex size, 1: function values, 2: maximum number of iterations, 3: predicted decrease) of the fits", false );
 
 	parser.parse_args ( argc, argv );
 
@@ -37,6 +39,8 @@ int main ( int argc, char ** argv ) {
 	PsiPsychometric *pmf;
 	PsiOptimizer * opt;
 	std::vector<double> theta;
+	PsiOptimizerReport report;
+	PsiFitCache * fitcache ( allocateFitCache ( parser.getOptArg ( "-fitcache" ) ) );
 	std::vector<double> cuts (getCuts ( parser.getOptArg("-cuts") ) );
 	unsigned int i;
 
@@ -91,7 +95,12 @@ int main ( int argc, char ** argv ) {
 
 		// Perform the optimization
 		opt = new PsiOptimizer ( pmf, data );
-		theta = opt->optimize ( pmf, data );
+		// The optimizer report needs a fit: cached estimates would come without one
+		if ( fitcache!=NULL && !parser.getOptSet ( "--optimizer-report" ) )
+			theta = fitcache->fit ( fitCacheKey ( data, pmf, parser.getOptArg ( "-c" ), parser.getOptArg ( "-s" ), parser.getOptSet ( "-e" ),
+						parser.getOptArg ( "-prior1" ), parser.getOptArg ( "-prior2" ), parser.getOptArg ( "-prior3" ), parser.getOptArg ( "-prior4" ) ), pmf, data );
+		else
+			theta = opt->optimize ( pmf, data, NULL, &report );
 		// Replace cuts with the derived thresholds at the cuts
 		for ( i=0; i<cuts.size(); i++ ) {
 			cuts[i] = pmf->getThres ( theta, cuts[i] );
@@ -104,6 +113,8 @@ int main ( int argc, char ** argv ) {
 		print_fisher ( pmf, theta, data, ofile, parser.getOptSet ( "--matlab" ) );
 		print ( cuts,                           parser.getOptSet ( "--matlab" ), "thres", ofile );
 		print ( pmf->deviance ( theta, data ),  parser.getOptSet ( "--matlab" ), "deviance", ofile );
+		if ( parser.getOptSet ( "--optimizer-report" ) )
+			print ( optimizer_report ( report ), parser.getOptSet ( "--matlab" ), "optimizer", ofile );
 
 		fname = parser.popArg();
 
@@ -113,5 +124,7 @@ int main ( int argc, char ** argv ) {
 		delete opt;
 	}
 
+	delete fitcache;
+
 	return 0;
 }
@@ -31,24 +31,33 @@ int main ( int argc, char ** argv ) {
 	parser.add_option ( "-prior4",      "prior for the fourth parameter (gamma)", "Uniform(0,.1)" );
 	parser.add_option ( "-nafc",        "number of response alternatives in forced choice designs (set this to 1 for yes-no tasks)", "2" );
 	parser.add_option ( "-nsamples",    "number of markov chain monte carlo samples to be generated","2000" );
+	parser.add_option ( "-burnin",      "number of samples that are discarded at the start of the chain", "1000" );
+	parser.add_option ( "-thin",        "only every n-th sample of the chain is kept", "1" );
 	parser.add_option ( "-o",           "write output to this file", "stdout" );
 	parser.add_option ( "-cuts",        "cuts to be determined", "0.25,0.50,0.75" );
 	parser.add_option ( "-proposal",    "standard deviations of the proposal distribution (or name of file with pilot samples)", "0.1,0.1,0.01" );
 	parser.add_option ( "-start",       "starting values for the sampling process", "mapestimate" );
+	parser.add_option ( "-fitcache", "file in which MAP estimates are cached across invocations", "None" );
+	parser.add_option ( "-tempering",   "number of temperatures for parallel tempering (0 samples from the posterior directly)", "0" );
+	parser.add_option ( "-checkpoint",  "file in which the state of the chain is saved (samples go to <file>.samples); an existing checkpoint is resumed (not for -nuts and -tempering, further input files use <file>.2, <file>.3, ...)", "None" );
+	parser.add_option ( "-checkpointinterval", "number of samples between checkpoints", "1000" );
 	parser.add_switch ( "-v",           "display status messages", false );
 	parser.add_switch ( "--summary",    "write a short summary to stdout" );
 	parser.add_switch ( "-e",           "In yes-no tasks: set gamma==lambda", false );
 	parser.add_switch ( "-generic",     "Use generic metropolis instead of the default standard metropolis hastings", false );
+	parser.add_switch ( "-adaptive",    "Learn the proposal covariance during the burnin (no pilot sample needed, -proposal gives the initial stepwidths)", false );
+	parser.add_switch ( "-nuts",        "Use No-U-Turn sampling with step sizes that are tuned during the burnin (-proposal is ignored)", false );
 	parser.add_switch ( "--matlab",     "format output to be parsable by matlab", false );
 
 	parser.parse_args ( argc, argv );
 
 	// Set up the most important data
-	bool verbose ( parser.getOptSet ( "-v" ) ), pmfshown ( false ), summary ( parser.getOptSet( "--summary" ) ), generic ( parser.getOptSet ( "-generic" ) );
+	bool verbose ( parser.getOptSet ( "-v" ) ), pmfshown ( false ), summary ( parser.getOptSet( "--summary" ) ), generic ( parser.getOptSet ( "-generic" ) ), adaptive ( parser.getOptSet ( "-adaptive" ) ), nuts ( parser.getOptSet ( "-nuts" ) );
 	unsigned int i,j, ncuts, nparams, nblocks;
 	PsiData                    *data;
 	PsiPsychometric            *pmf;
 	PsiOptimizer               *opt;
+	PsiFitCache                *fitcache ( allocateFitCache ( parser.getOptArg ( "-fitcache" ) ) );
 	PsiSampler                 *sampler;
 	std::vector<double>         theta;
 	std::vector<double>         cuts (getCuts ( parser.getOptArg("-cuts") ) );
@@ -57,6 +66,12 @@ int main ( int argc, char ** argv ) {
 	char                        sline[80];
 	MCMCList                   *mcmc_list;
 	unsigned int                nsamples ( atoi ( parser.getOptArg("-nsamples").c_str() ) );
+	unsigned int                burnin ( atoi ( parser.getOptArg("-burnin").c_str() ) );
+	unsigned int                thin ( atoi ( parser.getOptArg("-thin").c_str() ) );
+	unsigned int                ntemperatures ( atoi ( parser.getOptArg("-tempering").c_str() ) );
+	unsigned int                checkpointinterval ( atoi ( parser.getOptArg("-checkpointinterval").c_str() ) );
+	unsigned int                nfile ( 0 );
+	std::string                 checkpointfile;
 	double                      th;
 	double 						sl;
 	double 						th_m;
@@ -128,7 +143,7 @@ int main ( int argc, char ** argv ) {
 	std::vector<double>                 ppdeviance ( nsamples );
 	std::vector<double>                 ppRpd      ( nsamples );
 	std::vector<double>                 ppRkd      ( nsamples );
-	std::vector<double>                 dummydata  ( nsamples/2 );
+	std::vector<double>                 dummydata  ( nsamples );
 	std::vector<double>   thresholds ( ncuts );
 	std::vector<double>   slopes     ( ncuts );
 	std::vector<double>                *influential;
@@ -161,7 +176,12 @@ int main ( int argc, char ** argv ) {
 		std::cerr << "   prm3: " << parser.getOptArg ( "-prior3" ) << "\n";
 		if ( atoi (parser.getOptArg("-nafc").c_str()) < 2 ) std::cerr << "   prm4: " << parser.getOptArg ( "-prior4" ) << "\n";
 		std::cerr << "generic mcmc: " << (parser.getOptSet("-generic")?"yes":"no") << "\n";
+		std::cerr << "adaptive mcmc: " << (adaptive?"yes":"no") << "\n";
+		std::cerr << "no-u-turn sampling: " << (nuts?"yes":"no") << "\n";
+		std::cerr << "temperatures: " << ntemperatures << "\n";
 		std::cerr << "number of mcmc samples: " << nsamples << "\n";
+		std::cerr << "burnin: " << burnin << "\n";
+		std::cerr << "thinning: " << thin << "\n";
 		if ( parser.getOptSet ( "-e" ) )
 			std::cerr << "gamma==lambda\n";
 		std::cerr << "stepwidths:\n";
@@ -177,6 +197,14 @@ int main ( int argc, char ** argv ) {
 		std::cerr << "No input file given --- aborting!\n";
 		exit ( -1 );
 	}
+	if ( parser.getOptArg ( "-checkpoint" )!="None" && ( nuts || ntemperatures>0 ) ) {
+		std::cerr << "Checkpoints are only available for metropolis hastings sampling --- aborting!\n";
+		exit ( -1 );
+	}
+	if ( adaptive && burnin==0 ) {
+		std::cerr << "Adaptive mcmc learns the proposal during the burnin and needs -burnin > 0 --- aborting!\n";
+		exit ( -1 );
+	}
 
 	while ( fname != "" ) {
 		if ( verbose ) std::cerr << "Analyzing input file '" << fname << "'\n   ";
@@ -204,10 +232,22 @@ int main ( int argc, char ** argv ) {
 
 		// Determine starting value
 		opt = new PsiOptimizer ( pmf, data );
-		theta = opt->optimize ( pmf, data );
+		if ( fitcache!=NULL )
+			theta = fitcache->fit ( fitCacheKey ( data, pmf, parser.getOptArg ( "-c" ), parser.getOptArg ( "-s" ), parser.getOptSet ( "-e" ),
+						parser.getOptArg ( "-prior1" ), parser.getOptArg ( "-prior2" ), parser.getOptArg ( "-prior3" ), parser.getOptArg ( "-prior4" ) ), pmf, data );
+		else
+			theta = opt->optimize ( pmf, data );
 		
 		// Set up the sampler
-		if ( generic ) {
+		if ( nuts ) {
+			sampler = new NUTS ( pmf, data );
+		} else if ( ntemperatures>0 ) {
+			sampler = new ParallelTempering ( pmf, data, &proposal, ntemperatures );
+			sampler->setStepSize ( stepwidths );
+		} else if ( adaptive ) {
+			sampler = new AdaptiveMetropolis ( pmf, data, &proposal );
+			sampler->setStepSize ( stepwidths );
+		} else if ( generic ) {
 			sampler = new GenericMetropolis ( pmf, data, &proposal );
 			if ( pilotsample != NULL ) {
 				((GenericMetropolis*)sampler)->findOptimalStepwidth ( *pilotsample );
@@ -219,9 +259,9 @@ int main ( int argc, char ** argv ) {
 			sampler->setStepSize ( stepwidths );
 		}
 		if ( parser.getOptArg ( "-start" ) == "mapestimate" ) {
-			((MetropolisHastings*)sampler)->setTheta ( theta );
+			sampler->setTheta ( theta );
 		} else {
-			((MetropolisHastings*)sampler)->setTheta ( getCuts ( parser.getOptArg ( "-start" ) ) );
+			sampler->setTheta ( getCuts ( parser.getOptArg ( "-start" ) ) );
 		}
 
 		// Sample
@@ -229,7 +269,11 @@ int main ( int argc, char ** argv ) {
 			std::cerr << "Starting sampling ...";
 			std::cerr.flush();
 		}
-		mcmc_list = new MCMCList ( sampler->sample ( nsamples ) );
+		checkpointfile = checkpointName ( parser.getOptArg ( "-checkpoint" ), nfile++ );
+		if ( checkpointfile.empty() )
+			mcmc_list = new MCMCList ( sampler->sample ( nsamples, burnin, thin ) );
+		else
+			mcmc_list = new MCMCList ( sample_checkpointed ( sampler, nsamples, burnin, thin, checkpointfile, checkpointinterval ) );
 
 		if ( verbose ) std::cerr << " Done \n";
 
@@ -252,7 +296,7 @@ int main ( int argc, char ** argv ) {
 		}
 		for ( i=0; i<nblocks; i++ ) {
 			(*influential)[i] = 0;
-			for ( j=nsamples/2; j<nsamples; j++ ) {
+			for ( j=0; j<nsamples; j++ ) {
 				(*influential)[i] += mcmc_list->getlogratio (j,i);
 			}
 		}
@@ -263,29 +307,39 @@ int main ( int argc, char ** argv ) {
 			std::cerr << "--------------------\n";
 			for ( i=0; i<nparams; i++ ) {
 				meanestimate = 0;
-				for ( j=0; j<nsamples/2; j++ ) {
-					dummydata[j] = (*mcestimates)[nsamples/2+j][i];
+				for ( j=0; j<nsamples; j++ ) {
+					dummydata[j] = (*mcestimates)[j][i];
 					meanestimate += dummydata[j];
 				}
 				meanestimate /= nsamples;
-				// Why are the parameter estiamtes so strange?
 				std::cerr << "parameter" << i+1 << " = " << meanestimate << "\tCI_95 = (" << prctile(dummydata,.025) << "," << prctile(dummydata,.975) << ")\n";
 				theta[i] = meanestimate;
 			}
+			if ( ntemperatures>0 ) {
+				std::cerr << "swap rates:";
+				for ( i=0; i+1<ntemperatures; i++ )
+					std::cerr << " " << ((ParallelTempering*)sampler)->getSwapRate ( i );
+				// With an improper prior, the hottest chain does not sample from a distribution and the integral is meaningless
+				if ( parser.getOptArg ( "-prior1" )=="None" || parser.getOptArg ( "-prior2" )=="None" || parser.getOptArg ( "-prior3" )=="None"
+						|| ( nparams>3 && parser.getOptArg ( "-prior4" )=="None" ) )
+					std::cerr << "\nlog evidence not computed: thermodynamic integration requires proper priors on all parameters\n";
+				else
+					std::cerr << "\nlog evidence (thermodynamic integration) = " << ((ParallelTempering*)sampler)->getLogEvidence() << "\n";
+			}
 			std::cerr << "\n";
 			std::cerr << "Threshold estimates:\n";
 			std::cerr << "--------------------\n";
 			for ( i=0; i<ncuts; i++ ) {
 				th = pmf->getThres ( theta, cuts[i] );
 
-				for ( j=0; j<nsamples/2; j++ ) {
-					dummydata[j] = pmf->getThres ( (*mcestimates)[nsamples/2+j], cuts[i] );
+				for ( j=0; j<nsamples; j++ ) {
+					dummydata[j] = mcthres[j][i];
 				}
 				std::cerr << "Threshold(" << cuts[i] << ") = " << th << "\tCI_95 = ("
 					<< prctile(dummydata,.025) << ","
 					<< prctile(dummydata,.975) << ") ";
-				for ( j=0; j<nsamples/2; j++ ) {
-					dummydata[j] = pmf->getSlope ( (*mcestimates)[nsamples/2+j], cuts[i] );
+				for ( j=0; j<nsamples; j++ ) {
+					dummydata[j] = mcslopes[j][i];
 				}
 				std::cerr << "Slope(" << cuts[i] << ") = " << pmf->getSlope ( theta, th ) << "\tCI_95 = ("
 					<< prctile(dummydata,.025) << ","
@@ -317,12 +371,12 @@ int main ( int argc, char ** argv ) {
 			std::cerr << "\n";
 			std::cerr << "Goodness of fit statistics:\n";
 			std::cerr << "---------------------------\n";
-			bayesian_p = 0; for ( i=nsamples/2; i<nsamples; i++ ) bayesian_p += ppdeviance[i] > mcdeviance[i]; bayesian_p /= nsamples/2;
+			bayesian_p = 0; for ( i=0; i<nsamples; i++ ) bayesian_p += ppdeviance[i] > mcdeviance[i]; bayesian_p /= nsamples;
 			std::cerr << "Deviance: " << pmf->deviance ( theta, data ) <<             "\tbayesian_p: " << bayesian_p << "\n";
-			bayesian_p = 0; for ( i=nsamples/2; i<nsamples; i++ ) bayesian_p += ppRpd[i] > mcRpd[i]; bayesian_p /= nsamples/2;
+			bayesian_p = 0; for ( i=0; i<nsamples; i++ ) bayesian_p += ppRpd[i] > mcRpd[i]; bayesian_p /= nsamples;
 			std::cerr << "Rpd:      " << pmf->getRpd (
 					*devianceresiduals, theta, data ) << "\tbayesian_p: " << bayesian_p << ")\n";
-			bayesian_p = 0; for ( i=nsamples/2; i<nsamples; i++ ) bayesian_p += ppRkd[i] > mcRkd[i]; bayesian_p /= nsamples/2;
+			bayesian_p = 0; for ( i=0; i<nsamples; i++ ) bayesian_p += ppRkd[i] > mcRkd[i]; bayesian_p /= nsamples;
 			std::cerr << "Rkd:      " << pmf->getRkd (
 					*devianceresiduals, data ) <<        "\tbayesian_p: " << bayesian_p << ")\n";
 			delete devianceresiduals;
@@ -357,6 +411,7 @@ int main ( int argc, char ** argv ) {
 	}
 
 	if (pilotsample!=NULL) delete pilotsample;
+	delete fitcache;
 
 	return 0;
 }
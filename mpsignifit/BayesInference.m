@@ -206,10 +206,12 @@ scuts = sprintf ( '"%s', num2str ( cuts, '%f,') );
 scuts(length(scuts)) = '"';
 
 % Write the command
-cmd = sprintf ( 'psignifit-mcmc %s %s --matlab -prior1 "%s" -prior2 "%s" -prior3 "%s" %s -nsamples %d -nafc %d -s %s -c %s %s -cuts %s -proposal %s %s', ...
+% The first half of the chain is discarded as burnin by the sampler
+burnin = floor ( samples/2 );
+cmd = sprintf ( 'psignifit-mcmc %s %s --matlab -prior1 "%s" -prior2 "%s" -prior3 "%s" %s -nsamples %d -burnin %d -nafc %d -s %s -c %s %s -cuts %s -proposal %s %s', ...
     verbosity, dataf, ...
     getfield(priors,'m_or_a'), getfield(priors,'w_or_b'), getfield(priors,'lambda'), prior4, ...
-    samples, nafc, sigmoid, core, gil, scuts, stepwidths_or_pilot, generic );
+    samples-burnin, burnin, nafc, sigmoid, core, gil, scuts, stepwidths_or_pilot, generic );
 
 if verbose
     cmd
@@ -228,9 +230,9 @@ results.gammaislambda = gammaislambda;
 results.cuts = cuts;
 results.data = data;
 results.priors = priors;
-results.params_estimate = mean ( results.mcestimates(samples/2:end,:) );
-results.burnin = samples/2;
-results.nsamples = samples;
+results.params_estimate = mean ( results.mcestimates );
+results.burnin = 1;
+results.nsamples = samples-burnin;
 
 % Clean up
 delete ( dataf );
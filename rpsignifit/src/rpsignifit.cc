@@ -2,6 +2,7 @@
 #include <R.h>
 #include <Rmath.h>
 #include <vector>
+#include <algorithm>
 #include <cstdio>
 
 #include <iostream>
@@ -213,20 +214,13 @@ void performbootstrap (
 	BootstrapList bslist ( bootstrap (*nsamples,data,pmf,Cuts,start,true, parametric) );
 	JackKnifeList jack   ( jackknifedata ( data, pmf ) );
 
-	for ( i=0; i<*nsamples; i++ ) {
-		for ( j=0; j<*K; j++ ) {
-			bdata[*K*i + j] = bslist.getData(i)[j];
-		}
-		for ( j=0; j<*nparams; j++ ) {
-			bestimates[*nparams*i + j] = bslist.getEst(i, j);
-		}
-		bdeviances[i] = bslist.getdeviance(i);
-		bRpd[i]       = bslist.getRpd(i);
-		bRkd[i]       = bslist.getRkd(i);
-		for ( j=0; j<*ncuts; j++ ) {
-			bthres[*ncuts*i + j] = bslist.getThres_byPos (i,j);
-		}
-	}
+	// The lists use the same row major layout as the output arrays: copy whole buffers
+	std::copy ( bslist.getDataBuffer(),      bslist.getDataBuffer()      + *nsamples * *K,       bdata );
+	std::copy ( bslist.getEstBuffer(),       bslist.getEstBuffer()       + *nsamples * *nparams, bestimates );
+	std::copy ( bslist.getDevianceBuffer(),  bslist.getDevianceBuffer()  + *nsamples,            bdeviances );
+	std::copy ( bslist.getRpdBuffer(),       bslist.getRpdBuffer()       + *nsamples,            bRpd );
+	std::copy ( bslist.getRkdBuffer(),       bslist.getRkdBuffer()       + *nsamples,            bRkd );
+	std::copy ( bslist.getThresBuffer(),     bslist.getThresBuffer()     + *nsamples * *ncuts,   bthres );
 	for ( j=0; j<*ncuts; j++ ) {
 		acc[j] = bslist.getAcc(j);
 		bias[j] = bslist.getBias(j);
@@ -278,7 +272,7 @@ void performmcmc (
 		double *ppdeviances,   // output: acceleration constants
 		double *logpratio      // output: logposterior ratio (for determination of influential observations)
 		) {
-	int i,j;
+	int i;
 	PsiData * data;
 	PsiPsychometric * pmf;
 
@@ -293,25 +287,16 @@ void performmcmc (
 
 	MCMCList mcmclist ( S.sample( *nsamples ) );
 
-	for ( i=0; i<*nsamples; i++ ) {
-		for ( j=0; j<*nparams; j++ ) {
-			mcmcestimates[*nparams*i + j] = mcmclist.getEst (i, j);
-		}
-		mcmcdeviances[i] = mcmclist.getdeviance ( i );
-		mcmcRpd[i] = mcmclist.getRpd ( i );
-		mcmcRkd[i] = mcmclist.getRkd ( i );
-
-		for ( j=0; j<*K; j++ ) {
-			ppdata[*K*i + j] = mcmclist.getppData ( i, j );
-		}
-		ppRpd[i] = mcmclist.getppRpd ( i );
-		ppRkd[i] = mcmclist.getppRkd ( i );
-		ppdeviances[i] = mcmclist.getppDeviance ( i );
-
-		for ( j=0; j<*K; j++ ) {
-			logpratio[*K*i + j] = mcmclist.getlogratio ( i, j );
-		}
-	}
+	// The lists use the same row major layout as the output arrays: copy whole buffers
+	std::copy ( mcmclist.getEstBuffer(),        mcmclist.getEstBuffer()        + *nsamples * *nparams, mcmcestimates );
+	std::copy ( mcmclist.getDevianceBuffer(),   mcmclist.getDevianceBuffer()   + *nsamples,            mcmcdeviances );
+	std::copy ( mcmclist.getRpdBuffer(),        mcmclist.getRpdBuffer()        + *nsamples,            mcmcRpd );
+	std::copy ( mcmclist.getRkdBuffer(),        mcmclist.getRkdBuffer()        + *nsamples,            mcmcRkd );
+	std::copy ( mcmclist.getppDataBuffer(),     mcmclist.getppDataBuffer()     + *nsamples * *K,       ppdata );
+	std::copy ( mcmclist.getppRpdBuffer(),      mcmclist.getppRpdBuffer()      + *nsamples,            ppRpd );
+	std::copy ( mcmclist.getppRkdBuffer(),      mcmclist.getppRkdBuffer()      + *nsamples,            ppRkd );
+	std::copy ( mcmclist.getppDevianceBuffer(), mcmclist.getppDevianceBuffer() + *nsamples,            ppdeviances );
+	std::copy ( mcmclist.getlogratioBuffer(),   mcmclist.getlogratioBuffer()   + *nsamples * *K,       logpratio );
 }
 
 void getdiagnostics (
@@ -28,7 +28,7 @@ swignifit_sources = ["swignifit/swignifit_raw.cxx"]
 swignifit = Extension('swignifit._swignifit_raw',
         sources = swignifit_sources,
         library_dirs=['src/build'],
-        libraries=['psipp'],
+        libraries=['psipp', 'pthread'],
         include_dirs=["src"])
 
 def main(ext_modules=[swignifit]):
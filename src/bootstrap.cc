@@ -5,6 +5,9 @@
 #include "bootstrap.h"
 #include "getstart.h"
 #include "rng.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <pthread.h>
 
 #ifdef DEBUG_BOOTSTRAP
 #include <iostream>
@@ -45,28 +48,293 @@ void determineBCa ( const std::vector<double>& l_LF, const std::vector<double>&
 	*acc  = E_l3 / (6*var_l*var_l*var_l);
 }
 
-BootstrapList bootstrap ( unsigned int B, const PsiData * data, const PsiPsychometric* model, std::vector<double> cuts, std::vector<double>* param, bool BCa, bool parametric )
+/** \brief everything a bootstrap worker needs to know
+ *
+ * All workers share one instance of this struct. Apart from nextsample (which is protected by lock), workers only
+ * write into the preallocated slots of the output containers that correspond to the bootstrap sample they are working on.
+ */
+struct BootstrapJob {
+	unsigned int B;                                      // samples up to B-1 are processed in the current round
+	unsigned int nextsample;                             // index of the next bootstrap sample that has not been assigned to a worker
+	const PsiData * data;                                // original data
+	const PsiPsychometric * model;                       // model to be fitted
+	const std::vector<double> * cuts;                    // performance levels for thresholds and slopes
+	const std::vector<double> * initialfit;              // starting values (and simplex increments) for all fits
+	const std::vector<double> * p;                       // generating probabilities for the bootstrap samples
+	unsigned long seed;                                  // bootstrap sample b is drawn from substream b of this seed
+	BootstrapList * bootstrapsamples;                    // output
+	std::vector< std::vector<double> > * l_LF;           // least favourable direction for each cut and sample
+	std::vector< std::vector<double> > * u_t;            // thresholds for each cut and sample
+	std::vector< std::vector<double> > * u_s;            // slopes for each cut and sample
+	PsiOptimizerType optimizer;                          // optimization method for the fits
+	bool failed;                                         // did any of the workers encounter an error?
+	pthread_mutex_t lock;
+};
+
+/** \brief draw and fit bootstrap samples until all B samples have been processed
+ *
+ * Each worker owns its own optimizer, its own copy of the data and its own random number stream.
+ */
+void * bootstrap_worker ( void * jobptr ) {
+	BootstrapJob * job ( (BootstrapJob*) jobptr );
+	const PsiPsychometric * model ( job->model );
+	const std::vector<double>& cuts ( *(job->cuts) );
+	unsigned int b, cut;
+	bool good;
+	double deviance;
+	PsiOptimizerReport report, samplereport;
+
+	PsiOptimizer * opt ( allocateOptimizer ( job->optimizer, model, job->data ) );   // for ML-Fitting
+	PsiData localdataset ( job->data->getIntensities(),    // local because it changes in every iteration
+			job->data->getNtrials(),
+			job->data->getNcorrect(),
+			job->data->getNalternatives() );
+	std::vector<double> localfit   ( model->getNparams() );
+	std::vector<int>    sample     ( job->data->getNblocks() );
+	std::vector<double> devianceresiduals ( job->data->getNblocks() );
+	PsiRandomStream stream;
+
+	try {
+		while ( true ) {
+			pthread_mutex_lock ( &(job->lock) );
+			b = job->nextsample++;
+			pthread_mutex_unlock ( &(job->lock) );
+			if ( b>=job->B || job->failed )
+				break;
+
+			stream.seed ( job->seed, b );
+			samplereport = PsiOptimizerReport ();
+			do {
+				// Resampling
+				newsample ( job->data, *(job->p), &sample, &stream );   // draw a new sample
+				localdataset.setNcorrect ( sample );       // put the new sample to the localdataset
+
+				// Fit
+				localfit = opt->optimize (model, &localdataset, job->initialfit, &report );
+				samplereport.add ( report );
+#ifdef DEBUG_BOOTSTRAP
+				std::cerr << localfit[0] << " " << localfit[1] << " " << localfit[2] << "\n";
+#endif
+
+				// Store what we need for the BCa stuff
+				// TODO: if l_LF is nan we don't take this sample
+				// TODO: This is not the best solution but it works (kindof)
+				good = true;
+				for (cut=0; cut<cuts.size(); cut++) {
+					(*(job->l_LF))[cut][b] = model->leastfavourable ( localfit, &localdataset, cuts[cut] );
+					if ( (*(job->l_LF))[cut][b] != (*(job->l_LF))[cut][b] ) {
+						good = false;
+						break;
+					}
+				}
+			} while ( !good );
+
+			job->bootstrapsamples->setData ( b, sample );  // store the new sample in the mc object
+			job->bootstrapsamples->setOptimizerReport ( b, samplereport );
+
+			// Get some characteristics of the localfit
+			deviance = model->deviance ( localfit, &localdataset );
+			devianceresiduals = model->getDevianceResiduals ( localfit, &localdataset );
+			job->bootstrapsamples->setEst ( b, localfit, deviance );
+			job->bootstrapsamples->setRpd ( b, model->getRpd( devianceresiduals, localfit, &localdataset ) );
+			job->bootstrapsamples->setRkd ( b, model->getRkd( devianceresiduals, &localdataset ) );
+
+			for (cut=0; cut<cuts.size(); cut++) {
+				(*(job->u_t))[cut][b]  = model->getThres(localfit,cuts[cut]);
+				(*(job->u_s))[cut][b]  = model->getSlope(localfit,(*(job->u_t))[cut][b]);
+				job->bootstrapsamples->setThres((*(job->u_t))[cut][b], b, cut);
+				job->bootstrapsamples->setSlope((*(job->u_s))[cut][b], b, cut);
+			}
+		}
+	} catch ( ... ) {
+		// Exceptions can not cross thread boundaries; they are rethrown by bootstrap()
+		pthread_mutex_lock ( &(job->lock) );
+		job->failed = true;
+		pthread_mutex_unlock ( &(job->lock) );
+	}
+
+	delete opt;
+	return NULL;
+}
+
+/** \brief everything that identifies a bootstrap run: model, data, number of samples, cuts and generating parameters */
+static std::vector<double> bootstrap_fingerprint ( unsigned int B, const PsiData * data, const PsiPsychometric * model,
+		const std::vector<double>& cuts, const std::vector<double>& initialfit, bool parametric, PsiOptimizerType optimizer )
+{
+	unsigned int k;
+	std::vector<double> fingerprint ( model->getFingerprint ( data ) );
+
+	for ( k=0; k<data->getNblocks(); k++ ) {
+		fingerprint.push_back ( data->getIntensity ( k ) );
+		fingerprint.push_back ( data->getNtrials ( k ) );
+		fingerprint.push_back ( data->getNcorrect ( k ) );
+	}
+	fingerprint.push_back ( B );
+	fingerprint.push_back ( parametric );
+	fingerprint.push_back ( optimizer );
+	fingerprint.insert ( fingerprint.end(), cuts.begin(), cuts.end() );
+	fingerprint.insert ( fingerprint.end(), initialfit.begin(), initialfit.end() );
+	return fingerprint;
+}
+
+/** \brief write bootstrap samples first,...,last-1 to the sample log of a checkpoint */
+static void put_bootstrap_samples (
+		unsigned int first,
+		unsigned int last,
+		BootstrapList * bootstrapsamples,
+		const std::vector< std::vector<double> >& l_LF,
+		PsiCheckpointWriter * checkpoint )
+{
+	unsigned int b, cut;
+	PsiOptimizerReport report;
+
+	for ( b=first; b<last; b++ ) {
+		checkpoint->putIntegers ( bootstrapsamples->getData ( b ) );
+		checkpoint->putDoubles ( bootstrapsamples->getEst ( b ) );
+		checkpoint->putDouble ( bootstrapsamples->getdeviance ( b ) );
+		checkpoint->putDouble ( bootstrapsamples->getRpd ( b ) );
+		checkpoint->putDouble ( bootstrapsamples->getRkd ( b ) );
+		for ( cut=0; cut<l_LF.size(); cut++ ) {
+			checkpoint->putDouble ( bootstrapsamples->getThres_byPos ( b, cut ) );
+			checkpoint->putDouble ( bootstrapsamples->getSlope_byPos ( b, cut ) );
+			checkpoint->putDouble ( l_LF[cut][b] );
+		}
+		report = bootstrapsamples->getOptimizerReport ( b );
+		checkpoint->putInteger ( report.nevaluations );
+		checkpoint->putInteger ( report.ngradients );
+		checkpoint->putInteger ( report.niterations );
+		checkpoint->putInteger ( report.nshrinks );
+		checkpoint->putDouble ( report.simplexsize );
+		checkpoint->putDouble ( report.fspread );
+		checkpoint->putDouble ( report.walltime );
+		checkpoint->putInteger ( report.termination );
+	}
+}
+
+/** \brief write the state of a bootstrap run after samples first,...,done-1 have been added
+ *
+ * The new samples are appended to the sample log (filename.samples). The state file, that is written next, says how
+ * many samples of the log are valid.
+ */
+static void save_bootstrap_checkpoint (
+		const std::string& filename,
+		const std::vector<double>& fingerprint,
+		unsigned long seed,
+		unsigned int first,
+		unsigned int done,
+		BootstrapList * bootstrapsamples,
+		const std::vector< std::vector<double> >& l_LF )
+{
+	PsiCheckpointWriter log;
+	put_bootstrap_samples ( first, done, bootstrapsamples, l_LF, &log );
+	log.append ( filename + ".samples" );
+
+	PsiCheckpointWriter checkpoint ( "bootstrap" );
+	checkpoint.putDoubles ( fingerprint );
+	checkpoint.putInteger ( seed );
+	getDefaultStream()->saveState ( &checkpoint );
+	checkpoint.putInteger ( done );
+	checkpoint.save ( filename );
+}
+
+/** \brief start an empty sample log for a new checkpointed run */
+static void start_bootstrap_log ( const std::string& filename )
+{
+	PsiCheckpointWriter log ( "bootstrap-samples" );
+	log.save ( filename + ".samples" );
+}
+
+/** \brief restore the samples of an interrupted bootstrap run, returns the number of samples that are restored
+ *
+ * Samples of an incomplete round that were appended to the log after the last checkpoint are cut off.
+ */
+static unsigned int load_bootstrap_checkpoint (
+		const std::string& filename,
+		const std::vector<double>& fingerprint,
+		unsigned long * seed,
+		BootstrapList * bootstrapsamples,
+		std::vector< std::vector<double> > * l_LF,
+		std::vector< std::vector<double> > * u_t,
+		std::vector< std::vector<double> > * u_s )
+{
+	unsigned int b, cut, done;
+	unsigned long long validlog;
+	std::vector<int> sample;
+	std::vector<double> est;
+	double deviance;
+	PsiOptimizerReport report;
+	PsiCheckpointReader checkpoint ( filename, "bootstrap" );
+
+	if ( checkpoint.getDoubles()!=fingerprint )
+		throw PsiError ( "bootstrap: checkpoint belongs to a different analysis" );
+	*seed = checkpoint.getInteger ();
+	getDefaultStream()->loadState ( &checkpoint );
+	done = checkpoint.getInteger ();
+	if ( done>bootstrapsamples->getNsamples() )
+		throw PsiError ( "bootstrap: checkpoint holds too many samples" );
+	if ( !checkpoint.atEnd() )
+		throw PsiError ( "bootstrap: checkpoint is corrupt" );
+
+	{
+		// the log is closed at the end of this block, before it is truncated
+		PsiCheckpointReader log ( filename + ".samples", "bootstrap-samples" );
+		for ( b=0; b<done; b++ ) {
+			sample = log.getIntegers ();
+			est = log.getDoubles ();
+			if ( sample.size()!=bootstrapsamples->getNblocks() || est.size()!=bootstrapsamples->getNparams() )
+				throw PsiError ( "bootstrap: checkpoint holds a corrupt sample" );
+			deviance = log.getDouble ();
+			bootstrapsamples->setData ( b, sample );
+			bootstrapsamples->setEst ( b, est, deviance );
+			bootstrapsamples->setRpd ( b, log.getDouble () );
+			bootstrapsamples->setRkd ( b, log.getDouble () );
+			for ( cut=0; cut<l_LF->size(); cut++ ) {
+				(*u_t)[cut][b] = log.getDouble ();
+				(*u_s)[cut][b] = log.getDouble ();
+				(*l_LF)[cut][b] = log.getDouble ();
+				bootstrapsamples->setThres ( (*u_t)[cut][b], b, cut );
+				bootstrapsamples->setSlope ( (*u_s)[cut][b], b, cut );
+			}
+			report.nevaluations = log.getInteger ();
+			report.ngradients = log.getInteger ();
+			report.niterations = log.getInteger ();
+			report.nshrinks = log.getInteger ();
+			report.simplexsize = log.getDouble ();
+			report.fspread = log.getDouble ();
+			report.walltime = log.getDouble ();
+			report.termination = (PsiTermination) log.getInteger ();
+			bootstrapsamples->setOptimizerReport ( b, report );
+		}
+		validlog = log.tell ();
+	}
+	truncate_checkpoint_log ( filename + ".samples", validlog );
+	return done;
+}
+
+BootstrapList bootstrap ( unsigned int B, const PsiData * data, const PsiPsychometric* model, std::vector<double> cuts, std::vector<double>* param, bool BCa, bool parametric, unsigned int nthreads, PsiOptimizerType optimizer, const std::string& checkpointfile, unsigned int checkpointinterval )
 {
 #ifdef DEBUG_BOOTSTRAP
-	int l;
 	std::cerr << "Starting bootstrap\n Cuts size=" << cuts.size() << " "; std::cerr.flush();
 #endif
+	if ( nthreads<1 )
+		throw BadArgumentError ( "bootstrap needs at least one thread" );
+	if ( !checkpointfile.empty() && checkpointinterval<1 )
+		throw BadArgumentError ( "bootstrap: checkpointinterval should be at least 1" );
+
 	BootstrapList bootstrapsamples ( B, model->getNparams(), data->getNblocks(), cuts );
-	unsigned int b,k,cut;                               // iteration variables for bootstrap sample, block, l-general purpose third level iteration, cut
+	unsigned int b,k,cut;                               // iteration variables for bootstrap sample, block, cut
 	std::vector< std::vector<double> > l_LF (cuts.size(), std::vector<double>(B));   // vector of double-vectors
 	std::vector< std::vector<double> > u_t  (cuts.size(), std::vector<double>(B));
 	std::vector< std::vector<double> > u_s  (cuts.size(), std::vector<double>(B));
-	PsiOptimizer opt ( model, data );                          // for ML-Fitting
-	PsiData * localdataset = new PsiData ( data->getIntensities(),  // local because it changes in every iteration
-			data->getNtrials(),
-			data->getNcorrect(),
-			data->getNalternatives() );
 
 	std::vector<double> initialfit ( model->getNparams() );       // generating parameters for the bootstrap samples
 	std::vector<double> incr       ( model->getNparams() );
+	PsiOptimizerReport total;
 	if (param==NULL) {
-		initialfit = getstart ( model, data, 8, 3, 3, &incr );
-		initialfit = opt.optimize( model, data );
+		PsiOptimizer * opt ( allocateOptimizer ( optimizer, model, data ) );
+		initialfit = getstart ( model, data, 8, 3, 3, &incr, nthreads );
+		initialfit = opt->optimize( model, data, NULL, &total );
+		delete opt;
 		initialfit.resize ( initialfit.size()+incr.size() );
 		for ( k=0,b=model->getNparams(); b<initialfit.size(); k++,b++ ) {
 			initialfit[b] = incr[k];
@@ -80,67 +348,76 @@ BootstrapList bootstrap ( unsigned int B, const PsiData * data, const PsiPsychom
 		for ( k=0; k<data->getNblocks(); k++ ) { p[k] = data->getPcorrect( k ); }
 	}
 
-	std::vector<double> localfit   ( model->getNparams() );
-	std::vector<int>    sample     ( data->getNblocks() );
 	std::vector<double> initialthresholds ( cuts.size() );
 	std::vector<double> initialslopes     ( cuts.size() );
-	std::vector<double> devianceresiduals ( data->getNblocks() );
-	double deviance;
 
 	for (cut=0; cut<cuts.size(); cut++) {
 		initialthresholds[cut] = model->getThres(initialfit,cuts[cut]);
 		initialslopes[cut]     = model->getSlope(initialfit,initialthresholds[cut]);
 	}
 
-	for ( b=0; b<B; b++ ) {
-		// Resampling
-		newsample ( data, p, &sample );         // draw a new sample
-		localdataset->setNcorrect ( sample );   // put the new sample to the localdataset
-		bootstrapsamples.setData ( b, sample ); // store the new sample in the mc object
-
-		// Fit
-		localfit = opt.optimize (model, localdataset, &initialfit );
-#ifdef DEBUG_BOOTSTRAP
-		for (l=0; l<sample.size(); l++)
-			std::cerr << " " << sample[l] << "\n";
-		std::cerr << localfit[0] << " " << localfit[1] << " " << localfit[2] << "\n";
-#endif
+	// Draw and fit the bootstrap samples
+	BootstrapJob job;
+	unsigned int done ( 0 );
+	job.data = data;
+	job.model = model;
+	job.cuts = &cuts;
+	job.initialfit = &initialfit;
+	job.p = &p;
+	job.seed = getDefaultStream()->genrand_int32();
+	job.bootstrapsamples = &bootstrapsamples;
+	job.l_LF = &l_LF;
+	job.u_t = &u_t;
+	job.u_s = &u_s;
+	job.optimizer = optimizer;
+	job.failed = false;
+	pthread_mutex_init ( &(job.lock), NULL );
 
-		// Get some characteristics of the localfit
-		deviance = model->deviance ( localfit, localdataset );
-		devianceresiduals = model->getDevianceResiduals ( localfit, localdataset );
-		bootstrapsamples.setEst ( b, localfit, deviance );
-		bootstrapsamples.setRpd ( b, model->getRpd( devianceresiduals, localfit, localdataset ) );
-		bootstrapsamples.setRkd ( b, model->getRkd( devianceresiduals, localdataset ) );
+	std::vector<double> fingerprint;
+	if ( !checkpointfile.empty() ) {
+		fingerprint = bootstrap_fingerprint ( B, data, model, cuts, initialfit, parametric, optimizer );
+		if ( PsiCheckpointReader::exists ( checkpointfile ) )
+			done = load_bootstrap_checkpoint ( checkpointfile, fingerprint, &(job.seed), &bootstrapsamples, &l_LF, &u_t, &u_s );
+		else
+			start_bootstrap_log ( checkpointfile );
+	}
 
-		// Store what we need for the BCa stuff
-		for (cut=0; cut<cuts.size(); cut++) {
-			l_LF[cut][b] = model->leastfavourable ( localfit, localdataset, cuts[cut] );
-#ifdef DEBUG_BOOTSTRAP
-			if (l_LF[cut][b] != l_LF[cut][b]) {
-				std::cerr << "deviance = " << deviance << "\n";
-				std::cerr << "l_LF["<<cut<<"]["<<b<<"] = " << l_LF[cut][b] << "\n";
-			}
-#endif
-			u_t[cut][b]  = model->getThres(localfit,cuts[cut]);
-			u_s[cut][b]  = model->getSlope(localfit,u_t[cut][b]);
-#ifdef DEBUG_BOOTSTRAP
-			if (l_LF[cut][b]!= l_LF[cut][b]) {
-				std::cerr << "u_t["<<cut<<"]["<<b<<"] = " << u_t[cut][b] << "\n";
-			}
-#endif
-			bootstrapsamples.setThres(u_t[cut][b], b, cut);
-			bootstrapsamples.setSlope(u_s[cut][b], b, cut);
+	// Without checkpoints, all samples are processed in a single round
+	while ( done<B ) {
+		job.nextsample = done;
+		job.B = ( checkpointfile.empty() ? B : std::min ( B, done+checkpointinterval ) );
 
-			if (l_LF[cut][b] != l_LF[cut][b]) {
-				// TODO: if l_LF is nan we don't take this sample
-				// TODO: This is not the best solution but it works (kindof)
-				b--;
-				continue;
+		if ( nthreads==1 ) {
+			bootstrap_worker ( &job );
+		} else {
+			std::vector<pthread_t> workers ( nthreads );
+			for ( k=0; k<nthreads; k++ ) {
+				if ( pthread_create ( &(workers[k]), NULL, bootstrap_worker, &job ) ) {
+					// Could not start another thread: the remaining workers take over its share
+					nthreads = k;
+					break;
+				}
 			}
+			if ( nthreads==0 )
+				bootstrap_worker ( &job );
+			for ( k=0; k<nthreads; k++ )
+				pthread_join ( workers[k], NULL );
 		}
+
+		if ( job.failed )
+			break;
+		if ( !checkpointfile.empty() )
+			save_bootstrap_checkpoint ( checkpointfile, fingerprint, job.seed, done, job.B, &bootstrapsamples, l_LF );
+		done = job.B;
 	}
+	pthread_mutex_destroy ( &(job.lock) );
 
+	if ( job.failed )
+		throw PsiError ( "bootstrap: fitting a bootstrap sample failed" );
+
+	for ( b=0; b<B; b++ )
+		total.add ( bootstrapsamples.getOptimizerReport ( b ) );
+	bootstrapsamples.setOptimizerTotal ( total );
 
 	// Calculate BCa constants
 	double bias, acc;
@@ -151,17 +428,22 @@ BootstrapList bootstrap ( unsigned int B, const PsiData * data, const PsiPsychom
 		bootstrapsamples.setBCa_s(cut, bias, acc );
 	}
 
-	delete localdataset;
-
 	return bootstrapsamples;
 }
 
-JackKnifeList jackknifedata ( const PsiData * data, const PsiPsychometric* model )
+JackKnifeList jackknifedata ( const PsiData * data, const PsiPsychometric* model, PsiOptimizerType optimizer, const std::vector<double>* fullestimate )
 {
-	PsiOptimizer *opt = new PsiOptimizer( model, data );
-	std::vector<double> mlestimate ( opt->optimize( model, data ) );
+	PsiOptimizer *opt;
+	PsiOptimizerReport report, total;
+	std::vector<double> mlestimate;
+	if ( fullestimate==NULL ) {
+		opt = allocateOptimizer ( optimizer, model, data );
+		mlestimate = opt->optimize( model, data, NULL, &total );
+		delete opt;
+	} else {
+		mlestimate = *fullestimate;
+	}
 	std::vector<double> estimate ( mlestimate );
-	delete opt;
 	JackKnifeList jackknife ( data->getNblocks(), model->getNparams(), model->deviance(mlestimate, data), mlestimate );
 	PsiData * localdata;
 
@@ -183,14 +465,17 @@ JackKnifeList jackknifedata ( const PsiData * data, const PsiPsychometric* model
 		}
 
 		localdata = new PsiData ( x,n,k,data->getNalternatives() );
-		opt       = new PsiOptimizer ( model, localdata );
+		opt       = allocateOptimizer ( optimizer, model, localdata );
 
-		estimate = opt->optimize( model, localdata, &mlestimate );
+		estimate = opt->optimize( model, localdata, &mlestimate, &report );
 		jackknife.setEst ( i, estimate, model->deviance(estimate,localdata) );
+		jackknife.setOptimizerReport ( i, report );
+		total.add ( report );
 
 		delete localdata;
 		delete opt;
 	}
+	jackknife.setOptimizerTotal ( total );
 
 	return jackknife;
 }
@@ -6,6 +6,7 @@
 #define BOOTSTRAP_H
 
 #include <vector>
+#include <string>
 #include <cmath>
 #include "psychometric.h"
 #include "mclist.h"
@@ -15,6 +16,18 @@
  *
  * A parametric bootstrap is performed by sampling from a binomial distribution with success probability given by the psychometric
  * function. if BCa is true, bias correction and acceleration constant are calculated for the cuts given in cuts.
+ *
+ * If nthreads>1, the bootstrap samples are distributed over nthreads worker threads. Each worker fits its samples with
+ * its own optimizer and its own copy of the data. Bias correction and acceleration are determined after all workers are done.
+ * Bootstrap sample b is drawn from substream b of a seed that is taken from the default stream. The result therefore
+ * only depends on the state of the default stream and not on the number of threads.
+ *
+ * If a checkpoint file is given, the samples are processed in rounds of checkpointinterval samples. After each round, the
+ * samples of the round are appended to the log checkpointfile.samples and the seed and the number of samples are written
+ * to the checkpoint file. If the checkpoint file exists when bootstrap() is called, the samples that are stored in it are
+ * not drawn again and the run continues with the same seed. As each sample only depends on the seed and its index, a
+ * resumed run gives the same result as a run that was not interrupted. A PsiError is thrown if the checkpoint belongs to
+ * a different analysis (data, model, cuts or generating parameters).
  */
 BootstrapList bootstrap (
 		unsigned int B,                        ///< number of bootstrap samples
@@ -23,7 +36,11 @@ BootstrapList bootstrap (
 		std::vector<double> cuts,     ///< performance levels at which the threshold should be calculated
 		std::vector<double>* param=NULL,   ///< parameter vector on which parametric bootstrap should be based
 		bool BCa=true,                ///< calculate bias correction and acceleration?
-		bool parametric=true          ///< Perform parametric bootstrap?
+		bool parametric=true,         ///< Perform parametric bootstrap?
+		unsigned int nthreads=1,      ///< number of worker threads that fit the bootstrap samples
+		PsiOptimizerType optimizer=OPTIMIZER_SIMPLEX, ///< optimization method for the fits
+		const std::string& checkpointfile="",         ///< file for checkpoints (empty for no checkpoints)
+		unsigned int checkpointinterval=100           ///< number of bootstrap samples between checkpoints
 		);
 
 /** \brief perform jackkifing to detect influential observations and outliers
@@ -33,9 +50,11 @@ BootstrapList bootstrap (
  *
  * Wichmann & Hill (2001) The psychometric function: I. Fitting, sampling, and goodness of fit. Perception & Psychophysics, 63(8), 1293--1313.
  */
-JackKnifeList jackknifedata ( const PsiData * data, const PsiPsychometric* model );
-
-
-void newsample ( const PsiData * data, const std::vector<double>& p, std::vector<int> * sample );
+JackKnifeList jackknifedata (
+		const PsiData * data,                            ///< data to be jackknifed
+		const PsiPsychometric* model,                    ///< model to be fitted
+		PsiOptimizerType optimizer=OPTIMIZER_SIMPLEX,    ///< optimization method for the fits
+		const std::vector<double>* mlestimate=NULL       ///< estimate for the full dataset (if NULL, the full dataset is fitted first)
+		);
 
 #endif
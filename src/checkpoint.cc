@@ -0,0 +1,198 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+static const char checkpoint_magic[] = "PSICKPT1";
+
+/************************************************************
+ * PsiCheckpointWriter methods
+ */
+
+static void append_word ( std::string * buffer, unsigned long long x )
+{
+	unsigned int i;
+	for ( i=0; i<8; i++ )
+		buffer->push_back ( (char) ( (x>>(8*i)) & 0xff ) );
+}
+
+PsiCheckpointWriter::PsiCheckpointWriter ( const std::string& kind )
+	: buffer ( checkpoint_magic )
+{
+	append_word ( &buffer, kind.size() );
+	buffer += kind;
+}
+
+void PsiCheckpointWriter::putInteger ( unsigned long x )
+{
+	append_word ( &buffer, x );
+}
+
+void PsiCheckpointWriter::putDouble ( double x )
+{
+	unsigned long long bits;
+	memcpy ( &bits, &x, sizeof(double) );
+	append_word ( &buffer, bits );
+}
+
+void PsiCheckpointWriter::putDoubles ( const std::vector<double>& x )
+{
+	unsigned int i;
+	putInteger ( x.size() );
+	for ( i=0; i<x.size(); i++ )
+		putDouble ( x[i] );
+}
+
+void PsiCheckpointWriter::putIntegers ( const std::vector<int>& x )
+{
+	unsigned int i;
+	putInteger ( x.size() );
+	for ( i=0; i<x.size(); i++ )
+		append_word ( &buffer, (unsigned long long) (long long) x[i] );
+}
+
+void PsiCheckpointWriter::save ( const std::string& filename ) const
+{
+	std::string tmpname ( filename + ".tmp" );
+	std::ofstream outfile ( tmpname.c_str(), std::ios::binary | std::ios::trunc );
+	outfile.write ( buffer.data(), buffer.size() );
+	outfile.close ();
+	if ( !outfile )
+		throw PsiError ( "PsiCheckpointWriter: could not write checkpoint file" );
+	if ( std::rename ( tmpname.c_str(), filename.c_str() ) )
+		throw PsiError ( "PsiCheckpointWriter: could not replace checkpoint file" );
+}
+
+void PsiCheckpointWriter::append ( const std::string& filename ) const
+{
+	std::ofstream outfile ( filename.c_str(), std::ios::binary | std::ios::app );
+	if ( !outfile )
+		throw PsiError ( "PsiCheckpointWriter: could not open checkpoint log" );
+	outfile.write ( buffer.data(), buffer.size() );
+	outfile.close ();
+	if ( !outfile )
+		throw PsiError ( "PsiCheckpointWriter: could not write checkpoint log" );
+}
+
+/************************************************************
+ * PsiCheckpointReader methods
+ */
+
+PsiCheckpointReader::PsiCheckpointReader ( const std::string& filename, const std::string& kind )
+	: file ( filename.c_str(), std::ios::binary ), pos ( 0 ), size ( 0 )
+{
+	unsigned int nmagic ( strlen ( checkpoint_magic ) );
+	unsigned long long nkind;
+	std::string header;
+
+	if ( !file )
+		throw PsiError ( "PsiCheckpointReader: could not open checkpoint file" );
+	file.seekg ( 0, std::ios::end );
+	size = (unsigned long long) file.tellg ();
+	file.seekg ( 0, std::ios::beg );
+
+	header.resize ( nmagic );
+	if ( size<nmagic || !file.read ( &(header[0]), nmagic ) || header!=checkpoint_magic )
+		throw PsiError ( "PsiCheckpointReader: file is not a checkpoint" );
+	pos = nmagic;
+	nkind = getWord ();
+	if ( nkind!=kind.size() || nkind>size-pos )
+		throw PsiError ( "PsiCheckpointReader: checkpoint was written by a different kind of computation" );
+	header.resize ( kind.size() );
+	if ( nkind>0 && !file.read ( &(header[0]), nkind ) )
+		throw PsiError ( "PsiCheckpointReader: checkpoint is truncated" );
+	if ( header!=kind )
+		throw PsiError ( "PsiCheckpointReader: checkpoint was written by a different kind of computation" );
+	pos += nkind;
+}
+
+bool PsiCheckpointReader::exists ( const std::string& filename )
+{
+	std::ifstream infile ( filename.c_str(), std::ios::binary );
+	return infile.good();
+}
+
+unsigned long long PsiCheckpointReader::getWord ( void )
+{
+	unsigned int i;
+	unsigned long long x ( 0 );
+	unsigned char word[8];
+	if ( size-pos<8 || !file.read ( (char*) word, 8 ) )
+		throw PsiError ( "PsiCheckpointReader: checkpoint is truncated" );
+	for ( i=0; i<8; i++ )
+		x |= ( (unsigned long long) word[i] ) << (8*i);
+	pos += 8;
+	return x;
+}
+
+unsigned long PsiCheckpointReader::getInteger ( void )
+{
+	return getWord ();
+}
+
+double PsiCheckpointReader::getDouble ( void )
+{
+	unsigned long long bits ( getWord () );
+	double x;
+	memcpy ( &x, &bits, sizeof(double) );
+	return x;
+}
+
+std::vector<double> PsiCheckpointReader::getDoubles ( void )
+{
+	unsigned long i, n ( getInteger () );
+	if ( n>(size-pos)/8 )
+		throw PsiError ( "PsiCheckpointReader: checkpoint is truncated" );
+	std::vector<double> x ( n );
+	for ( i=0; i<n; i++ )
+		x[i] = getDouble ();
+	return x;
+}
+
+std::vector<int> PsiCheckpointReader::getIntegers ( void )
+{
+	unsigned long i, n ( getInteger () );
+	if ( n>(size-pos)/8 )
+		throw PsiError ( "PsiCheckpointReader: checkpoint is truncated" );
+	std::vector<int> x ( n );
+	for ( i=0; i<n; i++ )
+		x[i] = (int) (long long) getWord ();
+	return x;
+}
+
+/************************************************************
+ * Sample logs
+ */
+
+void truncate_checkpoint_log ( const std::string& filename, unsigned long long length )
+{
+	std::string tmpname ( filename + ".tmp" );
+	unsigned long long left ( length );
+	std::streamsize n;
+	char chunk[65536];
+	std::ifstream infile ( filename.c_str(), std::ios::binary );
+	if ( !infile )
+		throw PsiError ( "truncate_checkpoint_log: could not open checkpoint log" );
+	infile.seekg ( 0, std::ios::end );
+	if ( (unsigned long long) infile.tellg ()==length )
+		return;
+	infile.seekg ( 0, std::ios::beg );
+
+	std::ofstream outfile ( tmpname.c_str(), std::ios::binary | std::ios::trunc );
+	while ( left>0 ) {
+		n = ( left<sizeof(chunk) ? left : sizeof(chunk) );
+		if ( !infile.read ( chunk, n ) )
+			throw PsiError ( "truncate_checkpoint_log: checkpoint log is too short" );
+		outfile.write ( chunk, n );
+		left -= n;
+	}
+	infile.close ();
+	outfile.close ();
+	if ( !outfile )
+		throw PsiError ( "truncate_checkpoint_log: could not write checkpoint log" );
+	if ( std::rename ( tmpname.c_str(), filename.c_str() ) )
+		throw PsiError ( "truncate_checkpoint_log: could not replace checkpoint log" );
+}
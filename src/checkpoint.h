@@ -0,0 +1,91 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "errors.h"
+
+/** \brief compact binary image of the state of a long computation
+ *
+ * A checkpoint is a sequence of unsigned integers and doubles that are written in a fixed order by the computation and read
+ * back in the same order when the computation is resumed. Every value takes 8 bytes (integers little endian, doubles as
+ * their IEEE 754 bit pattern in little endian byte order), so that restored doubles are bit-identical and checkpoints can
+ * be moved between machines. Vectors are stored with their length. The file starts with a magic string and a tag for the
+ * kind of computation that wrote it.
+ *
+ * The complete image is assembled in memory and written to a temporary file that replaces the checkpoint file only if it
+ * was written completely. A job that is killed while it writes a checkpoint thus leaves the previous checkpoint intact.
+ *
+ * Samples that have been stored once do not change. They are kept in a log file of their own that only grows: each
+ * checkpoint appends the new samples (an image without header, see append()) and then saves the small state file that
+ * says how many samples of the log are valid. Samples after that count (from a job that was killed in between) are
+ * cut off by truncate_checkpoint_log() when the run is resumed.
+ */
+class PsiCheckpointWriter
+{
+	private:
+		std::string buffer;
+	public:
+		PsiCheckpointWriter (
+			const std::string& kind                            ///< tag of the computation (checked when the checkpoint is read)
+			);   ///< start a new checkpoint image
+		PsiCheckpointWriter ( void ) {}                        ///< start an image without header that continues a log (see append())
+		void putInteger ( unsigned long x );                   ///< append an unsigned integer
+		void putDouble ( double x );                           ///< append a double
+		void putDoubles ( const std::vector<double>& x );      ///< append a vector of doubles
+		void putIntegers ( const std::vector<int>& x );        ///< append a vector of (signed) integers
+		void save (
+			const std::string& filename                        ///< checkpoint file
+			) const;   ///< write the image to filename (via filename.tmp, which is renamed to filename)
+		void append (
+			const std::string& filename                        ///< log file that was started by save()
+			) const;   ///< append the image to the end of filename
+};
+
+/** \brief read a checkpoint that was written by PsiCheckpointWriter
+ *
+ * Values have to be read in the order in which they were written. Reading beyond the end of the image throws a PsiError,
+ * as do a missing file, a file that is not a checkpoint and a checkpoint of a different kind.
+ *
+ * The file is read as a stream, so that sample logs of long runs (that may be larger than the memory or than 4 GiB) can
+ * be read record by record. Positions are counted in bytes from the start of the file.
+ */
+class PsiCheckpointReader
+{
+	private:
+		std::ifstream file;
+		unsigned long long pos;
+		unsigned long long size;
+		unsigned long long getWord ( void );
+		PsiCheckpointReader ( const PsiCheckpointReader& );   // not copyable
+	public:
+		PsiCheckpointReader (
+			const std::string& filename,                       ///< checkpoint file
+			const std::string& kind                            ///< expected tag of the computation
+			);   ///< open a checkpoint and check its header
+		static bool exists ( const std::string& filename );    ///< is there a file that could be read?
+		unsigned long getInteger ( void );                     ///< read an unsigned integer
+		double getDouble ( void );                             ///< read a double
+		std::vector<double> getDoubles ( void );               ///< read a vector of doubles
+		std::vector<int> getIntegers ( void );                 ///< read a vector of (signed) integers
+		bool atEnd ( void ) const { return pos==size; }        ///< have all values been read?
+		unsigned long long tell ( void ) const { return pos; }  ///< number of bytes that have been read (including the header)
+};
+
+/** \brief keep only the first length bytes of a checkpoint log
+ *
+ * Used on resume to drop the samples that were appended after the last complete checkpoint. If the log is longer than
+ * length, its first length bytes are copied to filename.tmp in chunks, which then replaces filename. A log of the right
+ * length is left alone.
+ */
+void truncate_checkpoint_log (
+		const std::string& filename,                           ///< sample log
+		unsigned long long length                              ///< number of valid bytes (see PsiCheckpointReader::tell())
+		);
+
+#endif
@@ -41,6 +41,19 @@ class PsiCore
 			int i,                          ///< index of the first parameter to which the derivative should be evaluated
 			int j                           ///< index of the second parameter to which the derivative should be evaluated
 			) const { throw NotImplementedError(); }         ///< evaluate the second derivative of the core with respect to parameter i and j
+		virtual void g_batch (
+			unsigned int n,                 ///< number of stimulus intensities
+			const double * x,               ///< stimulus intensities
+			const std::vector<double>& prm, ///< parameter vector
+			double * out                    ///< output array of length n
+			) const { unsigned int k; for ( k=0; k<n; k++ ) out[k] = g ( x[k], prm ); }         ///< evaluate the core at n stimulus intensities
+		virtual void dg_batch (
+			unsigned int n,                 ///< number of stimulus intensities
+			const double * x,               ///< stimulus intensities
+			const std::vector<double>& prm, ///< parameter vector
+			int i,                          ///< index of the parameter to which the derivative should be evaluated
+			double * out                    ///< output array of length n
+			) const { unsigned int k; for ( k=0; k<n; k++ ) out[k] = dg ( x[k], prm, i ); }     ///< evaluate the first derivative with respect to parameter i at n stimulus intensities
 		virtual double inv (
 			double y,                       ///< transformed intensity
 			const std::vector<double>& prm  ///< parameter vector
@@ -80,6 +80,11 @@ const std::vector<double>& PsiData::getPcorrect ( void ) const
     return Pcorrect;
 }
 
+const std::vector<double>& PsiData::getNoverK ( void ) const
+{
+    return logNoverK;
+}
+
 double PsiData::getIntensity ( unsigned int i ) const
 {
 	if ( i>=0 && i<intensities.size() )
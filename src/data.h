@@ -49,6 +49,7 @@ class PsiData
 		const std::vector<int>&    getNtrials ( void ) const;            ///< get the numbers of trials at the respective stimulus intensities
 		const std::vector<int>&    getNcorrect ( void ) const;           ///< get the numbers of correct trials at the respective stimulus intensities
 		const std::vector<double>& getPcorrect ( void ) const;           ///< get the fraction of correct trials at the respective stimulus intensities
+		const std::vector<double>& getNoverK ( void ) const;             ///< get the logs of NoverK for all blocks
 		double getIntensity ( unsigned int i ) const;                             ///< get the stimulus intensity for block i
 		int getNtrials ( unsigned int i ) const;                                  ///< get the numbers of trials  for block i
 		int getNcorrect ( unsigned int i ) const;                                 ///< get the numbers of correct trials for block i
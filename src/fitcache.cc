@@ -0,0 +1,114 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#include "fitcache.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+PsiFitCache::PsiFitCache ( const std::string& filename )
+	: filename ( filename )
+{
+	std::string key;
+	unsigned int i, nprm;
+	std::vector<double> estimate;
+
+	if ( filename.empty() )
+		return;
+
+	std::ifstream infile ( filename.c_str() );
+	while ( infile >> key >> nprm ) {
+		estimate.resize ( nprm );
+		for ( i=0; i<nprm; i++ )
+			infile >> estimate[i];
+		if ( !infile )
+			break;       // incomplete last line
+		estimates[key] = estimate;
+	}
+}
+
+/** FNV-1a hash of a string */
+static unsigned long fnv1a ( const std::string& s, unsigned long h )
+{
+	unsigned int i;
+	for ( i=0; i<s.size(); i++ ) {
+		h ^= (unsigned char) s[i];
+		h = ( h * 16777619UL ) & 0xffffffffUL;
+	}
+	return h;
+}
+
+std::string PsiFitCache::makekey (
+		const PsiData * data,
+		const std::string& core,
+		const std::string& sigmoid,
+		bool gammaislambda,
+		const std::string& priors,
+		PsiOptimizerType optimizer
+		)
+{
+	unsigned int i;
+	char buffer[80];
+	std::string material;
+
+	sprintf ( buffer, "%d %d", data->getNalternatives(), data->getNblocks() );
+	material = buffer;
+	for ( i=0; i<data->getNblocks(); i++ ) {
+		sprintf ( buffer, " %.17g %d %d", data->getIntensity(i), data->getNcorrect(i), data->getNtrials(i) );
+		material += buffer;
+	}
+	material += "|" + core + "|" + sigmoid + "|" + ( gammaislambda ? "1" : "0" ) + "|" + priors;
+	// Different optimizers may stop at slightly different estimates
+	sprintf ( buffer, "|%d", optimizer );
+	material += buffer;
+
+	// Two independent 32 bit hashes give a key that does not depend on the size of long
+	sprintf ( buffer, "%08lx%08lx", fnv1a ( material, 2166136261UL ), fnv1a ( material, 84696351UL ) );
+	return std::string ( buffer );
+}
+
+bool PsiFitCache::lookup ( const std::string& key, std::vector<double> * estimate ) const
+{
+	std::map< std::string, std::vector<double> >::const_iterator entry ( estimates.find ( key ) );
+	if ( entry==estimates.end() )
+		return false;
+	*estimate = entry->second;
+	return true;
+}
+
+void PsiFitCache::store ( const std::string& key, const std::vector<double>& estimate )
+{
+	unsigned int i;
+	estimates[key] = estimate;
+
+	if ( filename.empty() )
+		return;
+
+	std::ofstream outfile ( filename.c_str(), std::ios::app );
+	if ( !outfile )
+		throw PsiError ( "PsiFitCache: could not write to cache file" );
+	outfile << key << " " << estimate.size() << std::setprecision ( 17 );
+	for ( i=0; i<estimate.size(); i++ )
+		outfile << " " << estimate[i];
+	outfile << "\n";
+}
+
+std::vector<double> PsiFitCache::fit (
+		const std::string& key,
+		const PsiPsychometric * model,
+		const PsiData * data,
+		PsiOptimizerType optimizer
+		)
+{
+	std::vector<double> estimate;
+	if ( lookup ( key, &estimate ) && estimate.size()==model->getNparams() )
+		return estimate;
+
+	PsiOptimizer * opt ( allocateOptimizer ( optimizer, model, data ) );
+	estimate = opt->optimize ( model, data );
+	delete opt;
+
+	store ( key, estimate );
+	return estimate;
+}
@@ -0,0 +1,59 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#ifndef FITCACHE_H
+#define FITCACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "psychometric.h"
+#include "data.h"
+#include "optimizer.h"
+
+/** \brief cache of MAP/ML estimates
+ *
+ * Analyses of the same dataset with the same model all start from the same fit. The fit cache stores estimates under a key
+ * that identifies the dataset, the model and the optimizer (see makekey()), so that repeated analyses can skip the initial fit.
+ *
+ * If a file name is given, the cache is backed by a text file: existing entries are read when the cache is constructed and
+ * new entries are appended to the file as they are stored. Each line of the file holds a key, the number of parameters and
+ * the estimate.
+ */
+class PsiFitCache
+{
+	private:
+		std::string filename;
+		std::map< std::string, std::vector<double> > estimates;
+	public:
+		PsiFitCache (
+			const std::string& filename=""                  ///< file that backs the cache (empty for a cache in memory only)
+			);   ///< set up a cache and read entries that are already stored in filename
+		static std::string makekey (
+			const PsiData * data,                           ///< dataset
+			const std::string& core,                        ///< descriptor of the core (e.g. "mw0.1")
+			const std::string& sigmoid,                     ///< descriptor of the sigmoid (e.g. "logistic")
+			bool gammaislambda,                             ///< is gamma constrained to be equal to lambda?
+			const std::string& priors,                      ///< descriptors of the priors (e.g. "None,None,Uniform(0,.1)")
+			PsiOptimizerType optimizer=OPTIMIZER_SIMPLEX    ///< optimization method (should be the one that is passed to fit())
+			);   ///< hash everything that determines the estimate into a key
+		bool lookup (
+			const std::string& key,                         ///< key as returned by makekey()
+			std::vector<double> * estimate                  ///< the cached estimate is written here
+			) const;   ///< retrieve an estimate, returns false if the cache has no estimate for key
+		void store (
+			const std::string& key,                         ///< key as returned by makekey()
+			const std::vector<double>& estimate             ///< estimate to be stored
+			);   ///< store an estimate (and append it to the backing file)
+		std::vector<double> fit (
+			const std::string& key,                         ///< key as returned by makekey()
+			const PsiPsychometric * model,                  ///< model to be fitted if the estimate is not cached
+			const PsiData * data,                           ///< data to be fitted if the estimate is not cached
+			PsiOptimizerType optimizer=OPTIMIZER_SIMPLEX    ///< optimization method if the estimate is not cached
+			);   ///< get the cached estimate or fit the model and store the estimate
+		unsigned int size ( void ) const { return estimates.size(); }   ///< number of cached estimates
+		void clear ( void ) { estimates.clear(); }                      ///< forget all estimates (the backing file is not changed)
+};
+
+#endif
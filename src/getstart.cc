@@ -1,4 +1,9 @@
 #include "getstart.h"
+#include <algorithm>
+#include <limits>
+#include <pthread.h>
+
+const unsigned int gridchunk ( 256 );     // number of grid points that are evaluated in one batch
 
 std::vector<double> linspace ( double xmin, double xmax, unsigned int n ) {
 	double dummy;
@@ -84,6 +89,81 @@ PsiGrid PsiGrid::subgrid ( void ) const
 	return PsiGrid ( xmin, xmax, get_gridsize() );
 }
 
+unsigned long PsiGrid::npoints ( void ) const
+{
+	unsigned long n ( 1 );
+	unsigned int i;
+	for ( i=0; i<dimension(); i++ )
+		n *= get_gridsize();
+	return n;
+}
+
+void PsiGrid::point ( unsigned long index, std::vector<double> *prm ) const
+{
+	int i;
+	unsigned int n ( get_gridsize() );
+	for ( i=dimension()-1; i>=0; i-- ) {
+		(*prm)[i] = grid1d[i][index%n];
+		index /= n;
+	}
+}
+
+/************************************************** PsiGridBest methods ********************************************/
+
+void PsiGridBest::insert ( double L, const std::vector<double>& prm, unsigned long order )
+{
+	unsigned int i;
+	Candidate c;
+	c.L = ( L==L ? L : std::numeric_limits<double>::infinity() );
+	c.order = order;
+
+	if ( nbest==0 )
+		return;
+	if ( heap.size()==nbest && !better ( c, heap.front() ) )
+		return;
+
+	for ( i=0; i<heap.size(); i++ )
+		if ( heap[i].L==c.L && heap[i].prm==prm )
+			return;
+
+	if ( heap.size()==nbest ) {
+		std::pop_heap ( heap.begin(), heap.end(), better );
+		heap.pop_back ();
+	}
+	c.prm = prm;
+	heap.push_back ( c );
+	std::push_heap ( heap.begin(), heap.end(), better );
+}
+
+void PsiGridBest::merge ( const PsiGridBest& other )
+{
+	unsigned int i;
+	for ( i=0; i<other.heap.size(); i++ )
+		insert ( other.heap[i].L, other.heap[i].prm, other.heap[i].order );
+}
+
+std::list< std::vector<double> > PsiGridBest::get_best ( void ) const
+{
+	std::vector<Candidate> sorted ( heap );
+	std::list< std::vector<double> > out;
+	unsigned int i;
+	std::sort_heap ( sorted.begin(), sorted.end(), better );
+	for ( i=0; i<sorted.size(); i++ )
+		out.push_back ( sorted[i].prm );
+	return out;
+}
+
+std::list< double > PsiGridBest::get_L ( void ) const
+{
+	std::vector<Candidate> sorted ( heap );
+	std::list< double > out;
+	unsigned int i;
+	std::sort_heap ( sorted.begin(), sorted.end(), better );
+	for ( i=0; i<sorted.size(); i++ )
+		out.push_back ( sorted[i].L );
+	return out;
+}
+
 /************************************************** PsiGrid functions ********************************************/
 
 void makegridpoints (
@@ -150,21 +230,27 @@ void evalgridpoints (
 	std::list< double >::iterator iter_L;
 	double l;
 	double a,b;
-	std::vector<double> prm;
+	std::vector< std::vector<double> > prm ( gridpoints.size() );
+	std::vector<double> posteriors;
 	const PsiCore *core = pmf->getCore();
 	bool store(true);
+	unsigned int i;
 
-	for ( griditer=gridpoints.begin(); griditer!=gridpoints.end(); griditer++ ) {
-		// Transform parameters and get negative log posterior
+	// Transform parameters and get negative log posteriors for all grid points at once
+	for ( griditer=gridpoints.begin(), i=0; griditer!=gridpoints.end(); griditer++, i++ ) {
 		a = (*griditer)[0];
 		b = (*griditer)[1];
 		b = 1./b;
 		a = -a*b;
 		// prm = core->transform ( pmf->getNparams(), 1./b, -a/b );
-		prm = core->transform ( pmf->getNparams(), a, b );
-		prm[2] = (*griditer)[2];
-		if ( pmf->getNparams() > 3 ) prm[3] = (*griditer)[3];
-		l = pmf->neglpost ( prm, data );
+		prm[i] = core->transform ( pmf->getNparams(), a, b );
+		prm[i][2] = (*griditer)[2];
+		if ( pmf->getNparams() > 3 ) prm[i][3] = (*griditer)[3];
+	}
+	posteriors = pmf->neglpost_batch ( prm, data );
+
+	for ( griditer=gridpoints.begin(), i=0; griditer!=gridpoints.end(); griditer++, i++ ) {
+		l = posteriors[i];
 
 		// Where does it belong?
 		for ( iter_L=L->begin(), iter_prm=bestprm->begin() ; iter_L!=L->end(); iter_L++, iter_prm++ ) {
@@ -195,6 +281,150 @@ void evalgridpoints (
 	}
 }
 
+/** \brief shared state of the threads that evaluate a grid */
+struct GridJob {
+	const PsiGrid * grid;                               // grid to be evaluated
+	const PsiData * data;
+	const PsiPsychometric * pmf;
+	unsigned long order;                                // running index of the first grid point
+	unsigned long npoints;                              // number of grid points
+	unsigned long nextpoint;                            // first grid point that has not been assigned to a thread
+	PsiGridBest * best;                                 // output
+	bool failed;                                        // did any of the threads encounter an error?
+	pthread_mutex_t lock;
+};
+
+/** \brief evaluate chunks of grid points until all points of the grid have been processed */
+void * evalgrid_worker ( void * jobptr ) {
+	GridJob * job ( (GridJob*) jobptr );
+	const PsiCore *core = job->pmf->getCore();
+	unsigned int nprm ( job->pmf->getNparams() );
+	unsigned long first, i, n;
+	double a,b;
+	std::vector< std::vector<double> > gridpoints ( gridchunk, std::vector<double> ( job->grid->dimension() ) );
+	std::vector< std::vector<double> > prm;
+	std::vector<double> posteriors;
+	bool failed;
+	// Other workers merge into job->best while this one runs: the candidates of this worker are collected separately
+	PsiGridBest best ( job->best->getNbest() );
+
+	try {
+		while ( true ) {
+			pthread_mutex_lock ( &(job->lock) );
+			first = job->nextpoint;
+			job->nextpoint += gridchunk;
+			failed = job->failed;
+			pthread_mutex_unlock ( &(job->lock) );
+			if ( first>=job->npoints || failed )
+				break;
+			n = ( first+gridchunk<job->npoints ? gridchunk : job->npoints-first );
+
+			// Transform parameters and get negative log posteriors for the whole chunk at once
+			prm.resize ( n );
+			for ( i=0; i<n; i++ ) {
+				job->grid->point ( first+i, &(gridpoints[i]) );
+				a = gridpoints[i][0];
+				b = gridpoints[i][1];
+				b = 1./b;
+				a = -a*b;
+				prm[i] = core->transform ( nprm, a, b );
+				prm[i][2] = gridpoints[i][2];
+				if ( nprm > 3 ) prm[i][3] = gridpoints[i][3];
+			}
+			posteriors = job->pmf->neglpost_batch ( prm, job->data );
+
+			for ( i=0; i<n; i++ )
+				best.insert ( posteriors[i], gridpoints[i], job->order+first+i );
+		}
+	} catch ( ... ) {
+		// Exceptions can not cross thread boundaries; they are rethrown by evalgrid()
+		pthread_mutex_lock ( &(job->lock) );
+		job->failed = true;
+		pthread_mutex_unlock ( &(job->lock) );
+		return NULL;
+	}
+
+	pthread_mutex_lock ( &(job->lock) );
+	job->best->merge ( best );
+	pthread_mutex_unlock ( &(job->lock) );
+
+	return NULL;
+}
+
+void evalgrid (
+		const PsiGrid& grid,
+		PsiGridBest *best,
+		unsigned long order,
+		const PsiData* data,
+		const PsiPsychometric* pmf,
+		unsigned int nthreads
+		)
+{
+	unsigned int k;
+	GridJob job;
+	job.grid = &grid;
+	job.data = data;
+	job.pmf = pmf;
+	job.order = order;
+	job.npoints = grid.npoints();
+	job.nextpoint = 0;
+	job.best = best;
+	job.failed = false;
+	pthread_mutex_init ( &(job.lock), NULL );
+
+	// No need for threads that would not get a chunk of their own
+	if ( nthreads > (job.npoints+gridchunk-1)/gridchunk )
+		nthreads = (job.npoints+gridchunk-1)/gridchunk;
+
+	if ( nthreads<=1 ) {
+		evalgrid_worker ( &job );
+	} else {
+		std::vector<pthread_t> workers ( nthreads );
+		for ( k=0; k<nthreads; k++ ) {
+			if ( pthread_create ( &(workers[k]), NULL, evalgrid_worker, &job ) ) {
+				// Could not start another thread: the remaining workers take over its share
+				nthreads = k;
+				break;
+			}
+		}
+		if ( nthreads==0 )
+			evalgrid_worker ( &job );
+		for ( k=0; k<nthreads; k++ )
+			pthread_join ( workers[k], NULL );
+	}
+	pthread_mutex_destroy ( &(job.lock) );
+
+	if ( job.failed )
+		throw PsiError ( "evalgrid: evaluating the grid failed" );
+}
+
+/** \brief shift or shrink the grid around each of the best parameter settings (see updategridpoints) */
+static void updategrids (
+		const PsiGrid& grid,
+		const std::list< std::vector<double> >& bestprm,
+		std::list< PsiGrid > *newgrids
+		)
+{
+	std::list< std::vector<double> >::const_iterator iter_prm;
+	bool isedge (false);
+	unsigned int i;
+
+	for ( iter_prm=bestprm.begin(); iter_prm!=bestprm.end(); iter_prm++ ) {
+		// Check whether the current point is on the edge of the grid
+		isedge = false;
+		for ( i=0; i<iter_prm->size(); i++ ) {
+			isedge += (*iter_prm)[i]==grid.get_lower(i);
+			isedge += (*iter_prm)[i]==grid.get_upper(i);
+		}
+
+		if (isedge) {
+			newgrids->push_back ( grid.shift ( *iter_prm ) );
+		} else {
+			newgrids->push_back ( grid.shrink ( *iter_prm ) );
+		}
+	}
+}
+
 void updategridpoints (
 		const PsiGrid& grid,
 		const std::list< std::vector<double> >& bestprm,
@@ -378,13 +608,15 @@ std::vector<double> getstart (
 		unsigned int gridsize,
 		unsigned int nneighborhoods,
 		unsigned int niterations,
-		std::vector<double> *incr )
+		std::vector<double> *incr,
+		unsigned int nthreads )
 {
 	std::vector<double> xmin ( pmf->getNparams() );
 	std::vector<double> xmax ( pmf->getNparams() );
 	std::list< std::vector<double> > bestprm;
-	std::list< double > L;
-	unsigned int i,j, ngrids;
+	PsiGridBest best ( nneighborhoods );
+	unsigned long order ( 0 );
+	unsigned int i,j,k, ngrids, nnew;
 
 	// Set up the initial grid
 	for ( i=0; i<pmf->getNparams(); i++ ) {
@@ -397,9 +629,8 @@ std::vector<double> getstart (
 	newgrids.push_back ( grid );
 
 	// Perform first evaluation on the grid
-	std::list< std::vector<double> > gridpoints;
-	makegridpoints ( grid, xmin, 0, &gridpoints );
-	evalgridpoints ( gridpoints, &bestprm, &L, data, pmf, nneighborhoods );
+	evalgrid ( grid, &best, order, data, pmf, nthreads );
+	order += grid.npoints();
 
 	// potentially more evaluations
 	for ( i=0; i<niterations; i++ ) {
@@ -411,15 +642,23 @@ std::vector<double> getstart (
 		for ( j=0; j<ngrids; j++ ) {
 			currentgrid = newgrids.front ();
 			newgrids.pop_front ();
-			gridpoints = std::list< std::vector<double> > ();
-			updategridpoints ( currentgrid, bestprm, &gridpoints, &newgrids );
-			evalgridpoints ( gridpoints, &bestprm, &L, data, pmf, nneighborhoods );
+			bestprm = best.get_best ();
+			updategrids ( currentgrid, bestprm, &newgrids );
+			// The new grids are at the end of newgrids
+			std::list< PsiGrid >::const_iterator iter_grid ( newgrids.end() );
+			nnew = bestprm.size();
+			for ( k=0; k<nnew; k++ ) iter_grid--;
+			for ( ; iter_grid!=newgrids.end(); iter_grid++ ) {
+				evalgrid ( *iter_grid, &best, order, data, pmf, nthreads );
+				order += iter_grid->npoints();
+			}
 		}
 
 		// evalgridpoints ( gridpoints, &bestprm, &L, data, pmf, nneighborhoods );
 	}
 
 	// Now transform the best parameter to the suitable format
+	bestprm = best.get_best ();
 	const PsiCore *core = pmf->getCore();
 	double a ( bestprm.front()[0] ), b ( bestprm.front()[1] );
 	// std::cerr << "Raw starting values:";
@@ -33,8 +33,52 @@ class PsiGrid {
 		double get_upper ( unsigned int i ) const { return upper_bounds[i]; }        ///< get upper bound for parameter i
 		double get_incr ( unsigned int i ) const { return (get_upper(i)-get_lower(i))/(get_gridsize()-1); } ///< Get increment on dimension i
 		double operator() ( unsigned int i, unsigned int j ) const { return grid1d[i][j]; }
+		unsigned long npoints ( void ) const;                                        ///< total number of grid points
+		void point (
+				unsigned long index,              ///< index of the grid point (between 0 and npoints()-1)
+				std::vector<double> *prm          ///< parameter vector to which the grid point is written, should have length dimension()
+				) const;  ///< generate a single grid point --- points are enumerated in the same order as by makegridpoints
 };
 
+/** \brief the best parameter settings encountered during a grid search
+ *
+ * Keeps the nbest parameter settings with the lowest negative log posterior. Candidates are stored in a heap that has the
+ * worst candidate on top, so that most grid points are rejected after a single comparison. Of two candidates with the same
+ * negative log posterior, the one that was encountered later is considered better. A parameter setting is not stored twice.
+ */
+class PsiGridBest {
+	private:
+		struct Candidate {
+			double L;                                  // negative log posterior
+			unsigned long order;                       // when was the candidate encountered?
+			std::vector<double> prm;                   // parameter setting on the grid
+		};
+		static bool better ( const Candidate& a, const Candidate& b ) { return a.L<b.L || ( a.L==b.L && a.order>b.order ); }
+		unsigned int nbest;
+		std::vector<Candidate> heap;
+	public:
+		PsiGridBest ( unsigned int nbest ) : nbest ( nbest ) {}   ///< set up an empty list for the nbest best candidates
+		void insert (
+				double L,                         ///< negative log posterior of the parameter setting
+				const std::vector<double>& prm,   ///< parameter setting on the grid
+				unsigned long order               ///< running index of the parameter setting (later settings win ties)
+				);   ///< consider a new parameter setting
+		void merge ( const PsiGridBest& other );                       ///< consider all candidates of another list
+		unsigned int size ( void ) const { return heap.size(); }      ///< number of stored candidates
+		unsigned int getNbest ( void ) const { return nbest; }        ///< maximum number of stored candidates
+		std::list< std::vector<double> > get_best ( void ) const;     ///< candidates sorted from best to worst
+		std::list< double > get_L ( void ) const;                     ///< negative log posteriors sorted from best to worst
+};
+
+void evalgrid (
+		const PsiGrid& grid,                                ///< grid on which the negative log posterior should be evaluated
+		PsiGridBest *best,                                  ///< best parameter settings so far (will be updated)
+		unsigned long order,                                ///< running index of the first grid point
+		const PsiData* data,                                ///< data set on which the gridsearch should be performed
+		const PsiPsychometric* pmf,                         ///< psychometric function for which the gridsearch should be performed
+		unsigned int nthreads=1                             ///< number of threads that evaluate chunks of grid points
+		);              ///< evaluate negative log posterior on all points of a grid, generating the points on the fly
+
 std::vector<double> linspace (
 		double xmin,
 		double xmax,
@@ -77,7 +121,8 @@ std::vector<double> getstart (
 		unsigned int gridsize,         ///< number of grid points to be used
 		unsigned int nneighborhoods,   ///< number of neighborhoods to be studied
 		unsigned int niterations,      ///< number of iterated neighborhood searched to be performed
-		std::vector<double> *incr=NULL ///< increments to be used when constructing a simplex (output)
+		std::vector<double> *incr=NULL, ///< increments to be used when constructing a simplex (output)
+		unsigned int nthreads=1        ///< number of threads that evaluate the grid points
 		);    ///< Determine a good starting value using nested grid search
 
 std::vector<double> pymakegridpoints (
@@ -224,7 +224,9 @@ std::vector<double> match_beta ( const std::vector<double>& x, const std::vector
 
 PsiIndependentPosterior independent_marginals (
 		const PsiPsychometric *pmf,
-		const PsiData *data
+		const PsiData *data,
+		PsiOptimizerType optimizer,
+		const std::vector<double>* mapestimate
 		)
 {
 	unsigned int gridsize (100);
@@ -237,10 +239,15 @@ PsiIndependentPosterior independent_marginals (
 	std::vector< std::vector<double> > distparams (nprm, std::vector<double>(3) );
 	std::vector<PsiPrior*> fitted_posteriors (nprm);
 
-	PsiOptimizer * opt = new PsiOptimizer ( pmf, data );
-	std::vector<double> MAP ( opt->optimize ( pmf, data ) );
+	std::vector<double> MAP;
+	if ( mapestimate==NULL ) {
+		PsiOptimizer * opt = allocateOptimizer ( optimizer, pmf, data );
+		MAP = opt->optimize ( pmf, data );
+		delete opt;
+	} else {
+		MAP = *mapestimate;
+	}
 	std::vector<double> prm ( MAP );
-	delete opt;
 	for ( i=0; i<nprm; i++ ) {
 		// std::cerr << "================= prm " << i << "================\n";
 		// Determine parameter ranges using the same routine as for starting values
@@ -340,6 +347,8 @@ MCMCList sample_posterior (
 
 	std::vector< std::vector<double> > proposed ( nproposals, std::vector<double> (nprm) );
 	std::vector<double> weights ( nproposals );
+	std::vector<double> proposal_density ( nproposals );
+	std::vector<double> neglposteriors;
 	std::vector<double> cum_probs ( nproposals );
 	std::vector<double> rnumbers ( nsamples );
 
@@ -365,7 +374,15 @@ MCMCList sample_posterior (
             q *= q_raw;
 			delete posteri;
 		}
-        p = - pmf->neglpost ( proposed[i], data );
+		proposal_density[i] = q;
+	}
+
+	// evaluate the posterior for all proposals at once
+	neglposteriors = pmf->neglpost_batch ( proposed, data );
+
+	for ( i=0; i<nproposals; i++ ) {
+		q = proposal_density[i];
+		p = - neglposteriors[i];
 		if ( std::isinf ( p ) || p!=p )
 			weights[i] = 0;
 		else
@@ -461,32 +478,31 @@ MCMCList sample_posterior (
 void sample_diagnostics (
 		const PsiPsychometric *pmf,
 		const PsiData *data,
-		MCMCList *samples
+		MCMCList *samples,
+		unsigned int burnin,
+		unsigned int thin
 		)
 {
-	unsigned int i,j,k, nprm ( pmf->getNparams() ), nblocks ( data->getNblocks() );
+	unsigned int i,j, nprm ( pmf->getNparams() ), nblocks ( data->getNblocks() );
+
+	if ( thin==0 )
+		throw BadArgumentError ( "sample_diagnostics: thin should be at least 1" );
+	if ( burnin>0 || thin>1 ) {
+		// Keep only the retained samples so that no diagnostics are calculated for discarded ones
+		unsigned int nkeep ( samples->getNsamples()>burnin ? (samples->getNsamples()-burnin+thin-1)/thin : 0 );
+		MCMCList retained ( nkeep, nprm, nblocks );
+		for ( i=0; i<nkeep; i++ )
+			retained.setEst ( i, samples->getEst ( burnin+i*thin ), samples->getdeviance ( burnin+i*thin ) );
+		retained.set_accept_rate ( samples->get_accept_rate() );
+		retained.set_entropy ( samples->get_entropy() );
+		*samples = retained;
+	}
+
 	std::vector<double> probs ( nblocks );
 	std::vector<double> est ( nprm );
 	PsiData *localdata = new PsiData ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
 	std::vector<int> posterior_predictive ( nblocks );
-
-	std::vector<double> reducedx ( data->getNblocks()-1 );
-	std::vector<int> reducedk ( data->getNblocks()-1 );
-	std::vector<int> reducedn ( data->getNblocks()-1 );
-	std::vector< PsiData* > reduceddata ( data->getNblocks() );
-
-	for ( i=0; i<nblocks; i++ ) {
-		j = 0;
-		for (k=0; k<nblocks; k++ ) {
-			if ( i!=k ) {
-				reducedx[j] = data->getIntensity(k);
-				reducedk[j] = data->getNcorrect(k);
-				reducedn[j] = data->getNtrials(k);
-				j++;
-			}
-		}
-		reduceddata[i] = new PsiData ( reducedx, reducedn, reducedk, data->getNalternatives() );
-	}
+	std::vector<double> logratios ( nblocks );
 
 	for ( i=0; i<samples->getNsamples(); i++ ) {
 		for ( j=0; j<nprm; j++ )
@@ -507,12 +523,10 @@ void sample_diagnostics (
 		samples->setppRkd ( i, pmf->getRkd ( probs, localdata ) );
 
 		// Store log posterior ratios for reduced data sets
+		logratios = pmf->logratios ( est, data );
 		for ( j=0; j<nblocks; j++ )
-			samples->setlogratio ( i, j, pmf->neglpost(est,data) - pmf->neglpost(est,reduceddata[j]) );
+			samples->setlogratio ( i, j, logratios[j] );
 	}
 
-	for ( i=0; i<nblocks; i++ ) {
-		delete reduceddata[i];
-	}
 	delete localdata;
 }
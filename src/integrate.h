@@ -68,7 +68,9 @@ class PsiIndependentPosterior {
 
 PsiIndependentPosterior independent_marginals (
 		const PsiPsychometric *pmf,    ///< psychometric function model
-		const PsiData *data            ///< dataset
+		const PsiData *data,           ///< dataset
+		PsiOptimizerType optimizer=OPTIMIZER_SIMPLEX,  ///< optimization method for the MAP estimate
+		const std::vector<double>* mapestimate=NULL    ///< MAP estimate (if NULL, the model is fitted first)
 		);  ///< determine an approximation to the posterior distribution that approximates the posterior as a product of independent distributions for all parameters
 
 MCMCList sample_posterior (
@@ -82,7 +84,9 @@ MCMCList sample_posterior (
 void sample_diagnostics (
 		const PsiPsychometric *pmf,   ///< psychometric function model
 		const PsiData *data,          ///< dataset
-		MCMCList *samples             ///< parameter samples
-		);  ///< calculate sample diagnostics
+		MCMCList *samples,            ///< parameter samples (on return, only the retained samples are left)
+		unsigned int burnin=0,        ///< number of samples at the start of the list that are discarded
+		unsigned int thin=1           ///< only every thin-th sample after the burnin is retained
+		);  ///< discard burnin and thin out samples, then calculate sample diagnostics for the retained samples
 
 #endif
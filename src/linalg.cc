@@ -42,7 +42,7 @@ double uuA ( const std::vector<double> *u, const Matrix *A, int j, int k, int l
 Matrix::Matrix ( const std::vector< std::vector<double> >& A )
 	: nrows(A.size()), ncols(A[0].size())
 {
-	data = new double [nrows*ncols];
+	data = ( nrows*ncols<=ninline ? local : new double [nrows*ncols] );
 
 	unsigned int i,j;
 	for (i=0; i<nrows; i++) {
@@ -55,7 +55,7 @@ Matrix::Matrix ( const std::vector< std::vector<double> >& A )
 Matrix::Matrix ( unsigned int nrows, unsigned int ncols)
 	: nrows(nrows), ncols(ncols)
 {
-	data = new double [nrows*ncols];
+	data = ( nrows*ncols<=ninline ? local : new double [nrows*ncols] );
 	unsigned int i;
 	for (i=0; i<nrows*ncols; i++)
 		data[i] = 0;
@@ -64,7 +64,7 @@ Matrix::Matrix ( unsigned int nrows, unsigned int ncols)
 Matrix::Matrix ( const Matrix& A )
 	: nrows(A.getnrows()), ncols(A.getncols())
 {
-	data = new double [nrows*ncols];
+	data = ( nrows*ncols<=ninline ? local : new double [nrows*ncols] );
 
 	unsigned int i,j;
 	for (i=0; i<nrows; i++) {
@@ -74,6 +74,25 @@ Matrix::Matrix ( const Matrix& A )
 	}
 }
 
+Matrix& Matrix::operator= ( const Matrix& A )
+{
+	if ( &A==this )
+		return *this;
+
+	// Copying the pointer would leave data pointing to the local storage of A or free the same array twice
+	unsigned int n ( A.getnrows()*A.getncols() );
+	double *newdata ( n<=ninline ? local : new double [n] );
+	if ( data!=local ) delete [] data;
+	data = newdata;
+	nrows = A.getnrows();
+	ncols = A.getncols();
+
+	unsigned int i;
+	for (i=0; i<n; i++)
+		data[i] = A.data[i];
+	return *this;
+}
+
 double& Matrix::operator() ( unsigned int row, unsigned int col ) const
 {
 	//row --; col --;
@@ -396,6 +415,121 @@ bool Matrix::symmetric ( void ) {
 	return true;
 }
 
+template <unsigned int N>
+static double fixed_logdet ( const Matrix& A )
+{
+	FixedMatrix<N> F ( A );
+	if ( F.cholesky_dec () )
+		return F.cholesky_logdet ();
+	// Not positive definite: the sign of the determinant decides between -inf and NaN
+	F = FixedMatrix<N> ( A );
+	if ( !F.lu_dec () )
+		return log ( 0. );
+	return F.lu_logdet ();
+}
+
+double logdet_small ( const Matrix& A )
+{
+	switch ( A.getnrows() ) {
+		case 1: return fixed_logdet<1> ( A );
+		case 2: return fixed_logdet<2> ( A );
+		case 3: return fixed_logdet<3> ( A );
+		case 4: return fixed_logdet<4> ( A );
+		case 5: return fixed_logdet<5> ( A );
+		case 6: return fixed_logdet<6> ( A );
+	}
+
+	Matrix * LU;
+	unsigned int i;
+	double l(0);
+	try {
+		LU = A.lu_dec ();
+	} catch ( std::string ) {
+		return log ( 0. );
+	}
+	// Matrix::lu_dec() does not report the row swaps, thus only the magnitude is reliable here
+	for ( i=0; i<A.getnrows(); i++ )
+		l += log ( fabs ( (*LU)(i,i) ) );
+	delete LU;
+	return l;
+}
+
+template <unsigned int N>
+static bool fixed_solve ( const Matrix& A, const double *b, double *x )
+{
+	FixedMatrix<N> F ( A );
+	double bb[N];
+	unsigned int i;
+	if ( !F.lu_dec () )
+		return false;
+	for ( i=0; i<N; i++ )
+		bb[i] = b[i];
+	F.lu_solve ( bb, x );
+	return true;
+}
+
+bool solve_small ( const Matrix& A, const double *b, double *x )
+{
+	switch ( A.getnrows() ) {
+		case 1: return fixed_solve<1> ( A, b, x );
+		case 2: return fixed_solve<2> ( A, b, x );
+		case 3: return fixed_solve<3> ( A, b, x );
+		case 4: return fixed_solve<4> ( A, b, x );
+		case 5: return fixed_solve<5> ( A, b, x );
+		case 6: return fixed_solve<6> ( A, b, x );
+	}
+
+	unsigned int i,j, n ( A.getnrows() );
+	std::vector<double> bb ( b, b+n );
+	Matrix * inv ( A.inverse_qr () );
+	for ( i=0; i<n; i++ ) {
+		x[i] = 0;
+		for ( j=0; j<n; j++ )
+			x[i] += (*inv)(i,j)*bb[j];
+	}
+	delete inv;
+	for ( i=0; i<n; i++ )
+		if ( x[i]!=x[i] || fabs(x[i])==HUGE_VAL ) return false;
+	return true;
+}
+
+template <unsigned int N>
+static bool fixed_inverse ( const Matrix& A, Matrix *inv )
+{
+	FixedMatrix<N> F ( A );
+	if ( !F.lu_dec () )
+		return false;
+	F.lu_inverse ( inv );
+	return true;
+}
+
+bool inverse_small ( const Matrix& A, Matrix *inv )
+{
+	bool done ( false );
+	switch ( A.getnrows() ) {
+		case 1: done = fixed_inverse<1> ( A, inv ); break;
+		case 2: done = fixed_inverse<2> ( A, inv ); break;
+		case 3: done = fixed_inverse<3> ( A, inv ); break;
+		case 4: done = fixed_inverse<4> ( A, inv ); break;
+		case 5: done = fixed_inverse<5> ( A, inv ); break;
+		case 6: done = fixed_inverse<6> ( A, inv ); break;
+	}
+	if ( done )
+		return true;
+
+	// Larger matrices and badly scaled matrices with tiny pivots
+	unsigned int i,j;
+	bool finite ( true );
+	Matrix * I ( A.inverse_qr () );
+	for ( i=0; i<A.getnrows(); i++ )
+		for ( j=0; j<A.getncols(); j++ ) {
+			(*inv)(i,j) = (*I)(i,j);
+			if ( (*I)(i,j)!=(*I)(i,j) || fabs((*I)(i,j))==HUGE_VAL ) finite = false;
+		}
+	delete I;
+	return finite;
+}
+
 std::vector<double> leastsq ( const Matrix *A, const std::vector<double>& b ) {
 	Matrix *M = new Matrix ( A->getnrows(), A->getncols()+1 );
 	unsigned int i, j;
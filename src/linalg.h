@@ -21,11 +21,19 @@ class MatrixError
 {
 };
 
-/** A very simple matrix class */
+/** A very simple matrix class
+ *
+ * Small matrices (up to ninline elements, e.g. the Fisher information of a psychometric function) are stored inside the
+ * object, so that a Matrix on the stack does not touch the heap.
+ */
 class Matrix
 {
+	public:
+		static const unsigned int ninline = 36;                      ///< number of elements that are stored without heap allocation
+		static const unsigned int nsmall = 6;                        ///< number of rows of the largest square matrix that is stored without heap allocation
 	private:
 		double *data;
+		double local[ninline];
 		unsigned int nrows;
 		unsigned int ncols;
 		// given a decomposition A=LU these two methods help solving the equation Ax=b:
@@ -35,7 +43,8 @@ class Matrix
 		Matrix ( const std::vector< std::vector<double> >& A );      ///< Construct a matrix from a vector of vectors
 		Matrix ( unsigned int nrows, unsigned int ncols);                   ///< Construct a matrix with given dimensions initialized to 0
 		Matrix ( const Matrix& A );                                  ///< copy a matrix
-		~Matrix ( void ) { delete [] data; }                         ///< delete a matrix
+		Matrix& operator= ( const Matrix& A );                       ///< assign a matrix (the dimensions may change)
+		~Matrix ( void ) { if ( data!=local ) delete [] data; }     ///< delete a matrix
 		double& operator() ( unsigned int i, unsigned int j ) const; ///< data access to the element in row i and column j (indices starting with 0!)
 		void print ( void );                                         ///< print the matrix to stdout
 		unsigned int getnrows ( void ) const { return nrows; }       ///< get the number of rows
@@ -52,6 +61,211 @@ class Matrix
 		bool symmetric ( void );                                     ///< check whether the matrix is symmetric
 };
 
+/** \brief square matrix with a size that is known at compile time
+ *
+ * The elements are stored on the stack and all loops have a fixed number of iterations, so the compiler can unroll them.
+ * This is meant for the Fisher information and Hessian of the psychometric function, that are solved and inverted many
+ * times during sampling and optimization. Unlike Matrix::lu_dec(), lu_dec() keeps track of the row permutation.
+ */
+template <unsigned int N>
+class FixedMatrix
+{
+	private:
+		double data[N][N];
+		unsigned int perm[N];      // row permutation after lu_dec()
+		int permsign;              // sign of the permutation after lu_dec()
+	public:
+		FixedMatrix ( void ) : permsign ( 1 ) {
+			unsigned int i,j;
+			for ( i=0; i<N; i++ ) {
+				perm[i] = i;
+				for ( j=0; j<N; j++ )
+					data[i][j] = 0;
+			}
+		}   ///< construct a matrix that is initialized to 0
+		FixedMatrix ( const Matrix& A ) : permsign ( 1 ) {
+			unsigned int i,j;
+			if ( A.getnrows()!=N || A.getncols()!=N )
+				throw MatrixError();
+			for ( i=0; i<N; i++ ) {
+				perm[i] = i;
+				for ( j=0; j<N; j++ )
+					data[i][j] = A(i,j);
+			}
+		}   ///< copy an NxN Matrix
+		double& operator() ( unsigned int i, unsigned int j ) { return data[i][j]; }        ///< element in row i and column j
+		double operator() ( unsigned int i, unsigned int j ) const { return data[i][j]; }   ///< element in row i and column j
+		bool cholesky_dec ( void );                                  ///< replace the matrix by L with L*L^T = A (returns false if A is not positive definite)
+		bool lu_dec ( void );                                        ///< replace the matrix by its LU decomposition with partial pivoting (returns false if A is numerically singular)
+		void lu_solve ( const double *b, double *x ) const;          ///< solve Ax=b after lu_dec()
+		void cholesky_solve ( const double *b, double *x ) const;    ///< solve Ax=b after cholesky_dec()
+		double lu_logdet ( void ) const;                             ///< log of the determinant after lu_dec() (NaN if the determinant is negative)
+		double cholesky_logdet ( void ) const;                       ///< log of the determinant after cholesky_dec()
+		void lu_inverse ( Matrix *inv ) const;                       ///< write the inverse to inv after lu_dec()
+};
+
+template <unsigned int N>
+bool FixedMatrix<N>::cholesky_dec ( void )
+{
+	unsigned int j,k,K;
+	double s;
+	for ( K=0; K<N; K++ ) {
+		s = data[K][K];
+		for ( k=0; k<K; k++ )
+			s -= data[K][k]*data[K][k];
+		if ( !(s>0) )
+			return false;
+		data[K][K] = sqrt ( s );
+		for ( j=K+1; j<N; j++ ) {
+			s = data[j][K];
+			for ( k=0; k<K && k<N; k++ )   // k<N is implied by K<N but lets the compiler see that data[j][k] is in range
+				s -= data[j][k]*data[K][k];
+			data[j][K] = s/data[K][K];
+			data[K][j] = 0;
+		}
+	}
+	return true;
+}
+
+template <unsigned int N>
+bool FixedMatrix<N>::lu_dec ( void )
+{
+	unsigned int i,j,k,pivotindex,itmp;
+	double pivot,c;
+
+	permsign = 1;
+	for ( i=0; i<N; i++ )
+		perm[i] = i;
+
+	for ( i=0; i<N; i++ ) {
+		pivot = fabs ( data[i][i] );
+		pivotindex = i;
+		for ( k=i+1; k<N; k++ ) {
+			if ( fabs ( data[k][i] )>pivot ) {
+				pivot = fabs ( data[k][i] );
+				pivotindex = k;
+			}
+		}
+		if ( !(pivot>=1e-8) )
+			return false;
+		if ( pivotindex!=i ) {
+			// Swap complete rows, including the part of L that is already computed
+			for ( j=0; j<N; j++ ) {
+				c = data[pivotindex][j];
+				data[pivotindex][j] = data[i][j];
+				data[i][j] = c;
+			}
+			itmp = perm[pivotindex]; perm[pivotindex] = perm[i]; perm[i] = itmp;
+			permsign = -permsign;
+		}
+		for ( k=i+1; k<N; k++ ) {
+			c = data[k][i] / data[i][i];
+			data[k][i] = c;
+			for ( j=i+1; j<N; j++ )
+				data[k][j] -= c*data[i][j];
+		}
+	}
+	return true;
+}
+
+template <unsigned int N>
+void FixedMatrix<N>::lu_solve ( const double *b, double *x ) const
+{
+	unsigned int i,k;
+	double y[N];
+	double s;
+	for ( i=0; i<N; i++ ) {
+		s = b[perm[i]];
+		for ( k=0; k<i; k++ )
+			s -= data[i][k]*y[k];
+		y[i] = s;
+	}
+	for ( i=N-1; i<N; i-- ) {  // stops after i wrapped around below 0
+		s = y[i];
+		for ( k=i+1; k<N; k++ )
+			s -= data[i][k]*x[k];
+		x[i] = s/data[i][i];
+	}
+}
+
+template <unsigned int N>
+void FixedMatrix<N>::cholesky_solve ( const double *b, double *x ) const
+{
+	unsigned int i,k;
+	double y[N];
+	double s;
+	for ( i=0; i<N; i++ ) {
+		s = b[i];
+		for ( k=0; k<i; k++ )
+			s -= data[i][k]*y[k];
+		y[i] = s/data[i][i];
+	}
+	for ( i=N-1; i<N; i-- ) {
+		s = y[i];
+		for ( k=i+1; k<N; k++ )
+			s -= data[k][i]*x[k];
+		x[i] = s/data[i][i];
+	}
+}
+
+template <unsigned int N>
+double FixedMatrix<N>::lu_logdet ( void ) const
+{
+	unsigned int i;
+	double l(0);
+	int s ( permsign );
+	for ( i=0; i<N; i++ ) {
+		l += log ( fabs ( data[i][i] ) );
+		if ( data[i][i]<0 ) s = -s;
+	}
+	return s>0 ? l : log ( -1. );
+}
+
+template <unsigned int N>
+double FixedMatrix<N>::cholesky_logdet ( void ) const
+{
+	unsigned int i;
+	double l(0);
+	for ( i=0; i<N; i++ )
+		l += log ( data[i][i] );
+	return 2*l;
+}
+
+template <unsigned int N>
+void FixedMatrix<N>::lu_inverse ( Matrix *inv ) const
+{
+	unsigned int i,j;
+	double e[N], x[N];
+	for ( j=0; j<N; j++ ) {
+		for ( i=0; i<N; i++ )
+			e[i] = i==j;
+		lu_solve ( e, x );
+		for ( i=0; i<N; i++ )
+			(*inv)(i,j) = x[i];
+	}
+}
+
+/** \brief log determinant of a small symmetric matrix
+ *
+ * Positive definite matrices with up to 6 rows are handled by a FixedMatrix on the stack. The result is -inf for a
+ * singular matrix and NaN for a matrix with negative determinant.
+ */
+double logdet_small ( const Matrix& A );
+
+/** \brief solve Ax=b for a small square matrix A
+ *
+ * Matrices with up to 6 rows are handled by a FixedMatrix on the stack, larger matrices fall back to Matrix::qr_dec().
+ * Returns false if A is numerically singular. x may point to b.
+ */
+bool solve_small ( const Matrix& A, const double *b, double *x );
+
+/** \brief invert a small square matrix A
+ *
+ * Matrices with up to 6 rows are handled by a FixedMatrix on the stack. Larger matrices and matrices with pivots below
+ * 1e-8 fall back to Matrix::inverse_qr(). Returns false if the inverse is not finite.
+ */
+bool inverse_small ( const Matrix& A, Matrix *inv );
+
 std::vector<double> leastsq ( const Matrix *A, const std::vector<double>& b );  ///< return the least squares solution to the problem Ax=b
 
 std::vector<double> leastsq ( const Matrix *M ); ///< return the least squares solution of the problem Ax=b, where M = [A,b]
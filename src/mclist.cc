@@ -4,17 +4,53 @@
  */
 #include "mclist.h"
 
-void newsample ( const PsiData * data, const std::vector<double>& p, std::vector<int> * sample ) {
+void newsample ( const PsiData * data, const std::vector<double>& p, std::vector<int> * sample, PsiRandomStream * stream ) {
 	/* Draw a new sample from the psychometric function */
 	BinomialRandom binomial ( 10, 0.5 );    // Initialize with nonsense parameters
 	unsigned int k;                                            // Block index
 
+	binomial.setStream ( stream );
+
 	for ( k=0; k<data->getNblocks(); k++ ) {
 		binomial.setprm ( data->getNtrials(k), p[k] );
 		(*sample)[k] = binomial.draw ();
 	}
 }
 
+/************************************************************
+ * PsiOrderStatistics methods
+ */
+
+static bool nan_last_less ( double a, double b )
+{
+	// a strict weak ordering that puts nan behind all numbers (operator< is not one if the column holds nan)
+	return a<b || ( a==a && b!=b );
+}
+
+double PsiOrderStatistics::get ( const double * column, unsigned int n, unsigned int stride, unsigned int position )
+{
+	unsigned int i;
+	if ( n==0 )
+		throw BadIndexError();
+	if ( position>=n )
+		position = n-1;
+
+	if ( sorted.size()!=n ) {
+		// First query: partial ordering is enough for a single element
+		sorted.resize ( n );
+		for ( i=0; i<n; i++ )
+			sorted[i] = column[i*stride];
+		std::nth_element ( sorted.begin(), sorted.begin()+position, sorted.end(), nan_last_less );
+		return sorted[position];
+	}
+
+	if ( !issorted ) {
+		std::sort ( sorted.begin(), sorted.end(), nan_last_less );
+		issorted = true;
+	}
+	return sorted[position];
+}
+
 /************************************************************
  * PsiMClist methods
  */
@@ -29,7 +65,7 @@ std::vector<double> PsiMClist::getEst ( unsigned int i ) const
 	std::vector<double> out ( getNparams() );
 
 	for (k=0; k<getNparams(); k++)
-		out[k] = mcestimates[k][i];
+		out[k] = mcestimates[i*nparams+k];
 
 	return out;
 }
@@ -42,7 +78,7 @@ double PsiMClist::getEst ( unsigned int i, unsigned int prm ) const
 	if ( prm>=getNparams() )
 		throw BadIndexError();
 
-	return mcestimates[prm][i];
+	return mcestimates[i*nparams+prm];
 }
 
 void PsiMClist::setEst ( unsigned int i, const std::vector<double> est, double deviance )
@@ -52,9 +88,12 @@ void PsiMClist::setEst ( unsigned int i, const std::vector<double> est, double d
 		throw BadIndexError();
 
 	unsigned int k;
-	for ( k=0; k<getNparams(); k++ )
-		mcestimates[k][i] = est[k];
+	for ( k=0; k<getNparams(); k++ ) {
+		mcestimates[i*nparams+k] = est[k];
+		estimateorder[k].invalidate ();
+	}
 	deviances[i] = deviance;
+	devianceorder.invalidate ();
 }
 
 double PsiMClist::getPercentile ( double p, unsigned int prm ) {
@@ -64,11 +103,10 @@ double PsiMClist::getPercentile ( double p, unsigned int prm ) {
 		throw BadArgumentError();
 
 	int position;
-	sort( mcestimates[prm].begin(),mcestimates[prm].end() );
 
 	position = getNsamples()*p;
 
-	return mcestimates[prm][position];
+	return estimateorder[prm].get ( &(mcestimates[prm]), getNsamples(), nparams, position );
 }
 
 void PsiMClist::setdeviance ( unsigned int i, double deviance ) {
@@ -76,6 +114,7 @@ void PsiMClist::setdeviance ( unsigned int i, double deviance ) {
 		throw BadIndexError();
 
 	deviances[i] = deviance;
+	devianceorder.invalidate ();
 }
 
 double PsiMClist::getdeviance ( unsigned int i ) const {
@@ -91,9 +130,7 @@ double PsiMClist::getDeviancePercentile ( double p ) {
 
 	int ind ( p*deviances.size() );
 
-	sort( deviances.begin(), deviances.end() );
-
-	return deviances[ind];
+	return devianceorder.get ( &(deviances[0]), deviances.size(), 1, ind );
 }
 
 double PsiMClist::getMean ( unsigned int prm ) const {
@@ -134,8 +171,8 @@ void BootstrapList::setData ( unsigned int i, const std::vector<int>& newdata )
 		throw BadIndexError();
 
 	unsigned int k;
-	for ( k=0; k<getNblocks(); k++ )
-		data[i][k] = newdata[k];
+	for ( k=0; k<nblocks; k++ )
+		data[i*nblocks+k] = newdata[k];
 }
 
 std::vector<int> BootstrapList::getData ( unsigned int i ) const
@@ -143,7 +180,7 @@ std::vector<int> BootstrapList::getData ( unsigned int i ) const
 	if ( i>=getNsamples() || i<0 )
 		throw BadIndexError();
 
-	return data[i];
+	return std::vector<int> ( data.begin()+i*nblocks, data.begin()+(i+1)*nblocks );
 }
 
 double BootstrapList::getThres ( double p, unsigned int cut ) {
@@ -153,7 +190,6 @@ double BootstrapList::getThres ( double p, unsigned int cut ) {
 		throw BadArgumentError();
 
 	int position;
-	sort( thresholds[cut].begin(), thresholds[cut].end() );
 
 	// Bias correction of p
 	if (BCa)
@@ -161,16 +197,16 @@ double BootstrapList::getThres ( double p, unsigned int cut ) {
 
 	position = int(getNsamples()*p);
 
-	return thresholds[cut][position];
+	return thresholdorder[cut].get ( &(thresholds[cut]), getNsamples(), cuts.size(), position );
 }
 
 double BootstrapList::getThres_byPos ( unsigned int i, unsigned int cut ) {
 	if ( cut>=cuts.size() )
 		throw BadIndexError();
-	if (i>getNsamples())
+	if (i>=getNsamples())
 		throw BadIndexError();
 
-	return thresholds[cut][i];
+	return thresholds[i*cuts.size()+cut];
 }
 
 void BootstrapList::setThres ( double thres, unsigned int i, unsigned int cut )
@@ -180,7 +216,8 @@ void BootstrapList::setThres ( double thres, unsigned int i, unsigned int cut )
 	if (cut>=cuts.size() )
 		throw BadIndexError();
 
-	thresholds[cut][i] = thres;
+	thresholds[i*cuts.size()+cut] = thres;
+	thresholdorder[cut].invalidate ();
 }
 
 double BootstrapList::getSlope ( double p, unsigned int cut ) {
@@ -190,7 +227,6 @@ double BootstrapList::getSlope ( double p, unsigned int cut ) {
 		throw BadArgumentError();
 
 	int position;
-	sort( slopes[cut].begin(), slopes[cut].end() );
 
 	// Bias correction of p
 	if (BCa)
@@ -198,16 +234,16 @@ double BootstrapList::getSlope ( double p, unsigned int cut ) {
 
 	position = int(getNsamples()*p);
 
-	return slopes[cut][position];
+	return slopeorder[cut].get ( &(slopes[cut]), getNsamples(), cuts.size(), position );
 }
 
 double BootstrapList::getSlope_byPos ( unsigned int i, unsigned int cut ) {
 	if ( cut>=cuts.size() )
 		throw BadIndexError();
-	if (i>getNsamples())
+	if (i>=getNsamples())
 		throw BadIndexError();
 
-	return slopes[cut][i];
+	return slopes[i*cuts.size()+cut];
 }
 
 void BootstrapList::setSlope ( double slope, unsigned int i, unsigned int cut )
@@ -217,7 +253,8 @@ void BootstrapList::setSlope ( double slope, unsigned int i, unsigned int cut )
 	if (cut>=cuts.size() )
 		throw BadIndexError();
 
-	slopes[cut][i] = slope;
+	slopes[i*cuts.size()+cut] = slope;
+	slopeorder[cut].invalidate ();
 }
 
 double BootstrapList::getCut ( unsigned int i ) const
@@ -233,6 +270,7 @@ void BootstrapList::setRpd ( unsigned int i, double r_pd ) {
 		throw BadIndexError();
 
 	Rpd[i] = r_pd;
+	Rpdorder.invalidate ();
 }
 
 double BootstrapList::getRpd ( unsigned int i ) const {
@@ -248,9 +286,7 @@ double BootstrapList::percRpd ( double p ) {
 
 	int index ( p*(getNsamples()-1));
 
-	sort ( Rpd.begin(), Rpd.end() );
-
-	return Rpd[index];
+	return Rpdorder.get ( &(Rpd[0]), Rpd.size(), 1, index );
 }
 
 void BootstrapList::setRkd ( unsigned int i, double r_kd ) {
@@ -258,6 +294,7 @@ void BootstrapList::setRkd ( unsigned int i, double r_kd ) {
 		throw BadIndexError();
 
 	Rkd[i] = r_kd;
+	Rkdorder.invalidate ();
 }
 
 double BootstrapList::getRkd ( unsigned int i ) const {
@@ -267,15 +304,27 @@ double BootstrapList::getRkd ( unsigned int i ) const {
 	return Rkd[i];
 }
 
+void BootstrapList::setOptimizerReport ( unsigned int i, const PsiOptimizerReport& report ) {
+	if ( i>=getNsamples() )
+		throw BadIndexError();
+
+	optimizerreports[i] = report;
+}
+
+PsiOptimizerReport BootstrapList::getOptimizerReport ( unsigned int i ) const {
+	if ( i>=getNsamples() )
+		throw BadIndexError();
+
+	return optimizerreports[i];
+}
+
 double BootstrapList::percRkd ( double p ) {
 	if ( p<0 || p>1 )
 		throw BadIndexError();
 
 	int index ( p*(getNsamples()-1) );
 
-	sort ( Rkd.begin(), Rkd.end() );
-
-	return Rkd[index];
+	return Rkdorder.get ( &(Rkd[0]), Rkd.size(), 1, index );
 }
 
 /************************************************************
@@ -309,18 +358,63 @@ bool JackKnifeList::outlier ( unsigned int block ) const {
 	return false;
 }
 
+void JackKnifeList::setOptimizerReport ( unsigned int block, const PsiOptimizerReport& report ) {
+	if ( block>=getNblocks() )
+		throw BadIndexError();
+
+	optimizerreports[block] = report;
+}
+
+PsiOptimizerReport JackKnifeList::getOptimizerReport ( unsigned int block ) const {
+	if ( block>=getNblocks() )
+		throw BadIndexError();
+
+	return optimizerreports[block];
+}
+
 /************************************************************
  * MCMCList methods
  */
 
+void MCMCList::setRecord ( unsigned int i, const MCMCSampleRecord& record )
+{
+	unsigned int k;
+	setEst ( i, record.est, record.deviance );
+	setppData ( i, record.ppdata, record.ppdeviance );
+	posterior_Rpd[i] = record.Rpd;
+	posterior_Rkd[i] = record.Rkd;
+	posterior_predictive_Rpd[i] = record.ppRpd;
+	posterior_predictive_Rkd[i] = record.ppRkd;
+	for ( k=0; k<nblocks; k++ )
+		logratios[i*nblocks+k] = record.logratios[k];
+}
+
+MCMCSampleRecord MCMCList::getRecord ( unsigned int i ) const
+{
+	if ( i>=getNsamples() )
+		throw BadIndexError ();
+
+	MCMCSampleRecord record;
+	record.est = getEst ( i );
+	record.deviance = getdeviance ( i );
+	record.ppdata = getppData ( i );
+	record.ppdeviance = posterior_predictive_deviances[i];
+	record.Rpd = posterior_Rpd[i];
+	record.Rkd = posterior_Rkd[i];
+	record.ppRpd = posterior_predictive_Rpd[i];
+	record.ppRkd = posterior_predictive_Rkd[i];
+	record.logratios = std::vector<double> ( logratios.begin()+i*nblocks, logratios.begin()+(i+1)*nblocks );
+	return record;
+}
+
 void MCMCList::setppData ( unsigned int i, const std::vector<int>& ppdata, double ppdeviance )
 {
 	if ( i>=getNsamples() || i<0 )
 		throw BadIndexError ();
 
 	unsigned int k;
-	for ( k=0; k<getNblocks(); k++ )
-		posterior_predictive_data[i][k] = ppdata[k];
+	for ( k=0; k<nblocks; k++ )
+		posterior_predictive_data[i*nblocks+k] = ppdata[k];
 	posterior_predictive_deviances[i] = ppdeviance;
 }
 
@@ -329,7 +423,7 @@ std::vector<int> MCMCList::getppData ( unsigned int i ) const
 	if ( i>=getNsamples() || i<0 )
 		throw BadIndexError();
 
-	return posterior_predictive_data[i];
+	return std::vector<int> ( posterior_predictive_data.begin()+i*nblocks, posterior_predictive_data.begin()+(i+1)*nblocks );
 }
 
 int MCMCList::getppData ( unsigned int i, unsigned int j ) const
@@ -339,7 +433,7 @@ int MCMCList::getppData ( unsigned int i, unsigned int j ) const
 	if ( j>=getNblocks() )
 		throw BadIndexError();
 
-	return posterior_predictive_data[i][j];
+	return posterior_predictive_data[i*nblocks+j];
 }
 
 double MCMCList::getppDeviance ( unsigned int i ) const
@@ -422,7 +516,7 @@ void MCMCList::setlogratio ( unsigned int i, unsigned int j, double logratio )
 	if ( j>=getNblocks() )
 		throw BadIndexError();
 
-	logratios[i][j] = logratio;
+	logratios[i*nblocks+j] = logratio;
 }
 
 double MCMCList::getlogratio ( unsigned int i, unsigned int j ) const
@@ -432,5 +526,37 @@ double MCMCList::getlogratio ( unsigned int i, unsigned int j ) const
 	if ( j>=getNblocks() )
 		throw BadIndexError();
 
-	return logratios[i][j];
+	return logratios[i*nblocks+j];
+}
+
+void MCMCList::setRhat ( unsigned int prm, double R )
+{
+	if ( prm>=getNparams() )
+		throw BadIndexError();
+
+	Rhat[prm] = R;
+}
+
+double MCMCList::getRhat ( unsigned int prm ) const
+{
+	if ( prm>=getNparams() )
+		throw BadIndexError();
+
+	return Rhat[prm];
+}
+
+void MCMCList::setNeff ( unsigned int prm, double n )
+{
+	if ( prm>=getNparams() )
+		throw BadIndexError();
+
+	neff[prm] = n;
+}
+
+double MCMCList::getNeff ( unsigned int prm ) const
+{
+	if ( prm>=getNparams() )
+		throw BadIndexError();
+
+	return neff[prm];
 }
@@ -13,23 +13,56 @@
 #include "special.h"
 #include "data.h"
 #include "rng.h"
+#include "optimizer.h"
+
+/** \brief order statistics of a column of samples
+ *
+ * Percentiles are read from a sorted copy of the column, so that the order of the samples themselves is never changed.
+ * The first query selects the requested element with nth_element in O(N). From the second query on, the copy is sorted
+ * completely and further queries are lookups. The copy has to be invalidated whenever the column changes. Samples that
+ * are nan (e.g. Rkd of a sample with constant deviance residuals) are placed behind all other samples, so that a
+ * percentile does not depend on the order of the queries.
+ */
+class PsiOrderStatistics
+{
+	private:
+		std::vector<double> sorted;
+		bool issorted;
+	public:
+		PsiOrderStatistics ( void ) : issorted ( false ) {}           ///< set up an empty index
+		void invalidate ( void ) { sorted.clear(); issorted=false; }  ///< forget the index after the column changed
+		double get (
+			const double * column,                                     ///< first element of the column of samples (not changed)
+			unsigned int n,                                            ///< number of samples in the column
+			unsigned int stride,                                       ///< distance between successive samples of the column
+			unsigned int position                                      ///< position in the sorted column (clipped to the last sample)
+			);   ///< get the element at position of the sorted column
+};
 
 /** \brief basic monte carlo samples list
  *
  * This list stores monte carlo samples and deviances, nothing else.
+ *
+ * Each field of a list is stored in one contiguous buffer. Buffers with more than one value per sample are row major:
+ * row i holds the values of sample i, so that element (i,j) of a buffer with ncols columns is at buffer[i*ncols+j].
+ * The get...Buffer() methods give read access to these buffers (e.g. to wrap them as NumPy arrays without copying).
+ * The pointers remain valid as long as the list exists.
  */
 class PsiMClist
 {
 	private:
-		std::vector< std::vector<double> > mcestimates;
+		unsigned int nparams;
+		std::vector<double> mcestimates;           // getNsamples() x getNparams()
 		std::vector<double> deviances;
+		std::vector<PsiOrderStatistics> estimateorder;
+		PsiOrderStatistics devianceorder;
 	public:
 		PsiMClist (
 			int N,                      ///< number of samples to be drawn
 			int nprm                    ///< number of parameters in the model that is analyzed
-			) : mcestimates(nprm, std::vector<double>(N) ), deviances(N) {}   ///< Initialize the list to take N samples of nprm parameters
-		PsiMClist ( const PsiMClist& mclist ) : mcestimates ( mclist.mcestimates ), deviances ( mclist.deviances ) {}   ///< copy a list of mcsamples
-		~PsiMClist ( ) {} ///< destructor
+			) : nparams(nprm), mcestimates(N*nprm), deviances(N), estimateorder(nprm) {}   ///< Initialize the list to take N samples of nprm parameters
+		PsiMClist ( const PsiMClist& mclist ) : nparams ( mclist.nparams ), mcestimates ( mclist.mcestimates ), deviances ( mclist.deviances ), estimateorder ( mclist.nparams ) {}   ///< copy a list of mcsamples
+		virtual ~PsiMClist ( ) {} ///< destructor
 		std::vector<double> getEst ( unsigned int i ) const;       ///< get a single parameter estimate at sample i
 		double getEst (
 			unsigned int i,                                        ///< sample index
@@ -52,9 +85,11 @@ class PsiMClist
 			unsigned int prm                             ///< index of the parameter of interest
 			) const ;                                                          ///< get the standard deviantion of parameter prm
 		double getdeviance ( unsigned int i ) const;                                    ///< get the deviance of sample i
-		unsigned int getNsamples ( void ) const { return mcestimates[0].size(); }       ///< get the total number of samples
-		unsigned int getNparams ( void ) const { return mcestimates.size(); }           ///< get the number of parameters
+		unsigned int getNsamples ( void ) const { return deviances.size(); }            ///< get the total number of samples
+		unsigned int getNparams ( void ) const { return nparams; }                      ///< get the number of parameters
 		double getDeviancePercentile ( double p );                             ///< get the p-percentile of the deviance (p in the range (0,1) )
+		const double * getEstBuffer ( void ) const { return mcestimates.empty() ? NULL : &(mcestimates[0]); }  ///< all estimates (getNsamples() x getNparams(), row major)
+		const double * getDevianceBuffer ( void ) const { return deviances.empty() ? NULL : &(deviances[0]); } ///< deviances of all samples
 };
 
 /** \brief list of bootstrap samples
@@ -74,12 +109,19 @@ class BootstrapList : public PsiMClist
 		std::vector<double> bias_t;
 		std::vector<double> acceleration_s;
 		std::vector<double> bias_s;
-		std::vector< std::vector<int> > data;
+		unsigned int nblocks;
+		std::vector<int> data;                           // getNsamples() x getNblocks()
 		std::vector<double> cuts;
-		std::vector< std::vector<double> > thresholds;
-		std::vector< std::vector<double> > slopes;
+		std::vector<double> thresholds;                  // getNsamples() x number of cuts
+		std::vector<double> slopes;                      // getNsamples() x number of cuts
 		std::vector<double> Rpd;
 		std::vector<double> Rkd;
+		std::vector<PsiOptimizerReport> optimizerreports;
+		PsiOptimizerReport optimizertotal;
+		std::vector<PsiOrderStatistics> thresholdorder;
+		std::vector<PsiOrderStatistics> slopeorder;
+		PsiOrderStatistics Rpdorder;
+		PsiOrderStatistics Rkdorder;
 	public:
 		BootstrapList (
 			unsigned int N,                                              ///< number of samples to be drawn
@@ -92,12 +134,16 @@ class BootstrapList : public PsiMClist
 				bias_t(Cuts.size()),
 				acceleration_s(Cuts.size()),
 				bias_s(Cuts.size()),
-				data(N,std::vector<int>(nblocks)),
+				nblocks(nblocks),
+				data(N*nblocks),
 				cuts(Cuts),
-				thresholds (Cuts.size(), std::vector<double> (N)),
-				slopes     (Cuts.size(), std::vector<double> (N)),
+				thresholds (N*Cuts.size()),
+				slopes     (N*Cuts.size()),
 				Rpd(N),
-				Rkd(N)
+				Rkd(N),
+				optimizerreports(N),
+				thresholdorder(Cuts.size()),
+				slopeorder(Cuts.size())
 			{ } ///< set up the list
 		// TODO: should setBCa be private and friend of parametric bootstrap?
 		void setBCa_t (
@@ -130,7 +176,7 @@ class BootstrapList : public PsiMClist
 				unsigned int cut      ///< index of the desired cut
 				);  ///< set the value of the slope associated with the threshold at cut
 
-		unsigned int getNblocks ( void ) const { return data[0].size(); }  ///< get the number of blocks in the underlying dataset
+		unsigned int getNblocks ( void ) const { return nblocks; }         ///< get the number of blocks in the underlying dataset
 		double getCut ( unsigned int i ) const;                            ///< get the value of cut i
 		double getAcc_t ( unsigned int i ) const { return acceleration_t[i]; } ///< get the acceleration constant for cut i
 		double getBias_t ( unsigned int i ) const { return bias_t[i]; }       ///< get the bias for cut i
@@ -146,6 +192,15 @@ class BootstrapList : public PsiMClist
 		void setRkd ( unsigned int i, double r_kd );                       ///< set correlation between block index and deviance residuals for a simulated dataset
 		double getRkd ( unsigned int i ) const;                            ///< get correlation between block index and deviance residuals for simulated dataset i
 		double percRkd ( double p );                                       ///< get the p-th percentile of the correlations between block index and deviance residuals
+		void setOptimizerReport ( unsigned int i, const PsiOptimizerReport& report );  ///< set the report of the fit(s) of bootstrap sample i
+		PsiOptimizerReport getOptimizerReport ( unsigned int i ) const;    ///< get the report of the fit(s) of bootstrap sample i
+		void setOptimizerTotal ( const PsiOptimizerReport& report ) { optimizertotal = report; } ///< set the summed report of all fits in the bootstrap run
+		PsiOptimizerReport getOptimizerTotal ( void ) const { return optimizertotal; } ///< get the summed report of all fits in the bootstrap run (including the fit to the original data)
+		const int * getDataBuffer ( void ) const { return data.empty() ? NULL : &(data[0]); }                   ///< all simulated data sets (getNsamples() x getNblocks(), row major)
+		const double * getThresBuffer ( void ) const { return thresholds.empty() ? NULL : &(thresholds[0]); }   ///< all thresholds (getNsamples() x number of cuts, row major)
+		const double * getSlopeBuffer ( void ) const { return slopes.empty() ? NULL : &(slopes[0]); }           ///< all slopes (getNsamples() x number of cuts, row major)
+		const double * getRpdBuffer ( void ) const { return Rpd.empty() ? NULL : &(Rpd[0]); }                   ///< correlations between predicted values and deviance residuals of all samples
+		const double * getRkdBuffer ( void ) const { return Rkd.empty() ? NULL : &(Rkd[0]); }                   ///< correlations between block index and deviance residuals of all samples
 };
 
 /** \brief list of JackKnife data
@@ -158,13 +213,15 @@ class JackKnifeList : public PsiMClist
 	private:
 		double maxdeviance;
 		std::vector<double> mlestimate;
+		std::vector<PsiOptimizerReport> optimizerreports;
+		PsiOptimizerReport optimizertotal;
 	public:
 		JackKnifeList (
 			unsigned int nblocks,                                             ///< number of blocks in the experiment
 			unsigned int nprm,                                                ///< number of parameters in the model
 			double maxldev,                                                   ///< deviance of the maximum likelihood estimate on the full dataset
 			std::vector<double> maxlest                                       ///< maximum likelihood estimate of the full dataset
-			) : PsiMClist ( nblocks, nprm ), maxdeviance(maxldev), mlestimate(maxlest) {}    ///< constructor
+			) : PsiMClist ( nblocks, nprm ), maxdeviance(maxldev), mlestimate(maxlest), optimizerreports(nblocks) {}    ///< constructor
 		unsigned int getNblocks ( void ) const { return getNsamples(); } ///< get the number of blocks in the current experiment
 		/** determination of influential observations is performed by checking whether a parameter changes significantly (as defined by
 		 * the confidence intervals) if one observation is omitted. Thus, if leaving out one observation results in significant changes
@@ -186,6 +243,27 @@ class JackKnifeList : public PsiMClist
 		 * \return true if block presents an outlier
 		 */
 		bool outlier ( unsigned int block ) const ; ///< is block an outlier?
+		void setOptimizerReport ( unsigned int block, const PsiOptimizerReport& report );  ///< set the report of the fit without block
+		PsiOptimizerReport getOptimizerReport ( unsigned int block ) const; ///< get the report of the fit without block
+		void setOptimizerTotal ( const PsiOptimizerReport& report ) { optimizertotal = report; } ///< set the summed report of all fits
+		PsiOptimizerReport getOptimizerTotal ( void ) const { return optimizertotal; } ///< get the summed report of all fits (including the fit to the full dataset)
+};
+
+/** \brief everything that is stored about a single posterior sample
+ *
+ * MCMC samplers fill one record per retained sample and pass it on to an MCMCList or to a streaming MCMCSummary.
+ */
+struct MCMCSampleRecord
+{
+	std::vector<double> est;            ///< parameters of the sample
+	double deviance;                    ///< deviance of the sample on the observed data
+	std::vector<int> ppdata;            ///< posterior predictive data set (response counts)
+	double ppdeviance;                  ///< deviance of the sample on the posterior predictive data set
+	double Rpd;                         ///< correlation between prediction and deviance residuals on the observed data
+	double Rkd;                         ///< correlation between block index and deviance residuals on the observed data
+	double ppRpd;                       ///< correlation between prediction and deviance residuals on the posterior predictive data
+	double ppRkd;                       ///< correlation between block index and deviance residuals on the posterior predictive data
+	std::vector<double> logratios;      ///< log posterior ratios for leaving out each block
 };
 
 /** \brief a list of Bayesian MCMC samples
@@ -201,13 +279,17 @@ class MCMCList : public PsiMClist
 	private:
 		std::vector<double> posterior_Rpd;
 		std::vector<double> posterior_Rkd;
-		std::vector< std::vector<int> > posterior_predictive_data;
+		unsigned int nblocks;
+		std::vector<int> posterior_predictive_data;          // getNsamples() x getNblocks()
 		std::vector<double> posterior_predictive_deviances;
 		std::vector<double> posterior_predictive_Rpd;
 		std::vector<double> posterior_predictive_Rkd;
-		std::vector< std::vector<double> > logratios;       // log ratios of the unnormalized posteriors for the full model and the models with one block omitted
+		std::vector<double> logratios;       // log ratios of the unnormalized posteriors for the full model and the models with one block omitted (getNsamples() x getNblocks())
 		double accept_rate;
 		double H;
+		unsigned int nchains;
+		std::vector<double> Rhat;
+		std::vector<double> neff;
 	public:
 		MCMCList (
 			unsigned int N,                                                ///< number of samples to be drawn
@@ -216,11 +298,22 @@ class MCMCList : public PsiMClist
 			) : PsiMClist ( N, nprm),
 				posterior_Rpd(N),
 				posterior_Rkd(N),
-				posterior_predictive_data(N,std::vector<int>(nblocks)),
+				nblocks(nblocks),
+				posterior_predictive_data(N*nblocks),
 				posterior_predictive_deviances ( N ),
 				posterior_predictive_Rpd ( N ),
 				posterior_predictive_Rkd ( N ),
-				logratios ( N, std::vector<double>(nblocks ) ) {};      ///< set up MCMCList
+				logratios ( N*nblocks ),
+				accept_rate ( 0 ),
+				H ( 0 ),
+				nchains ( 1 ),
+				Rhat ( nprm, 0 ),
+				neff ( nprm, 0 ) {};      ///< set up MCMCList
+		void setRecord (
+			unsigned int i,                                                ///< index of the sample to be set
+			const MCMCSampleRecord& record                                 ///< everything that is known about the sample
+			);               ///< store a complete sample
+		MCMCSampleRecord getRecord ( unsigned int i ) const;               ///< get everything that is stored for sample i
 		void setppData (
 			unsigned int i,                                                ///< index of the posterior predictive sample to be set
 			const std::vector<int>& ppdata,                                ///< posterior predictive data sample
@@ -237,15 +330,32 @@ class MCMCList : public PsiMClist
 		double getRpd ( unsigned int i ) const;
 		void setRkd ( unsigned int i, double Rkd );
 		double getRkd ( unsigned int i ) const;
-		unsigned int getNblocks ( void ) const { return posterior_predictive_data[0].size(); }  ///< get the number of blocks
+		unsigned int getNblocks ( void ) const { return nblocks; }      ///< get the number of blocks
 		void setlogratio ( unsigned int i, unsigned int j, double logratio );              ///< set the log posterior ratio for sample i and block j
 		double getlogratio ( unsigned int i, unsigned int j ) const;                       ///< get the log posterior ratio for sample i and block j
 		void set_accept_rate(double rate) {accept_rate = rate; }  ///< set the acceptance rate
 		double get_accept_rate(void) const {return accept_rate; } ///< get the acceptance rate
 		void set_entropy ( double entropy ) { H = entropy; } ///< set the entropy if needed
 		double get_entropy ( void ) const { return H; }
+		void setNchains ( unsigned int n ) { nchains = n; }              ///< set the number of chains that are stored one after the other in the list
+		unsigned int getNchains ( void ) const { return nchains; }      ///< get the number of chains that are stored in the list
+		void setRhat ( unsigned int prm, double R );                     ///< set the potential scale reduction factor for parameter prm
+		double getRhat ( unsigned int prm ) const;                       ///< get the potential scale reduction factor for parameter prm (0 if it was not determined)
+		void setNeff ( unsigned int prm, double n );                     ///< set the effective number of samples for parameter prm
+		double getNeff ( unsigned int prm ) const;                       ///< get the effective number of samples for parameter prm (0 if it was not determined)
+		const int * getppDataBuffer ( void ) const { return posterior_predictive_data.empty() ? NULL : &(posterior_predictive_data[0]); }   ///< all posterior predictive data sets (getNsamples() x getNblocks(), row major)
+		const double * getppDevianceBuffer ( void ) const { return posterior_predictive_deviances.empty() ? NULL : &(posterior_predictive_deviances[0]); }   ///< deviances of all posterior predictive data sets
+		const double * getppRpdBuffer ( void ) const { return posterior_predictive_Rpd.empty() ? NULL : &(posterior_predictive_Rpd[0]); }   ///< Rpd of all posterior predictive data sets
+		const double * getppRkdBuffer ( void ) const { return posterior_predictive_Rkd.empty() ? NULL : &(posterior_predictive_Rkd[0]); }   ///< Rkd of all posterior predictive data sets
+		const double * getRpdBuffer ( void ) const { return posterior_Rpd.empty() ? NULL : &(posterior_Rpd[0]); }   ///< Rpd of all posterior samples
+		const double * getRkdBuffer ( void ) const { return posterior_Rkd.empty() ? NULL : &(posterior_Rkd[0]); }   ///< Rkd of all posterior samples
+		const double * getlogratioBuffer ( void ) const { return logratios.empty() ? NULL : &(logratios[0]); }     ///< all log posterior ratios (getNsamples() x getNblocks(), row major)
 };
 
-void newsample ( const PsiData * data, const std::vector<double>& p, std::vector<int> * sample );
+/** \brief draw binomial responses for all blocks of data with success probabilities p
+ *
+ * Random numbers are taken from stream or from the default stream if stream is NULL.
+ */
+void newsample ( const PsiData * data, const std::vector<double>& p, std::vector<int> * sample, PsiRandomStream * stream=NULL );
 
 #endif
@@ -8,6 +8,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <pthread.h>
 
 /**********************************************************************
  *
@@ -28,26 +31,43 @@ MetropolisHastings::MetropolisHastings ( const PsiPsychometric * pmf, const PsiD
 	std::cerr << "Hi my name is MetropolisHastings\n";
 #endif
 	setTheta ( currenttheta );
-    currentdeviance = (pmf->deviance(currenttheta,dat));
+}
+
+MetropolisHastings::MetropolisHastings ( const MetropolisHastings& sampler )
+	: PsiSampler ( sampler ),
+	propose ( sampler.propose->clone() ),
+	currenttheta ( sampler.currenttheta ),
+	newtheta ( sampler.newtheta ),
+	stepwidths ( sampler.stepwidths ),
+	currentstate ( sampler.currentstate ),
+	newstate ( sampler.newstate ),
+	accept ( sampler.accept ),
+	qold ( sampler.qold )
+{
+}
+
+void MetropolisHastings::setStream ( PsiRandomStream * newstream ) {
+	PsiSampler::setStream ( newstream );
+	propose->setStream ( newstream );
 }
 
 std::vector<double> MetropolisHastings::draw ( void ) {
-	double qnew, acc(propose->rngcall());
-	const PsiPsychometric * model (getModel());
-	const PsiData * data (getData());
+	double qnew, ratio, acc(propose->rngcall());
 
 	// propose a new point
 	proposePoint(currenttheta, stepwidths, propose, newtheta);
 
-	// negative log posterior of the point
+	// negative log posterior of the point (this evaluates the point into newstate)
 	qnew = acceptance_probability ( currenttheta, newtheta );
 	// std::cerr << qnew-qold << " " << exp(qnew-qold) << "\n";
+	ratio = exp(qnew-qold);
 
-	if (acc<exp(qnew-qold)) {
+	if (acc<ratio) {
 		// accept the new point
 		qold = qnew;
 		currenttheta = newtheta;
-		currentdeviance = model->deviance ( currenttheta, data );
+		// The evaluation of the accepted point is kept for the deviance and the statistics of the sample
+		std::swap ( currentstate, newstate );
 		accept ++;
 #ifdef DEBUG_MCMC
 		std::cerr << " ACCEPTED ";
@@ -61,6 +81,8 @@ std::vector<double> MetropolisHastings::draw ( void ) {
 	std::cout << "\n";
 #endif
 
+	adapt ( ratio<1 ? ratio : 1 );
+
 	return currenttheta;
 }
 
@@ -69,7 +91,8 @@ double MetropolisHastings::acceptance_probability (
 		const std::vector<double>& new_theta ) {
 	double qnew;
 
-	qnew = -getModel()->neglpost ( new_theta, getData() );
+	getModel()->evaluate_state ( new_theta, getData(), &newstate );
+	qnew = -newstate.neglpost;
 
 #ifdef DEBUG_MCMC
 
@@ -112,7 +135,8 @@ void MetropolisHastings::setTheta ( const std::vector<double>& prm ) {
 		currenttheta = prm;
 	else
 		throw BadArgumentError();
-	qold = getModel()->neglpost( currenttheta, getData() );
+	getModel()->evaluate_state ( currenttheta, getData(), &currentstate );
+	qold = -currentstate.neglpost;
 }
 
 void MetropolisHastings::setStepSize ( double size, unsigned int param ) {
@@ -128,92 +152,150 @@ void MetropolisHastings::setStepSize ( const std::vector<double>& sizes ) {
 		stepwidths[i] = sizes[i];
 }
 
-MCMCList MetropolisHastings::sample ( unsigned int N ) {
+void MetropolisHastings::saveState ( PsiCheckpointWriter * checkpoint ) const {
+	checkpoint->putDoubles ( currenttheta );
+	checkpoint->putDoubles ( stepwidths );
+	propose->saveState ( checkpoint );
+}
+
+void MetropolisHastings::loadState ( PsiCheckpointReader * checkpoint ) {
+	std::vector<double> theta ( checkpoint->getDoubles() ), steps ( checkpoint->getDoubles() );
+	if ( theta.size()!=currenttheta.size() || steps.size()!=stepwidths.size() )
+		throw PsiError ( "MetropolisHastings::loadState: checkpoint does not match the number of parameters" );
+	propose->loadState ( checkpoint );
+	stepwidths = steps;
+	// The evaluation of the state is deterministic and therefore not stored
+	setTheta ( theta );
+}
+
+/** posterior predictives and statistics of a sample for samplers that store complete MCMCLists
+ *
+ * All statistics are determined from the predictions in state (as determined by PsiPsychometric::evaluate_state() for
+ * data): the model is not evaluated again.
+ */
+static void record_sample (
+		const PsiPsychometric * model,
+		const PsiData * data,
+		const PsiEvaluation& state,
+		PsiData * localdata,
+		PsiRandomStream * stream,
+		MCMCSampleRecord * rec )
+{
+	std::vector<double> residuals;
+	PsiEvaluation ppstate;
+
+	rec->est = state.prm;
+	rec->deviance = state.deviance;
+
+	// determine posterior predictives
+	rec->ppdata.resize ( data->getNblocks() );
+	newsample ( localdata, state.p, &(rec->ppdata), stream );
+	localdata->setNcorrect ( rec->ppdata );
+	ppstate.prm = state.prm;
+	ppstate.p = state.p;
+	model->score_state ( localdata, &ppstate );
+	rec->ppdeviance = ppstate.deviance;
+
+	residuals = model->getDevianceResiduals ( state, data );
+	rec->Rpd = model->getRpd ( residuals, state );
+	rec->Rkd = model->getRkd ( residuals, data );
+
+	residuals = model->getDevianceResiduals ( ppstate, localdata );
+	rec->ppRpd = model->getRpd ( residuals, ppstate );
+	rec->ppRkd = model->getRkd ( residuals, localdata );
+
+	// log posterior ratios for reduced data sets
+	rec->logratios = state.logratios;
+}
+
+/** as above for samplers that do not keep an evaluation of their state */
+static void record_sample (
+		const PsiPsychometric * model,
+		const PsiData * data,
+		const std::vector<double>& est,
+		PsiData * localdata,
+		PsiRandomStream * stream,
+		MCMCSampleRecord * rec )
+{
+	PsiEvaluation state;
+	model->evaluate_state ( est, data, &state );
+	record_sample ( model, data, state, localdata, stream, rec );
+}
+
+void MetropolisHastings::record ( PsiData * localdata, MCMCSampleRecord * rec ) {
+	record_sample ( getModel(), getData(), currentstate, localdata, getStream(), rec );
+}
+
+MCMCList MetropolisHastings::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
 	const PsiData * data ( getData() );
 	const PsiPsychometric * model ( getModel() );
+	if ( thin==0 )
+		throw BadArgumentError ( "MetropolisHastings::sample: thin should be at least 1" );
 	accept = 0;
 	MCMCList out ( N, model->getNparams(), data->getNblocks() );
 	PsiData *localdata = new PsiData ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
-	std::vector< PsiData* > reduceddata (data->getNblocks() );
-	std::vector<int> posterior_predictive ( data->getNblocks() );
-	std::vector<double> probs ( data->getNblocks() );
-	std::vector<double> est ( model->getNparams() );
-	unsigned int i,j,k,l;
-
-	std::vector<double> reducedx ( data->getNblocks()-1 );
-	std::vector<int> reducedk ( data->getNblocks()-1 );
-	std::vector<int> reducedn ( data->getNblocks()-1 );
-
-	for ( k=0; k<data->getNblocks(); k++ ) {
-		j = 0;
-		for ( l=0; l<data->getNblocks(); l++ ) {
-			if ( l!=k ) {
-				reducedx[j] = data->getIntensity(l);
-				reducedk[j] = data->getNcorrect(l);
-				reducedn[j] = data->getNtrials(l);
-				j++;
-			}
-		}
-		reduceddata[k] = new PsiData ( reducedx, reducedn, reducedk, data->getNalternatives() );
-	}
+	MCMCSampleRecord rec;
+	unsigned int i, t;
 
 	qold = acceptance_probability ( currenttheta, currenttheta );
 
+	// Discarded draws only move the chain: posterior predictives and statistics are determined for stored samples only
+	for (i=0; i<burnin; i++)
+		draw();
+
 	for (i=0; i<N; i++) {
+		for (t=1; t<thin; t++)
+			draw();
 		// Draw the next sample
-		est = draw();
-		out.setEst ( i, est, 0. );
-		out.setdeviance ( i, getDeviance() );
-
-		// determine posterior predictives
-		for ( k=0; k<data->getNblocks(); k++ )
-			probs[k] = model->evaluate ( data->getIntensity(k), est );
-		newsample ( localdata, probs, &posterior_predictive);
-		localdata->setNcorrect ( posterior_predictive );
-		out.setppData ( i, posterior_predictive, model->deviance ( est, localdata ) );
-
-		probs = model->getDevianceResiduals ( est, data );
-		out.setRpd ( i, model->getRpd ( probs, est, data ) );
-		out.setRkd ( i, model->getRkd ( probs, data ) );
-
-		probs = model->getDevianceResiduals ( est, localdata );
-		out.setppRpd ( i, model->getRpd ( probs, est, localdata ) );
-		out.setppRkd ( i, model->getRkd ( probs, localdata ) );
-
-		// Store log posterior ratios for reduced data sets
-		for ( k=0; k<data->getNblocks(); k++) {
-			/*
-			j=0;
-			for ( l=0; l<data->getNblocks(); l++ ) {
-				if ( l!=k ) {
-					reducedx[j] = data->getIntensity(l);
-					reducedk[j] = data->getNcorrect(l);
-					reducedn[j] = data->getNtrials(l);
-					j++;
-				}
-			}
-			reduceddata = new PsiData ( reducedx, reducedn, reducedk, data->getNalternatives() );
-			*/
-			out.setlogratio ( i, k, model->neglpost(est,data)-model->neglpost(est,reduceddata[k]) );
-		}
+		draw();
+		record ( localdata, &rec );
+		out.setRecord ( i, rec );
 #ifdef DEBUG_MCMC
 		std::cerr << " accept: " << std::setiosflags ( std::ios::fixed ) << double(accept)/(i+1) << "\n";
 #endif
 	}
 
 #ifdef DEBUG_MCMC
-	std::cerr << "Acceptance rate: " << double(accept)/N << "\n";
+	std::cerr << "Acceptance rate: " << double(accept)/(burnin+N*thin) << "\n";
 #endif
-	out.set_accept_rate(double(accept)/N);
+	out.set_accept_rate(double(accept)/(burnin+N*thin));
 
 	delete localdata;
-	for ( k=0; k<reduceddata.size(); k++ ) {
-		delete reduceddata[k];
-	}
 
 	return out;
 }
 
+void MetropolisHastings::sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+	unsigned int i, t;
+	unsigned long nbefore ( summary->getNsamples() );
+
+	if ( summary->getNparams()!=model->getNparams() || summary->getNblocks()!=data->getNblocks() )
+		throw BadArgumentError ( "MetropolisHastings::sample: summary does not match the model or the data" );
+	if ( thin==0 )
+		throw BadArgumentError ( "MetropolisHastings::sample: thin should be at least 1" );
+
+	accept = 0;
+	qold = acceptance_probability ( currenttheta, currenttheta );
+
+	for (i=0; i<burnin; i++)
+		draw();
+
+	for (i=0; i<N; i++) {
+		for (t=1; t<thin; t++)
+			draw();
+		draw();
+		record ( &localdata, &rec );
+		summary->add ( rec );
+	}
+
+	// The summary may already hold samples from earlier calls; their rate is weighted by the number of samples
+	summary->set_accept_rate ( ( summary->get_accept_rate()*nbefore + double(accept)*N/(burnin+N*thin) ) / ( nbefore+N ) );
+}
+
 
 /**********************************************************************
  *
@@ -236,12 +318,86 @@ void GenericMetropolis::proposePoint(std::vector<double> &current_theta,
 }
 
 
+void GenericMetropolis::saveState ( PsiCheckpointWriter * checkpoint ) const {
+	MetropolisHastings::saveState ( checkpoint );
+	checkpoint->putInteger ( currentindex );
+}
+
+void GenericMetropolis::loadState ( PsiCheckpointReader * checkpoint ) {
+	unsigned long index;
+	MetropolisHastings::loadState ( checkpoint );
+	index = checkpoint->getInteger ();
+	if ( index>=getModel()->getNparams() )
+		throw PsiError ( "GenericMetropolis::loadState: invalid parameter index in checkpoint" );
+	currentindex = index;
+}
+
+/** \brief residual sums of squares for regressing each parameter on all other parameters
+ *
+ * With an intercept, the residual sum of squares of parameter j is 1/(S^{-1})_jj, where S is the NxN scatter matrix of
+ * the centered samples. S is accumulated in one pass over the pilot sample and stays on the stack.
+ * Returns false if S is not positive definite (e.g. if the pilot did not move in one direction).
+ */
+template <unsigned int N>
+static bool scatter_residuals ( const PsiMClist& pilot, double *rss )
+{
+	FixedMatrix<N> S;
+	double mean[N], d[N], e[N], x[N];
+	unsigned int i, j, k, Nsamples ( pilot.getNsamples() );
+
+	for ( j=0; j<N; j++ ) {
+		mean[j] = 0;
+		for ( i=0; i<Nsamples; i++ )
+			mean[j] += pilot.getEst ( i, j );
+		mean[j] /= Nsamples;
+	}
+
+	for ( i=0; i<Nsamples; i++ ) {
+		for ( j=0; j<N; j++ )
+			d[j] = pilot.getEst ( i, j ) - mean[j];
+		for ( j=0; j<N; j++ )
+			for ( k=0; k<=j; k++ )
+				S(j,k) += d[j]*d[k];
+	}
+
+	if ( !S.cholesky_dec () )
+		return false;
+
+	for ( j=0; j<N; j++ ) {
+		for ( k=0; k<N; k++ )
+			e[k] = k==j;
+		S.cholesky_solve ( e, x );
+		rss[j] = 1./x[j];
+	}
+	return true;
+}
+
 void GenericMetropolis::findOptimalStepwidth( PsiMClist const &pilot ){
     if ( pilot.getNsamples() < pilot.getNparams() +1 ){
         throw BadArgumentError("The number of samples in the pilot must be at least equal to the number of free parameters.");
     }
 	int i,j,prm, Nparams(pilot.getNparams()), Nsamples(pilot.getNsamples());
 	double std_residuals; // standard deviation of the residuals
+	double rss[6];
+	bool done ( false );
+
+	switch ( Nparams ) {
+		case 1: done = scatter_residuals<1> ( pilot, rss ); break;
+		case 2: done = scatter_residuals<2> ( pilot, rss ); break;
+		case 3: done = scatter_residuals<3> ( pilot, rss ); break;
+		case 4: done = scatter_residuals<4> ( pilot, rss ); break;
+		case 5: done = scatter_residuals<5> ( pilot, rss ); break;
+		case 6: done = scatter_residuals<6> ( pilot, rss ); break;
+	}
+
+	if ( done ) {
+		for ( prm=0; prm<Nparams; prm++ )
+			/* multiply std deviation with 2.38/sqrt(Nparams) as suggested by Gelman et al. (1995) */
+			setStepSize ( sqrt ( rss[prm] / double(Nsamples) ) * 2.38 / sqrt(double(Nparams)), prm );
+		return;
+	}
+
+	/* many parameters or a degenerate pilot: QR-decomposition of the extended data matrix */
 	int *paramindex = new int[Nparams-1];
 	Matrix X = Matrix(Nsamples, Nparams+1); // extended data matrix
 
@@ -286,6 +442,26 @@ DefaultMCMC::DefaultMCMC ( const PsiPsychometric* Model, const PsiData* Data, Ps
 #endif
 }
 
+DefaultMCMC::DefaultMCMC ( const DefaultMCMC& sampler ) :
+	MetropolisHastings ( sampler ),
+	proposaldistributions ( sampler.proposaldistributions.size(), NULL )
+{
+	unsigned int i;
+	for (i=0; i<proposaldistributions.size(); i++) {
+		if ( sampler.proposaldistributions[i]!=NULL )
+			proposaldistributions[i] = sampler.proposaldistributions[i]->clone();
+	}
+}
+
+void DefaultMCMC::setStream ( PsiRandomStream * newstream ) {
+	unsigned int i;
+	MetropolisHastings::setStream ( newstream );
+	for (i=0; i<proposaldistributions.size(); i++) {
+		if ( proposaldistributions[i]!=NULL )
+			proposaldistributions[i]->setStream ( newstream );
+	}
+}
+
 DefaultMCMC::~DefaultMCMC ( void ) {
 	unsigned int i;
 	for (i=0; i<proposaldistributions.size(); i++) {
@@ -296,7 +472,7 @@ DefaultMCMC::~DefaultMCMC ( void ) {
 double DefaultMCMC::acceptance_probability ( const std::vector<double>& current_theta, const std::vector<double>& new_theta ) {
 	double qnew;
 	unsigned int i;
-	qnew     = - getModel()->neglpost ( new_theta, getData() );
+	qnew     = MetropolisHastings::acceptance_probability ( current_theta, new_theta );
 	for (i=0; i<getModel()->getNparams(); i++) {
 		qnew -= log ( proposaldistributions[i]->pdf ( new_theta[i] ) );
 	}
@@ -340,6 +516,141 @@ void DefaultMCMC::proposePoint (
 #endif
 }
 
+/**********************************************************************
+ *
+ * Adaptive Metropolis
+ *
+ */
+
+AdaptiveMetropolis::AdaptiveMetropolis ( const PsiPsychometric * Model, const PsiData * Data, PsiRandom * proposal, double targetrate, double decay )
+	: MetropolisHastings ( Model, Data, proposal ),
+	cholfactor ( Model->getNparams()*Model->getNparams(), 0 ),
+	u ( Model->getNparams(), 0 ),
+	target ( targetrate ),
+	gamma ( decay ),
+	nadapted ( 0 ),
+	nadaptleft ( 0 )
+{
+	if ( targetrate<=0 || targetrate>=1 )
+		throw BadArgumentError ( "AdaptiveMetropolis: the target acceptance rate should be between 0 and 1" );
+	setStepSize ( getStepsize() );
+}
+
+void AdaptiveMetropolis::setStepSize ( double size, unsigned int param ) {
+	MetropolisHastings::setStepSize ( size, param );
+	setStepSize ( getStepsize() );
+}
+
+void AdaptiveMetropolis::setStepSize ( const std::vector<double>& sizes ) {
+	unsigned int i, nprm ( u.size() );
+	MetropolisHastings::setStepSize ( sizes );
+	std::fill ( cholfactor.begin(), cholfactor.end(), 0. );
+	for ( i=0; i<nprm; i++ )
+		cholfactor[i*nprm+i] = sizes[i];
+	nadapted = 0;
+}
+
+void AdaptiveMetropolis::proposePoint ( std::vector<double> &current_theta,
+		std::vector<double> &step_widths,
+		PsiRandom * proposal,
+		std::vector<double> &new_theta )
+{
+	unsigned int i, j, nprm ( u.size() );
+	for ( i=0; i<nprm; i++ )
+		u[i] = proposal->draw ();
+	for ( i=0; i<nprm; i++ ) {
+		new_theta[i] = current_theta[i];
+		for ( j=0; j<=i; j++ )
+			new_theta[i] += cholfactor[i*nprm+j]*u[j];
+	}
+}
+
+void AdaptiveMetropolis::adapt ( double acceptance ) {
+	unsigned int i, j, k, nprm ( u.size() );
+	double eta, unorm ( 0 );
+	std::vector<double> Su ( nprm, 0 );
+	Matrix cov ( nprm, nprm );
+
+	if ( nadaptleft==0 )
+		return;
+	nadaptleft--;
+	nadapted++;
+
+	for ( i=0; i<nprm; i++ ) {
+		unorm += u[i]*u[i];
+		for ( j=0; j<=i; j++ )
+			Su[i] += cholfactor[i*nprm+j]*u[j];
+	}
+	if ( unorm<=0 )
+		return;
+	eta = pow ( double(nadapted), -gamma )*nprm;
+	eta = ( eta>1 ? 1 : eta ) * (acceptance-target)/unorm;
+
+	// S*S^T + eta*(S*u)*(S*u)^T stays positive definite because |eta|*|u|^2 = min(1,nprm*n^-gamma)*|acceptance-target| < 1
+	for ( i=0; i<nprm; i++ )
+		for ( j=0; j<=i; j++ ) {
+			cov(i,j) = eta*Su[i]*Su[j];
+			for ( k=0; k<=j; k++ )
+				cov(i,j) += cholfactor[i*nprm+k]*cholfactor[j*nprm+k];
+			cov(j,i) = cov(i,j);
+		}
+
+	Matrix * S ( cov.cholesky_dec () );
+	for ( i=0; i<nprm; i++ )
+		if ( !( (*S)(i,i)>0 ) ) {
+			// Numerically not positive definite: keep the last proposal
+			delete S;
+			return;
+		}
+	for ( i=0; i<nprm; i++ )
+		for ( j=0; j<=i; j++ )
+			cholfactor[i*nprm+j] = (*S)(i,j);
+	delete S;
+}
+
+MCMCList AdaptiveMetropolis::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
+	if ( burnin==0 && nadapted==0 )
+		throw BadArgumentError ( "AdaptiveMetropolis::sample: the proposal is adapted during the burnin only, burnin should be at least 1" );
+	nadaptleft = burnin;
+	MCMCList out ( MetropolisHastings::sample ( N, burnin, thin ) );
+	nadaptleft = 0;
+	return out;
+}
+
+void AdaptiveMetropolis::sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin, unsigned int thin ) {
+	if ( burnin==0 && nadapted==0 )
+		throw BadArgumentError ( "AdaptiveMetropolis::sample: the proposal is adapted during the burnin only, burnin should be at least 1" );
+	nadaptleft = burnin;
+	MetropolisHastings::sample ( N, summary, burnin, thin );
+	nadaptleft = 0;
+}
+
+Matrix * AdaptiveMetropolis::getProposalCovariance ( void ) const {
+	unsigned int i, j, k, nprm ( u.size() );
+	Matrix * cov = new Matrix ( nprm, nprm );
+	for ( i=0; i<nprm; i++ )
+		for ( j=0; j<nprm; j++ )
+			for ( k=0; k<=i && k<=j; k++ )
+				(*cov)(i,j) += cholfactor[i*nprm+k]*cholfactor[j*nprm+k];
+	return cov;
+}
+
+void AdaptiveMetropolis::saveState ( PsiCheckpointWriter * checkpoint ) const {
+	MetropolisHastings::saveState ( checkpoint );
+	checkpoint->putDoubles ( cholfactor );
+	checkpoint->putInteger ( nadapted );
+}
+
+void AdaptiveMetropolis::loadState ( PsiCheckpointReader * checkpoint ) {
+	std::vector<double> S;
+	MetropolisHastings::loadState ( checkpoint );
+	S = checkpoint->getDoubles ();
+	if ( S.size()!=cholfactor.size() )
+		throw PsiError ( "AdaptiveMetropolis::loadState: checkpoint does not match the number of parameters" );
+	cholfactor = S;
+	nadapted = checkpoint->getInteger ();
+}
+
 /**********************************************************************
  *
  * Hybird MCMC
@@ -366,6 +677,24 @@ HybridMCMC::HybridMCMC ( const PsiPsychometric* Model, const PsiData* Data, int
 	stepsizes[2] = 0.0001;
 }
 
+HybridMCMC::HybridMCMC ( const HybridMCMC& sampler )
+	: PsiSampler ( sampler ),
+	proposal ( sampler.proposal->clone() ),
+	currenttheta ( sampler.currenttheta ),
+	newtheta ( sampler.newtheta ),
+	momentum ( sampler.momentum ),
+	currentH ( sampler.currentH ),
+	newH ( sampler.newH ),
+	energy ( sampler.energy ),
+	newenergy ( sampler.newenergy ),
+	gradient ( sampler.gradient ),
+	currentgradient ( sampler.currentgradient ),
+	stepsizes ( sampler.stepsizes ),
+	Nleapfrog ( sampler.Nleapfrog ),
+	Naccepted ( sampler.Naccepted )
+{
+}
+
 std::vector<double> HybridMCMC::draw ( void ) {
 	unsigned int i;
 	const PsiPsychometric * model ( getModel() );
@@ -410,12 +739,9 @@ std::vector<double> HybridMCMC::draw ( void ) {
 }
 
 void HybridMCMC::setTheta ( const std::vector<double>& theta ) {
-	unsigned int i;
 	currenttheta = theta;
 
-	for (i=0; i<getModel()->getNparams(); i++) {
-		gradient[i] = getModel()->dlposteri ( currenttheta, getData(), i );
-	}
+	gradient = getModel()->dlposteri ( currenttheta, getData() );
 	energy = getModel()->neglpost ( currenttheta, getData() );
 }
 
@@ -448,8 +774,7 @@ void HybridMCMC::leapfrog ( void ) {
 		for (i=0; i<Nparams; i++)
 			newtheta[i] +=          stepsizes[i] * momentum[i];
 
-		for (i=0; i<Nparams; i++)
-			gradient[i] = model->dlposteri ( newtheta, getData(), i );
+		gradient = model->dlposteri ( newtheta, getData() );
 
 		for (i=0; i<Nparams; i++)
 			momentum[i] -= 0.5 * stepsizes[i] * gradient[i];
@@ -460,11 +785,19 @@ double HybridMCMC::getDeviance ( void ) {
 	return getModel()->deviance ( currenttheta, getData() );
 }
 
-MCMCList HybridMCMC::sample ( unsigned int N ) {
+MCMCList HybridMCMC::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
 	MCMCList out ( N, getModel()->getNparams(), getData()->getNblocks() );
-	unsigned int i;
+	unsigned int i, t;
+
+	if ( thin==0 )
+		throw BadArgumentError ( "HybridMCMC::sample: thin should be at least 1" );
+
+	for (i=0; i<burnin; i++)
+		draw();
 
 	for (i=0; i<N; i++) {
+		for (t=1; t<thin; t++)
+			draw();
 		out.setEst ( i, draw(), 0. );
 		out.setdeviance ( i, getDeviance() );
 #ifdef DEBUG_MCMC
@@ -477,12 +810,1360 @@ MCMCList HybridMCMC::sample ( unsigned int N ) {
 	}
 
 #ifdef DEBUG_MCMC
-	std::cerr << "Acceptance rate: " << double(Naccepted)/N << "\n";
+	std::cerr << "Acceptance rate: " << double(Naccepted)/(burnin+N*thin) << "\n";
+#endif
+
+	return out;
+}
+
+/**********************************************************************
+ *
+ * No-U-Turn sampling
+ *
+ */
+
+// Constants of the dual averaging as recommended by Hoffman & Gelman (2014)
+static const double nuts_gamma ( 0.05 );
+static const double nuts_t0 ( 10 );
+static const double nuts_kappa ( 0.75 );
+// Trajectories with an energy error larger than this are considered diverged
+static const double nuts_maxdeltaH ( 1000 );
+// Fractions of the burnin from which the scales are estimated
+static const double nuts_scalestart ( 0.2 );
+static const double nuts_scaleend ( 0.7 );
+
+struct NUTSState {
+	std::vector<double> theta;
+	std::vector<double> p;
+	std::vector<double> grad;                            // gradient of the negative log posterior as returned by dneglpost()
+	double energy;                                       // negative log posterior
+};
+
+struct NUTSTree {
+	NUTSState minus;                                     // leftmost state
+	NUTSState plus;                                      // rightmost state
+	NUTSState proposal;                                  // state that is picked from the tree
+	double n;                                            // number of states within the slice
+	bool s;                                              // false if the tree made a u-turn or diverged
+	double alpha;                                        // sum of acceptance probabilities
+	unsigned int nalpha;                                 // number of states in the tree
+};
+
+/** \brief scales of the parameters from the curvature of the likelihood at prm (fallback if the curvature is not positive) */
+static std::vector<double> curvature_scales ( const PsiPsychometric * model, const PsiData * data, const std::vector<double>& prm, double fallback )
+{
+	unsigned int i;
+	std::vector<double> scales ( model->getNparams(), fallback );
+	Matrix H ( prm.size(), prm.size() );
+	// the hessian of negllikeli_derivatives() is the 2nd derivative of the log likelihood (as ddnegllikeli())
+	model->negllikeli_derivatives ( prm, data, NULL, &H );
+	for ( i=0; i<scales.size(); i++ )
+		if ( -H(i,i)>0 && -H(i,i)<HUGE_VAL )
+			scales[i] = 1./sqrt ( -H(i,i) );
+	return scales;
+}
+
+NUTS::NUTS ( const PsiPsychometric* Model, const PsiData* Data, double targetaccept, unsigned int depth )
+	: PsiSampler ( Model, Data ),
+	proposal ( new GaussRandom ),
+	scales ( Model->getNparams(), .1 ),
+	epsilon ( 1 ),
+	delta ( targetaccept ),
+	maxdepth ( depth ),
+	mu ( 0 ),
+	Hbar ( 0 ),
+	logepsbar ( 0 ),
+	nadapt ( 0 ),
+	nwarmup ( 0 ),
+	nwarmupdone ( 0 ),
+	nwarmupsamples ( 0 ),
+	acceptsum ( 0 ),
+	nleapfrog ( 0 ),
+	ndivergent ( 0 )
+{
+	if ( targetaccept<=0 || targetaccept>=1 )
+		throw BadArgumentError ( "NUTS: the target acceptance statistic should be between 0 and 1" );
+
+	setTheta ( Model->getStart ( Data ) );
+	scales = curvature_scales ( Model, Data, currenttheta, .1 );
+}
+
+NUTS::NUTS ( const NUTS& sampler )
+	: PsiSampler ( sampler ),
+	proposal ( sampler.proposal->clone() ),
+	currenttheta ( sampler.currenttheta ),
+	currentgradient ( sampler.currentgradient ),
+	energy ( sampler.energy ),
+	scales ( sampler.scales ),
+	epsilon ( sampler.epsilon ),
+	delta ( sampler.delta ),
+	maxdepth ( sampler.maxdepth ),
+	mu ( sampler.mu ),
+	Hbar ( sampler.Hbar ),
+	logepsbar ( sampler.logepsbar ),
+	nadapt ( sampler.nadapt ),
+	nwarmup ( sampler.nwarmup ),
+	nwarmupdone ( sampler.nwarmupdone ),
+	warmupmean ( sampler.warmupmean ),
+	warmupm2 ( sampler.warmupm2 ),
+	nwarmupsamples ( sampler.nwarmupsamples ),
+	acceptsum ( sampler.acceptsum ),
+	nleapfrog ( sampler.nleapfrog ),
+	ndivergent ( sampler.ndivergent )
+{
+}
+
+void NUTS::setTheta ( const std::vector<double>& prm ) {
+	if ( prm.size()!=getModel()->getNparams() )
+		throw BadArgumentError ( "NUTS::setTheta: wrong number of parameters" );
+	currenttheta = prm;
+	currentgradient = getModel()->dneglpost ( currenttheta, getData() );
+	energy = getModel()->neglpost ( currenttheta, getData() );
+}
+
+void NUTS::setStepSize ( double size, unsigned int param ) {
+	if ( param>=scales.size() )
+		throw BadIndexError();
+	std::vector<double> sizes ( getStepsize() );
+	sizes[param] = size;
+	setStepSize ( sizes );
+}
+
+void NUTS::setStepSize ( const std::vector<double>& sizes ) {
+	if ( sizes.size()!=scales.size() )
+		throw BadArgumentError();
+	scales = sizes;
+	epsilon = 1;
+}
+
+std::vector<double> NUTS::getStepsize ( void ) const {
+	unsigned int i;
+	std::vector<double> sizes ( scales );
+	for ( i=0; i<sizes.size(); i++ )
+		sizes[i] *= epsilon;
+	return sizes;
+}
+
+double NUTS::getDeviance ( void ) {
+	return getModel()->deviance ( currenttheta, getData() );
+}
+
+double NUTS::logjoint ( const NUTSState& state ) const {
+	unsigned int i;
+	double H ( state.energy );
+	for ( i=0; i<state.p.size(); i++ )
+		H += 0.5*state.p[i]*state.p[i];
+	return -H;
+}
+
+void NUTS::leapfrog ( NUTSState * state, double step ) {
+	unsigned int i, nprm ( scales.size() );
+
+	// The momenta are pushed down the gradient of the negative log posterior
+	for ( i=0; i<nprm; i++ )
+		state->p[i] -= 0.5 * step * scales[i] * state->grad[i];
+	for ( i=0; i<nprm; i++ )
+		state->theta[i] += step * scales[i] * state->p[i];
+
+	state->grad = getModel()->dneglpost ( state->theta, getData() );
+	state->energy = getModel()->neglpost ( state->theta, getData() );
+
+	for ( i=0; i<nprm; i++ )
+		state->p[i] -= 0.5 * step * scales[i] * state->grad[i];
+	nleapfrog++;
+}
+
+bool NUTS::noturn ( const NUTSState& minus, const NUTSState& plus ) const {
+	unsigned int i;
+	double dminus ( 0 ), dplus ( 0 ), dtheta;
+	// distances are measured in the coordinates in which the momenta are standard normal
+	for ( i=0; i<scales.size(); i++ ) {
+		dtheta = ( plus.theta[i]-minus.theta[i] )/scales[i];
+		dminus += dtheta*minus.p[i];
+		dplus  += dtheta*plus.p[i];
+	}
+	return dminus>=0 && dplus>=0;
+}
+
+void NUTS::buildtree ( const NUTSState& start, double logu, int direction, unsigned int depth, double joint0, NUTSTree * tree ) {
+	if ( depth==0 ) {
+		// A single leapfrog step
+		double joint;
+		tree->proposal = start;
+		leapfrog ( &(tree->proposal), direction*epsilon );
+		tree->minus = tree->plus = tree->proposal;
+		joint = logjoint ( tree->proposal );
+		tree->nalpha = 1;
+		if ( joint!=joint ) {
+			tree->n = 0;
+			tree->s = false;
+			tree->alpha = 0;
+		} else {
+			tree->n = ( logu<=joint ? 1 : 0 );
+			tree->s = logu < joint + nuts_maxdeltaH;
+			tree->alpha = ( joint>joint0 ? 1 : exp ( joint-joint0 ) );
+		}
+		if ( !tree->s )
+			ndivergent++;
+		return;
+	}
+
+	// Build the first half, then the second half from its outermost state in the same direction
+	buildtree ( start, logu, direction, depth-1, joint0, tree );
+	if ( !tree->s )
+		return;
+
+	NUTSTree next;
+	buildtree ( direction<0 ? tree->minus : tree->plus, logu, direction, depth-1, joint0, &next );
+	if ( next.n>0 && proposal->rngcall()*(tree->n+next.n) < next.n )
+		tree->proposal = next.proposal;
+	if ( direction<0 )
+		tree->minus = next.minus;
+	else
+		tree->plus = next.plus;
+	tree->n += next.n;
+	tree->alpha += next.alpha;
+	tree->nalpha += next.nalpha;
+	tree->s = next.s && noturn ( tree->minus, tree->plus );
+}
+
+std::vector<double> NUTS::draw ( void ) {
+	unsigned int i, depth ( 0 );
+	int direction;
+	double joint0, logu;
+	NUTSState state;
+	NUTSTree tree, next;
+
+	state.theta = currenttheta;
+	state.grad = currentgradient;
+	state.energy = energy;
+	state.p.resize ( currenttheta.size() );
+	for ( i=0; i<state.p.size(); i++ )
+		state.p[i] = proposal->draw();
+
+	joint0 = logjoint ( state );
+	logu = joint0 + log ( proposal->rngcall() );
+
+	tree.minus = tree.plus = state;
+	tree.n = 1;
+	tree.s = true;
+	next.alpha = 0;
+	next.nalpha = 0;
+
+	while ( tree.s && depth<maxdepth ) {
+		direction = ( proposal->rngcall()<0.5 ? -1 : 1 );
+		buildtree ( direction<0 ? tree.minus : tree.plus, logu, direction, depth, joint0, &next );
+		if ( next.s && proposal->rngcall()*tree.n < next.n ) {
+			currenttheta = next.proposal.theta;
+			currentgradient = next.proposal.grad;
+			energy = next.proposal.energy;
+		}
+		if ( direction<0 )
+			tree.minus = next.minus;
+		else
+			tree.plus = next.plus;
+		tree.n += next.n;
+		tree.s = next.s && noturn ( tree.minus, tree.plus );
+		depth++;
+	}
+
+	// The acceptance statistic of the last subtree (as in Hoffman & Gelman, 2014, Algorithm 6)
+	acceptsum += ( next.nalpha>0 ? next.alpha/next.nalpha : 0 );
+	if ( nwarmupdone<nwarmup )
+		adapt ( next.nalpha>0 ? next.alpha/next.nalpha : 0 );
+
+#ifdef DEBUG_MCMC
+	std::cerr << "NUTS depth: " << depth << " epsilon: " << epsilon << "\n";
 #endif
 
+	return currenttheta;
+}
+
+double NUTS::reasonable_epsilon ( void ) {
+	unsigned int i, iter;
+	double ratio, joint0, a;
+	NUTSState state, next;
+
+	state.theta = currenttheta;
+	state.grad = currentgradient;
+	state.energy = energy;
+	state.p.resize ( currenttheta.size() );
+	for ( i=0; i<state.p.size(); i++ )
+		state.p[i] = proposal->draw();
+	joint0 = logjoint ( state );
+
+	next = state;
+	leapfrog ( &next, epsilon );
+	ratio = logjoint ( next ) - joint0;
+	if ( ratio!=ratio ) ratio = -HUGE_VAL;
+
+	// double or halve epsilon until the acceptance probability crosses 0.5
+	a = ( ratio>log(0.5) ? 1 : -1 );
+	for ( iter=0; iter<100 && a*ratio > -a*log(2.); iter++ ) {
+		epsilon *= ( a>0 ? 2 : 0.5 );
+		next = state;
+		leapfrog ( &next, epsilon );
+		ratio = logjoint ( next ) - joint0;
+		if ( ratio!=ratio ) ratio = -HUGE_VAL;
+	}
+	return epsilon;
+}
+
+void NUTS::adapt ( double acceptstat ) {
+	unsigned int i, nprm ( scales.size() );
+	unsigned int scalestart ( (unsigned int)(nuts_scalestart*nwarmup) ), scaleend ( (unsigned int)(nuts_scaleend*nwarmup) );
+	double eta, w, d;
+
+	nwarmupdone++;
+	nadapt++;
+	eta = 1./(nadapt+nuts_t0);
+	Hbar = (1-eta)*Hbar + eta*(delta-acceptstat);
+	epsilon = exp ( mu - sqrt(double(nadapt))/nuts_gamma * Hbar );
+	w = pow ( double(nadapt), -nuts_kappa );
+	logepsbar = w*log(epsilon) + (1-w)*logepsbar;
+
+	if ( nwarmupdone>scalestart && nwarmupdone<=scaleend ) {
+		nwarmupsamples++;
+		for ( i=0; i<nprm; i++ ) {
+			d = currenttheta[i]-warmupmean[i];
+			warmupmean[i] += d/nwarmupsamples;
+			warmupm2[i] += d*(currenttheta[i]-warmupmean[i]);
+		}
+	}
+
+	if ( nwarmupdone==scaleend && nwarmupsamples>=10 ) {
+		for ( i=0; i<nprm; i++ )
+			if ( warmupm2[i]>0 )
+				scales[i] = sqrt ( warmupm2[i]/(nwarmupsamples-1) );
+		// Restart the dual averaging for the new scales
+		epsilon = 1;
+		reasonable_epsilon ();
+		mu = log ( 10*epsilon );
+		Hbar = logepsbar = 0;
+		nadapt = 0;
+	}
+
+	if ( nwarmupdone==nwarmup )
+		epsilon = exp ( logepsbar );
+}
+
+void NUTS::warmup ( unsigned int burnin ) {
+	unsigned int i;
+	nwarmup = burnin;
+	nwarmupdone = 0;
+	acceptsum = 0;
+	if ( burnin==0 )
+		return;
+
+	nwarmupsamples = 0;
+	warmupmean = std::vector<double> ( scales.size(), 0 );
+	warmupm2 = std::vector<double> ( scales.size(), 0 );
+	reasonable_epsilon ();
+	mu = log ( 10*epsilon );
+	Hbar = logepsbar = 0;
+	nadapt = 0;
+
+	for ( i=0; i<burnin; i++ )
+		draw();
+}
+
+MCMCList NUTS::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	MCMCList out ( N, model->getNparams(), data->getNblocks() );
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+	unsigned int i, t;
+
+	if ( thin==0 )
+		throw BadArgumentError ( "NUTS::sample: thin should be at least 1" );
+
+	warmup ( burnin );
+
+	for ( i=0; i<N; i++ ) {
+		for ( t=1; t<thin; t++ )
+			draw();
+		record_sample ( model, data, draw(), &localdata, getStream(), &rec );
+		out.setRecord ( i, rec );
+	}
+
+	// Mean acceptance statistic
+	out.set_accept_rate ( acceptsum/(burnin+N*thin) );
+
 	return out;
 }
 
+void NUTS::sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+	unsigned int i, t;
+	unsigned long nbefore ( summary->getNsamples() );
+
+	if ( summary->getNparams()!=model->getNparams() || summary->getNblocks()!=data->getNblocks() )
+		throw BadArgumentError ( "NUTS::sample: summary does not match the model or the data" );
+	if ( thin==0 )
+		throw BadArgumentError ( "NUTS::sample: thin should be at least 1" );
+
+	warmup ( burnin );
+
+	for ( i=0; i<N; i++ ) {
+		for ( t=1; t<thin; t++ )
+			draw();
+		record_sample ( model, data, draw(), &localdata, getStream(), &rec );
+		summary->add ( rec );
+	}
+
+	summary->set_accept_rate ( ( summary->get_accept_rate()*nbefore + acceptsum*N/(burnin+N*thin) ) / ( nbefore+N ) );
+}
+
+/**********************************************************************
+ *
+ * Parallel chains
+ *
+ */
+
+struct MCMCChainJob {
+	PsiSampler * sampler;                                // private copy of the sampler
+	PsiRandomStream stream;                              // random numbers for this chain only
+	unsigned int N;                                      // number of samples to be stored
+	unsigned int burnin;                                 // number of draws to be discarded first
+	unsigned int thin;                                   // store every thin-th draw
+	MCMCList * chain;                                    // output
+	bool failed;                                         // did sampling throw an exception?
+};
+
+void * mcmc_chain_worker ( void * jobptr ) {
+	MCMCChainJob * job ( (MCMCChainJob*) jobptr );
+	try {
+		job->chain = new MCMCList ( job->sampler->sample ( job->N, job->burnin, job->thin ) );
+	} catch ( ... ) {
+		// Exceptions can not cross thread boundaries; they are rethrown by sample_chains()
+		job->failed = true;
+	}
+	return NULL;
+}
+
+/** \brief determine Rhat and the effective number of samples for nchains chains of length N that are stored in chains
+ *
+ * Rhat is the estimated potential scale reduction as in Gilks, Richardson, Spiegelhalter (1996), p.137 (the
+ * same quantity as BayesInference.Rhat() in pypsignifit). The effective number of samples is nchains*N/tau, where
+ * the integrated autocorrelation time tau is estimated from the autocorrelations of all chains, truncated
+ * by Geyer's initial positive sequence criterion. The effective number of samples is at most nchains*N.
+ */
+void chain_diagnostics ( MCMCList * chains, unsigned int nchains, unsigned int N ) {
+	unsigned int prm, c, i, t;
+	double W, B, varplus, mean, acov, rho, rhopair, tau;
+	std::vector<double> chainmean ( nchains );
+
+	if ( N<2 )
+		return;
+
+	for ( prm=0; prm<chains->getNparams(); prm++ ) {
+		W = B = mean = 0;
+		for ( c=0; c<nchains; c++ ) {
+			chainmean[c] = 0;
+			for ( i=0; i<N; i++ )
+				chainmean[c] += chains->getEst ( c*N+i, prm );
+			chainmean[c] /= N;
+			mean += chainmean[c];
+		}
+		mean /= nchains;
+		for ( c=0; c<nchains; c++ ) {
+			for ( i=0; i<N; i++ )
+				W += (chains->getEst ( c*N+i, prm )-chainmean[c])*(chains->getEst ( c*N+i, prm )-chainmean[c]);
+			B += (chainmean[c]-mean)*(chainmean[c]-mean);
+		}
+		W /= nchains*(N-1.);
+		B = ( nchains>1 ? N*B/(nchains-1) : 0 );
+		varplus = (N-1.)/N * W + B/N;
+
+		if ( W<=0 ) {
+			// All samples are equal: nothing is known about the mixing of the chains
+			chains->setRhat ( prm, ( nchains>1 ? 1 : 0 ) );
+			chains->setNeff ( prm, 1 );
+			continue;
+		}
+		if ( nchains>1 )
+			chains->setRhat ( prm, varplus/W );
+
+		// sum autocorrelations in pairs of lags until a pair becomes negative
+		tau = -1;
+		rhopair = 0;
+		for ( t=0; t<N; t++ ) {
+			acov = 0;
+			for ( c=0; c<nchains; c++ )
+				for ( i=0; i+t<N; i++ )
+					acov += (chains->getEst ( c*N+i, prm )-chainmean[c])*(chains->getEst ( c*N+i+t, prm )-chainmean[c]);
+			acov /= nchains*(N-1.);
+			rho = 1 - (W-acov)/varplus;
+			rhopair += rho;
+			if ( t%2==1 ) {
+				if ( rhopair<0 )
+					break;
+				tau += 2*rhopair;
+				rhopair = 0;
+			}
+		}
+		chains->setNeff ( prm, ( tau>1 ? nchains*N/tau : nchains*N ) );
+	}
+}
+
+MCMCList sample_chains ( const PsiSampler * sampler, const std::vector< std::vector<double> >& start, unsigned int N, unsigned int burnin, unsigned int thin ) {
+	unsigned int c, i, k, nchains ( start.size() );
+	unsigned int nprm ( sampler->getModel()->getNparams() ), nblocks ( sampler->getData()->getNblocks() );
+	unsigned long seed ( getDefaultStream()->genrand_int32() );
+	std::vector<MCMCChainJob> jobs ( nchains );
+	std::vector<pthread_t> workers ( nchains );
+	std::vector<bool> started ( nchains, false );
+	bool failed ( false );
+	double accept ( 0 );
+
+	if ( nchains==0 )
+		throw BadArgumentError ( "sample_chains needs at least one starting value" );
+	for ( c=0; c<nchains; c++ )
+		if ( start[c].size()!=nprm )
+			throw BadArgumentError ( "sample_chains: starting values do not match the number of parameters" );
+
+	for ( c=0; c<nchains; c++ ) {
+		jobs[c].sampler = sampler->clone();
+		jobs[c].stream.seed ( seed, c );
+		jobs[c].sampler->setStream ( &(jobs[c].stream) );
+		jobs[c].sampler->setTheta ( start[c] );
+		jobs[c].N = N;
+		jobs[c].burnin = burnin;
+		jobs[c].thin = thin;
+		jobs[c].chain = NULL;
+		jobs[c].failed = false;
+	}
+
+	if ( nchains==1 ) {
+		mcmc_chain_worker ( &(jobs[0]) );
+	} else {
+		for ( c=0; c<nchains; c++ )
+			started[c] = pthread_create ( &(workers[c]), NULL, mcmc_chain_worker, &(jobs[c]) )==0;
+		// Chains that could not get a thread of their own are sampled here
+		for ( c=0; c<nchains; c++ )
+			if ( !started[c] )
+				mcmc_chain_worker ( &(jobs[c]) );
+		for ( c=0; c<nchains; c++ )
+			if ( started[c] )
+				pthread_join ( workers[c], NULL );
+	}
+
+	for ( c=0; c<nchains; c++ ) {
+		delete jobs[c].sampler;
+		failed = failed || jobs[c].failed;
+	}
+	if ( failed ) {
+		for ( c=0; c<nchains; c++ )
+			delete jobs[c].chain;
+		throw PsiError ( "sample_chains: sampling a chain failed" );
+	}
+
+	MCMCList out ( nchains*N, nprm, nblocks );
+	for ( c=0; c<nchains; c++ ) {
+		const MCMCList * chain ( jobs[c].chain );
+		for ( i=0; i<N; i++ ) {
+			out.setEst ( c*N+i, chain->getEst ( i ), chain->getdeviance ( i ) );
+			out.setppData ( c*N+i, chain->getppData ( i ), chain->getppDeviance ( i ) );
+			out.setRpd ( c*N+i, chain->getRpd ( i ) );
+			out.setRkd ( c*N+i, chain->getRkd ( i ) );
+			out.setppRpd ( c*N+i, chain->getppRpd ( i ) );
+			out.setppRkd ( c*N+i, chain->getppRkd ( i ) );
+			for ( k=0; k<nblocks; k++ )
+				out.setlogratio ( c*N+i, k, chain->getlogratio ( i, k ) );
+		}
+		accept += chain->get_accept_rate();
+		delete jobs[c].chain;
+	}
+	out.set_accept_rate ( accept/nchains );
+	out.setNchains ( nchains );
+	chain_diagnostics ( &out, nchains, N );
+
+	return out;
+}
+
+/**********************************************************************
+ *
+ * Checkpointed sampling
+ *
+ */
+
+/** everything that identifies the run of a checkpoint: model, data and the number of draws */
+static std::vector<double> mcmc_fingerprint ( const PsiSampler * sampler, unsigned int N, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( sampler->getData() );
+	unsigned int i;
+	std::vector<double> fingerprint ( sampler->getModel()->getFingerprint ( data ) );
+
+	for ( i=0; i<data->getNblocks(); i++ ) {
+		fingerprint.push_back ( data->getIntensity ( i ) );
+		fingerprint.push_back ( data->getNtrials ( i ) );
+		fingerprint.push_back ( data->getNcorrect ( i ) );
+	}
+	fingerprint.push_back ( N );
+	fingerprint.push_back ( burnin );
+	fingerprint.push_back ( thin );
+	return fingerprint;
+}
+
+/** append samples first,...,last-1 to the sample log of a checkpoint */
+static void put_mcmc_samples ( const MCMCList& samples, unsigned int first, unsigned int last, PsiCheckpointWriter * checkpoint ) {
+	unsigned int i;
+	MCMCSampleRecord rec;
+	for ( i=first; i<last; i++ ) {
+		rec = samples.getRecord ( i );
+		checkpoint->putDoubles ( rec.est );
+		checkpoint->putDouble ( rec.deviance );
+		checkpoint->putIntegers ( rec.ppdata );
+		checkpoint->putDouble ( rec.ppdeviance );
+		checkpoint->putDouble ( rec.Rpd );
+		checkpoint->putDouble ( rec.Rkd );
+		checkpoint->putDouble ( rec.ppRpd );
+		checkpoint->putDouble ( rec.ppRkd );
+		checkpoint->putDoubles ( rec.logratios );
+	}
+}
+
+MCMCList sample_checkpointed ( PsiSampler * sampler, unsigned int N, unsigned int burnin, unsigned int thin, const std::string& filename, unsigned int interval ) {
+	unsigned int i, n, done ( 0 );
+	unsigned int nprm ( sampler->getModel()->getNparams() ), nblocks ( sampler->getData()->getNblocks() );
+	PsiRandomStream * stream ( sampler->getStream()==NULL ? getDefaultStream() : sampler->getStream() );
+	std::vector<double> fingerprint ( mcmc_fingerprint ( sampler, N, burnin, thin ) );
+	std::string logname ( filename + ".samples" );
+	MCMCList out ( N, nprm, nblocks );
+	MCMCSampleRecord rec;
+	bool burnedin ( burnin==0 );
+	double accepted ( 0 );                  // sum of the acceptance rates of the chunks, weighted by their number of draws
+	unsigned long long validlog ( 0 );      // length of the valid part of the sample log of a resumed run
+
+	if ( thin==0 )
+		throw BadArgumentError ( "sample_checkpointed: thin should be at least 1" );
+	if ( interval==0 )
+		throw BadArgumentError ( "sample_checkpointed: interval should be at least 1" );
+
+	if ( PsiCheckpointReader::exists ( filename ) ) {
+		PsiCheckpointReader checkpoint ( filename, "mcmc" );
+		if ( checkpoint.getDoubles()!=fingerprint )
+			throw PsiError ( "sample_checkpointed: checkpoint belongs to a different analysis" );
+		done = checkpoint.getInteger ();
+		burnedin = checkpoint.getInteger ()!=0;
+		accepted = checkpoint.getDouble ();
+		if ( done>N )
+			throw PsiError ( "sample_checkpointed: checkpoint holds too many samples" );
+		stream->loadState ( &checkpoint );
+		// The sampler comes last: a sampler of a different type would not read to the end of the checkpoint
+		sampler->loadState ( &checkpoint );
+		if ( !checkpoint.atEnd() )
+			throw PsiError ( "sample_checkpointed: checkpoint was written by a different sampler" );
+
+		// The log may hold samples of a chunk whose checkpoint was not completed; these are cut off and drawn again
+		PsiCheckpointReader log ( logname, "mcmc-samples" );
+		for ( i=0; i<done; i++ ) {
+			rec.est = log.getDoubles ();
+			rec.deviance = log.getDouble ();
+			rec.ppdata = log.getIntegers ();
+			rec.ppdeviance = log.getDouble ();
+			rec.Rpd = log.getDouble ();
+			rec.Rkd = log.getDouble ();
+			rec.ppRpd = log.getDouble ();
+			rec.ppRkd = log.getDouble ();
+			rec.logratios = log.getDoubles ();
+			if ( rec.est.size()!=nprm || rec.ppdata.size()!=nblocks || rec.logratios.size()!=nblocks )
+				throw PsiError ( "sample_checkpointed: checkpoint holds a corrupt sample" );
+			out.setRecord ( i, rec );
+		}
+		validlog = log.tell ();
+	} else {
+		// Later chunks are appended to an empty log
+		PsiCheckpointWriter log ( "mcmc-samples" );
+		log.save ( logname );
+	}
+	if ( validlog>0 )
+		truncate_checkpoint_log ( logname, validlog );
+
+	while ( !burnedin || done<N ) {
+		// The burnin is a chunk of its own, so that a long burnin is checkpointed, too
+		n = ( burnedin ? std::min ( interval, N-done ) : 0 );
+		MCMCList chunk ( sampler->sample ( n, burnedin ? 0 : burnin, thin ) );
+		for ( i=0; i<n; i++ )
+			out.setRecord ( done+i, chunk.getRecord ( i ) );
+		accepted += chunk.get_accept_rate() * ( burnedin ? double(n)*thin : burnin );
+
+		PsiCheckpointWriter log;
+		put_mcmc_samples ( out, done, done+n, &log );
+		log.append ( logname );
+
+		done += n;
+		burnedin = true;
+
+		PsiCheckpointWriter checkpoint ( "mcmc" );
+		checkpoint.putDoubles ( fingerprint );
+		checkpoint.putInteger ( done );
+		checkpoint.putInteger ( burnedin );
+		checkpoint.putDouble ( accepted );
+		stream->saveState ( &checkpoint );
+		sampler->saveState ( &checkpoint );
+		checkpoint.save ( filename );
+	}
+
+	out.set_accept_rate ( accepted/(burnin+double(N)*thin) );
+	return out;
+}
+
+/**********************************************************************
+ *
+ * Ensemble sampling
+ *
+ */
+
+/** \brief smallest number of block evaluations per thread of EnsembleSampler::evaluate()
+ *
+ * Starting and joining a thread costs about as much as a few hundred evaluations of a block. Smaller batches (e.g. the
+ * walkers of a small ensemble on a few blocks) are evaluated without threads.
+ */
+static const unsigned int ensemble_thread_work = 4096;
+
+/** \brief shared state of the threads that evaluate the proposals of an ensemble */
+struct EnsembleJob {
+	const PsiPsychometric * pmf;
+	const PsiData * data;
+	const std::vector< std::vector<double> > * prm;     // parameters to be evaluated
+	std::vector<double> * energies;                      // output
+	unsigned int chunk;                                  // number of parameter vectors per chunk
+	unsigned int next;                                   // first parameter vector that has not been assigned to a thread
+	bool failed;                                         // did any of the threads encounter an error?
+	pthread_mutex_t lock;
+};
+
+/** \brief evaluate chunks of proposals until all proposals have been processed */
+void * ensemble_worker ( void * jobptr ) {
+	EnsembleJob * job ( (EnsembleJob*) jobptr );
+	unsigned int first, i, n, N ( job->prm->size() );
+	std::vector< std::vector<double> > prm;
+	std::vector<double> energies;
+
+	try {
+		while ( true ) {
+			pthread_mutex_lock ( &(job->lock) );
+			first = job->next;
+			job->next += job->chunk;
+			pthread_mutex_unlock ( &(job->lock) );
+			if ( first>=N || job->failed )
+				break;
+			n = ( first+job->chunk<N ? job->chunk : N-first );
+
+			prm.assign ( job->prm->begin()+first, job->prm->begin()+first+n );
+			energies = job->pmf->neglpost_batch ( prm, job->data );
+			// Chunks do not overlap, so they can be written without the lock
+			for ( i=0; i<n; i++ )
+				(*(job->energies))[first+i] = energies[i];
+		}
+	} catch ( ... ) {
+		// Exceptions can not cross thread boundaries; they are rethrown by EnsembleSampler::evaluate()
+		pthread_mutex_lock ( &(job->lock) );
+		job->failed = true;
+		pthread_mutex_unlock ( &(job->lock) );
+	}
+	return NULL;
+}
+
+EnsembleSampler::EnsembleSampler ( const PsiPsychometric * Model, const PsiData * Data, unsigned int nwalkers, double stretch, unsigned int threads )
+	: PsiSampler ( Model, Data ),
+	proposal ( new GaussRandom ),
+	walkers ( nwalkers>0 ? nwalkers : 4*Model->getNparams(), std::vector<double> ( Model->getNparams() ) ),
+	energies ( walkers.size() ),
+	a ( stretch ),
+	nthreads ( threads ),
+	naccepted ( 0 ),
+	nproposed ( 0 )
+{
+	if ( walkers.size()<4 || walkers.size()%2==1 )
+		throw BadArgumentError ( "EnsembleSampler: the number of walkers should be even and at least 4" );
+	if ( stretch<=1 )
+		throw BadArgumentError ( "EnsembleSampler: the stretch scale should be larger than 1" );
+	if ( threads<1 )
+		throw BadArgumentError ( "EnsembleSampler needs at least one thread" );
+
+	std::vector<double> start ( Model->getStart ( Data ) );
+	ballwidths = curvature_scales ( Model, Data, start, .1 );
+	setTheta ( start );
+}
+
+EnsembleSampler::EnsembleSampler ( const EnsembleSampler& sampler )
+	: PsiSampler ( sampler ),
+	proposal ( sampler.proposal->clone() ),
+	walkers ( sampler.walkers ),
+	energies ( sampler.energies ),
+	ballwidths ( sampler.ballwidths ),
+	a ( sampler.a ),
+	nthreads ( sampler.nthreads ),
+	naccepted ( sampler.naccepted ),
+	nproposed ( sampler.nproposed )
+{
+}
+
+void EnsembleSampler::setTheta ( const std::vector<double>& prm ) {
+	unsigned int w, i, attempt;
+	std::vector< std::vector<double> > positions ( walkers.size(), prm );
+	std::vector<double> walker;
+
+	if ( prm.size()!=getModel()->getNparams() )
+		throw BadArgumentError ( "EnsembleSampler::setTheta: wrong number of parameters" );
+
+	// Walkers outside the support of the prior would never move: draw them again
+	for ( w=1; w<positions.size(); w++ ) {
+		for ( attempt=0; attempt<100; attempt++ ) {
+			walker = prm;
+			for ( i=0; i<prm.size(); i++ )
+				walker[i] += ballwidths[i]*proposal->draw();
+			if ( getModel()->neglpost ( walker, getData() )<HUGE_VAL ) {
+				positions[w] = walker;
+				break;
+			}
+		}
+	}
+	setWalkers ( positions );
+}
+
+void EnsembleSampler::setWalkers ( const std::vector< std::vector<double> >& positions ) {
+	unsigned int w;
+	if ( positions.size()!=walkers.size() )
+		throw BadArgumentError ( "EnsembleSampler::setWalkers: wrong number of walkers" );
+	for ( w=0; w<positions.size(); w++ )
+		if ( positions[w].size()!=getModel()->getNparams() )
+			throw BadArgumentError ( "EnsembleSampler::setWalkers: wrong number of parameters" );
+	walkers = positions;
+	energies = evaluate ( walkers );
+}
+
+void EnsembleSampler::setStepSize ( double size, unsigned int param ) {
+	if ( param>=ballwidths.size() )
+		throw BadIndexError();
+	ballwidths[param] = size;
+}
+
+void EnsembleSampler::setStepSize ( const std::vector<double>& sizes ) {
+	if ( sizes.size()!=ballwidths.size() )
+		throw BadArgumentError();
+	ballwidths = sizes;
+}
+
+double EnsembleSampler::getDeviance ( void ) {
+	return getModel()->deviance ( walkers[0], getData() );
+}
+
+std::vector<double> EnsembleSampler::evaluate ( const std::vector< std::vector<double> >& prm ) const {
+	unsigned int k, threads ( nthreads );
+	std::vector<double> out ( prm.size() );
+	EnsembleJob job;
+
+	job.pmf = getModel();
+	job.data = getData();
+	job.prm = &prm;
+	job.energies = &out;
+	job.next = 0;
+	job.failed = false;
+	if ( threads>prm.size() )
+		threads = prm.size();
+	if ( threads>prm.size()*getData()->getNblocks()/ensemble_thread_work )
+		threads = prm.size()*getData()->getNblocks()/ensemble_thread_work;
+	job.chunk = ( threads>1 ? (prm.size()+threads-1)/threads : prm.size() );
+	pthread_mutex_init ( &(job.lock), NULL );
+
+	if ( threads<=1 ) {
+		ensemble_worker ( &job );
+	} else {
+		std::vector<pthread_t> workers ( threads );
+		for ( k=0; k<threads; k++ ) {
+			if ( pthread_create ( &(workers[k]), NULL, ensemble_worker, &job ) ) {
+				// Could not start another thread: the remaining workers take over its share
+				threads = k;
+				break;
+			}
+		}
+		if ( threads==0 )
+			ensemble_worker ( &job );
+		for ( k=0; k<threads; k++ )
+			pthread_join ( workers[k], NULL );
+	}
+	pthread_mutex_destroy ( &(job.lock) );
+
+	if ( job.failed )
+		throw PsiError ( "EnsembleSampler: evaluating the proposals failed" );
+	return out;
+}
+
+void EnsembleSampler::update_half ( unsigned int first, unsigned int last, unsigned int cfirst, unsigned int clast ) {
+	unsigned int k, j, i, n ( last-first ), nprm ( getModel()->getNparams() );
+	double z;
+	std::vector< std::vector<double> > proposals ( n, std::vector<double> ( nprm ) );
+	std::vector<double> logz ( n ), logu ( n ), newenergies;
+
+	// Draw all random numbers first, so that they do not depend on the threads
+	for ( k=0; k<n; k++ ) {
+		j = cfirst + (unsigned int) ( proposal->rngcall()*(clast-cfirst) );
+		z = (a-1)*proposal->rngcall()+1;
+		z = z*z/a;
+		for ( i=0; i<nprm; i++ )
+			proposals[k][i] = walkers[j][i] + z*(walkers[first+k][i]-walkers[j][i]);
+		logz[k] = log ( z );
+		logu[k] = log ( proposal->rngcall() );
+	}
+
+	newenergies = evaluate ( proposals );
+
+	for ( k=0; k<n; k++ ) {
+		nproposed++;
+		if ( logu[k] < (nprm-1.)*logz[k] + energies[first+k] - newenergies[k] ) {
+			walkers[first+k] = proposals[k];
+			energies[first+k] = newenergies[k];
+			naccepted++;
+		}
+	}
+}
+
+std::vector<double> EnsembleSampler::draw ( void ) {
+	unsigned int half ( walkers.size()/2 );
+	update_half ( 0, half, half, walkers.size() );
+	update_half ( half, walkers.size(), 0, half );
+	return walkers[0];
+}
+
+MCMCList EnsembleSampler::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	unsigned int i, t, w, nw ( walkers.size() );
+	MCMCList out ( nw*N, model->getNparams(), data->getNblocks() );
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+
+	if ( thin==0 )
+		throw BadArgumentError ( "EnsembleSampler::sample: thin should be at least 1" );
+	naccepted = nproposed = 0;
+
+	for ( i=0; i<burnin; i++ )
+		draw();
+
+	for ( i=0; i<N; i++ ) {
+		for ( t=1; t<thin; t++ )
+			draw();
+		draw();
+		for ( w=0; w<nw; w++ ) {
+			record_sample ( model, data, walkers[w], &localdata, getStream(), &rec );
+			out.setRecord ( w*N+i, rec );
+		}
+	}
+
+	out.set_accept_rate ( nproposed>0 ? double(naccepted)/nproposed : 0 );
+	out.setNchains ( nw );
+	chain_diagnostics ( &out, nw, N );
+
+	return out;
+}
+
+void EnsembleSampler::sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin, unsigned int thin ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	unsigned int i, t, w, nw ( walkers.size() );
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+	unsigned long nbefore ( summary->getNsamples() );
+
+	if ( summary->getNparams()!=model->getNparams() || summary->getNblocks()!=data->getNblocks() )
+		throw BadArgumentError ( "EnsembleSampler::sample: summary does not match the model or the data" );
+	if ( thin==0 )
+		throw BadArgumentError ( "EnsembleSampler::sample: thin should be at least 1" );
+	naccepted = nproposed = 0;
+
+	for ( i=0; i<burnin; i++ )
+		draw();
+
+	for ( i=0; i<N; i++ ) {
+		for ( t=1; t<thin; t++ )
+			draw();
+		draw();
+		for ( w=0; w<nw; w++ ) {
+			record_sample ( model, data, walkers[w], &localdata, getStream(), &rec );
+			summary->add ( rec );
+		}
+	}
+
+	summary->set_accept_rate ( ( summary->get_accept_rate()*nbefore + ( nproposed>0 ? double(naccepted)/nproposed : 0 )*N*nw ) / ( nbefore+N*nw ) );
+}
+
+/**********************************************************************
+ *
+ * Parallel tempering
+ *
+ */
+
+/** \brief one Metropolis Hastings chain of a ParallelTempering sampler */
+struct TemperedChain {
+	double beta;                                         // inverse temperature
+	std::vector<double> theta;
+	double negll;                                        // negative log likelihood of theta
+	double neglprior;                                    // negative log prior of theta
+	double logscale;                                     // log of the factor of the stepwidths
+	PsiRandomStream stream;
+	PsiRandom * proposal;                                // draws from stream
+	unsigned long accepted;                              // since the counters were reset
+	unsigned long steps;
+	double loglikelisum;                                 // sum of the log likelihoods of the states after each step
+	bool tracing;                                        // store the states after each step?
+	std::vector< std::vector<double> > trace;
+
+	TemperedChain ( double b, const std::vector<double>& prm, const PsiRandom * prop )
+		: beta ( b ), theta ( prm ), negll ( 0 ), neglprior ( 0 ), logscale ( 0 ), proposal ( prop->clone() ),
+		accepted ( 0 ), steps ( 0 ), loglikelisum ( 0 ), tracing ( false ) { proposal->setStream ( &stream ); }
+	TemperedChain ( const TemperedChain& chain )
+		: beta ( chain.beta ), theta ( chain.theta ), negll ( chain.negll ), neglprior ( chain.neglprior ), logscale ( chain.logscale ),
+		stream ( chain.stream ), proposal ( chain.proposal->clone() ), accepted ( chain.accepted ), steps ( chain.steps ),
+		loglikelisum ( chain.loglikelisum ), tracing ( chain.tracing ), trace ( chain.trace ) { proposal->setStream ( &stream ); }
+	~TemperedChain ( void ) { delete proposal; }
+	/** negative log of the tempered posterior (the prior is not tempered) */
+	double energy ( double nll, double nlprior ) const { return ( beta>0 ? beta*nll : 0 ) + nlprior; }
+	void evaluate ( const PsiPsychometric * pmf, const PsiData * data ) {
+		negll = pmf->negllikeli ( theta, data );
+		neglprior = pmf->neglpost ( theta, data ) - negll;
+	}
+	void sweep ( const PsiPsychometric * pmf, const PsiData * data, const std::vector<double>& stepwidths, unsigned int n );
+};
+
+void TemperedChain::sweep ( const PsiPsychometric * pmf, const PsiData * data, const std::vector<double>& stepwidths, unsigned int n )
+{
+	unsigned int i, prm;
+	double scale ( exp ( logscale ) ), newnegll, newneglprior;
+	std::vector<double> newtheta ( theta.size() );
+
+	for ( i=0; i<n; i++ ) {
+		for ( prm=0; prm<theta.size(); prm++ )
+			newtheta[prm] = theta[prm] + scale*stepwidths[prm]*proposal->draw();
+		newnegll = pmf->negllikeli ( newtheta, data );
+		newneglprior = pmf->neglpost ( newtheta, data ) - newnegll;
+
+		// NaN energies (e.g. outside the support of the prior) are never accepted
+		if ( log ( proposal->rngcall() ) < energy ( negll, neglprior ) - energy ( newnegll, newneglprior ) ) {
+			theta = newtheta;
+			negll = newnegll;
+			neglprior = newneglprior;
+			accepted++;
+		}
+		steps++;
+		loglikelisum -= negll;
+		if ( tracing )
+			trace.push_back ( theta );
+	}
+}
+
+/** \brief shared state of the threads that run the chains of a ParallelTempering sampler */
+struct TemperingJob {
+	const PsiPsychometric * pmf;
+	const PsiData * data;
+	std::vector<TemperedChain*> * chains;
+	const std::vector<double> * stepwidths;
+	unsigned int n;                                      // number of sweeps
+	unsigned int next;                                   // next chain that has not been assigned to a thread
+	bool failed;                                         // did any of the threads encounter an error?
+	pthread_mutex_t lock;
+};
+
+/** \brief advance chains until all chains have been processed */
+void * tempering_worker ( void * jobptr ) {
+	TemperingJob * job ( (TemperingJob*) jobptr );
+	unsigned int k;
+
+	try {
+		while ( true ) {
+			pthread_mutex_lock ( &(job->lock) );
+			k = job->next++;
+			pthread_mutex_unlock ( &(job->lock) );
+			if ( k>=job->chains->size() || job->failed )
+				break;
+			(*(job->chains))[k]->sweep ( job->pmf, job->data, *(job->stepwidths), job->n );
+		}
+	} catch ( ... ) {
+		// Exceptions can not cross thread boundaries; they are rethrown by ParallelTempering::advance()
+		pthread_mutex_lock ( &(job->lock) );
+		job->failed = true;
+		pthread_mutex_unlock ( &(job->lock) );
+	}
+	return NULL;
+}
+
+ParallelTempering::ParallelTempering ( const PsiPsychometric * Model, const PsiData * Data, PsiRandom * proposal,
+		unsigned int ntemperatures, unsigned int interval, unsigned int threads )
+	: PsiSampler ( Model, Data ),
+	stepwidths ( Model->getNparams(), .1 ),
+	swapinterval ( interval ),
+	nthreads ( threads ),
+	nsweeps ( 0 ),
+	swapattempts ( ntemperatures>1 ? ntemperatures-1 : 0, 0 ),
+	swapaccepts ( ntemperatures>1 ? ntemperatures-1 : 0, 0 )
+{
+	unsigned int k;
+	if ( ntemperatures<2 )
+		throw BadArgumentError ( "ParallelTempering needs at least two temperatures" );
+	if ( interval<1 )
+		throw BadArgumentError ( "ParallelTempering: the swap interval should be at least 1" );
+	if ( threads<1 )
+		throw BadArgumentError ( "ParallelTempering needs at least one thread" );
+
+	std::vector<double> start ( Model->getStart ( Data ) );
+	for ( k=0; k<ntemperatures; k++ )
+		chains.push_back ( new TemperedChain ( pow ( double(k)/(ntemperatures-1), 5 ), start, proposal ) );
+	setTheta ( start );
+}
+
+ParallelTempering::ParallelTempering ( const ParallelTempering& sampler )
+	: PsiSampler ( sampler ),
+	stepwidths ( sampler.stepwidths ),
+	swapinterval ( sampler.swapinterval ),
+	nthreads ( sampler.nthreads ),
+	nsweeps ( sampler.nsweeps ),
+	swapattempts ( sampler.swapattempts ),
+	swapaccepts ( sampler.swapaccepts )
+{
+	unsigned int k;
+	for ( k=0; k<sampler.chains.size(); k++ )
+		chains.push_back ( new TemperedChain ( *(sampler.chains[k]) ) );
+}
+
+ParallelTempering::~ParallelTempering ( void ) {
+	unsigned int k;
+	for ( k=0; k<chains.size(); k++ )
+		delete chains[k];
+}
+
+void ParallelTempering::setTheta ( const std::vector<double>& prm ) {
+	unsigned int k;
+	if ( prm.size()!=getModel()->getNparams() )
+		throw BadArgumentError ( "ParallelTempering::setTheta: wrong number of parameters" );
+	for ( k=0; k<chains.size(); k++ ) {
+		chains[k]->theta = prm;
+		chains[k]->evaluate ( getModel(), getData() );
+	}
+	nsweeps = 0;
+}
+
+std::vector<double> ParallelTempering::getTheta ( void ) {
+	return chains.back()->theta;
+}
+
+void ParallelTempering::setStepSize ( double size, unsigned int param ) {
+	if ( param>=stepwidths.size() )
+		throw BadIndexError();
+	stepwidths[param] = size;
+}
+
+void ParallelTempering::setStepSize ( const std::vector<double>& sizes ) {
+	if ( sizes.size()!=stepwidths.size() )
+		throw BadArgumentError();
+	stepwidths = sizes;
+}
+
+double ParallelTempering::getDeviance ( void ) {
+	return getModel()->deviance ( chains.back()->theta, getData() );
+}
+
+void ParallelTempering::setTemperatures ( const std::vector<double>& betas ) {
+	unsigned int k;
+	if ( betas.size()!=chains.size() )
+		throw BadArgumentError ( "ParallelTempering::setTemperatures: one inverse temperature is needed for each chain" );
+	if ( betas[0]<0 || betas.back()!=1 )
+		throw BadArgumentError ( "ParallelTempering::setTemperatures: inverse temperatures should range from >=0 to 1" );
+	for ( k=1; k<betas.size(); k++ )
+		if ( betas[k]<=betas[k-1] )
+			throw BadArgumentError ( "ParallelTempering::setTemperatures: inverse temperatures should be increasing" );
+	for ( k=0; k<chains.size(); k++ )
+		chains[k]->beta = betas[k];
+}
+
+std::vector<double> ParallelTempering::getTemperatures ( void ) const {
+	unsigned int k;
+	std::vector<double> betas ( chains.size() );
+	for ( k=0; k<chains.size(); k++ )
+		betas[k] = chains[k]->beta;
+	return betas;
+}
+
+double ParallelTempering::getSwapRate ( unsigned int k ) const {
+	if ( k>=swapattempts.size() )
+		throw BadIndexError();
+	return ( swapattempts[k]>0 ? double(swapaccepts[k])/swapattempts[k] : 0 );
+}
+
+double ParallelTempering::getLogEvidence ( void ) const {
+	unsigned int k;
+	double logZ ( 0 ), lower, upper;
+	if ( chains[0]->steps==0 )
+		throw PsiError ( "ParallelTempering::getLogEvidence: no samples have been drawn" );
+	for ( k=0; k+1<chains.size(); k++ ) {
+		lower = chains[k]->loglikelisum/chains[k]->steps;
+		upper = chains[k+1]->loglikelisum/chains[k+1]->steps;
+		logZ += 0.5*(chains[k+1]->beta-chains[k]->beta)*(lower+upper);
+	}
+	return logZ;
+}
+
+void ParallelTempering::seed_chains ( void ) {
+	unsigned int k;
+	PsiRandomStream * stream ( getStream()!=NULL ? getStream() : getDefaultStream() );
+	unsigned long seed ( stream->genrand_int32() );
+	for ( k=0; k<chains.size(); k++ )
+		chains[k]->stream.seed ( seed, k );
+}
+
+void ParallelTempering::exchange ( void ) {
+	unsigned int k;
+	double logr;
+	PsiRandomStream * stream ( getStream()!=NULL ? getStream() : getDefaultStream() );
+	TemperedChain * hot, * cold;
+
+	// Alternate between the pairs (0,1),(2,3),... and (1,2),(3,4),...
+	for ( k=(nsweeps/swapinterval)%2; k+1<chains.size(); k+=2 ) {
+		hot = chains[k];
+		cold = chains[k+1];
+		// The priors cancel in the exchange ratio
+		logr = (cold->beta-hot->beta)*(cold->negll-hot->negll);
+		swapattempts[k]++;
+		if ( log ( stream->genrand_real2() ) < logr ) {
+			std::swap ( hot->theta, cold->theta );
+			std::swap ( hot->negll, cold->negll );
+			std::swap ( hot->neglprior, cold->neglprior );
+			swapaccepts[k]++;
+		}
+	}
+}
+
+unsigned int ParallelTempering::advance ( unsigned int n, bool adapt ) {
+	unsigned int k, threads ( nthreads<chains.size() ? nthreads : chains.size() ), block;
+	TemperingJob job;
+
+	// Do not run past the next exchange
+	block = swapinterval - nsweeps%swapinterval;
+	if ( n>block )
+		n = block;
+
+	job.pmf = getModel();
+	job.data = getData();
+	job.chains = &chains;
+	job.stepwidths = &stepwidths;
+	job.n = n;
+	job.next = 0;
+	job.failed = false;
+	pthread_mutex_init ( &(job.lock), NULL );
+
+	if ( threads<=1 ) {
+		tempering_worker ( &job );
+	} else {
+		std::vector<pthread_t> workers ( threads );
+		for ( k=0; k<threads; k++ ) {
+			if ( pthread_create ( &(workers[k]), NULL, tempering_worker, &job ) ) {
+				// Could not start another thread: the remaining workers take over its share
+				threads = k;
+				break;
+			}
+		}
+		if ( threads==0 )
+			tempering_worker ( &job );
+		for ( k=0; k<threads; k++ )
+			pthread_join ( workers[k], NULL );
+	}
+	pthread_mutex_destroy ( &(job.lock) );
+
+	if ( job.failed )
+		throw PsiError ( "ParallelTempering: sampling of a tempered chain failed" );
+
+	nsweeps += n;
+	if ( nsweeps%swapinterval!=0 )
+		return n;
+
+	if ( adapt ) {
+		// Robbins-Monro steps of the log stepwidth factors towards an acceptance rate of 0.234
+		for ( k=0; k<chains.size(); k++ ) {
+			chains[k]->logscale += ( double(chains[k]->accepted)/chains[k]->steps - 0.234 ) / sqrt ( double(nsweeps/swapinterval) );
+			chains[k]->logscale = std::max ( -7., std::min ( 7., chains[k]->logscale ) );
+			chains[k]->accepted = chains[k]->steps = 0;
+			chains[k]->loglikelisum = 0;
+		}
+	}
+	exchange ();
+	return n;
+}
+
+std::vector<double> ParallelTempering::draw ( void ) {
+	if ( nsweeps==0 )
+		seed_chains ();
+	advance ( 1, false );
+	return chains.back()->theta;
+}
+
+void ParallelTempering::run ( unsigned int N, unsigned int burnin, unsigned int thin, MCMCList * list, MCMCSummary * summary ) {
+	const PsiData * data ( getData() );
+	const PsiPsychometric * model ( getModel() );
+	unsigned int i, k, n, stored ( 0 );
+	unsigned long done;
+	PsiData localdata ( data->getIntensities(), data->getNtrials(), data->getNcorrect(), data->getNalternatives() );
+	MCMCSampleRecord rec;
+	TemperedChain * cold ( chains.back() );
+
+	if ( thin==0 )
+		throw BadArgumentError ( "ParallelTempering::sample: thin should be at least 1" );
+
+	seed_chains ();
+	for ( k=0; k<chains.size(); k++ ) {
+		chains[k]->accepted = chains[k]->steps = 0;
+		chains[k]->loglikelisum = 0;
+	}
+
+	for ( done=0; done<burnin; done+=n )
+		n = advance ( std::min ( (unsigned long) swapinterval, burnin-done ), true );
+
+	for ( k=0; k<chains.size(); k++ ) {
+		chains[k]->accepted = chains[k]->steps = 0;
+		chains[k]->loglikelisum = 0;
+	}
+	std::fill ( swapattempts.begin(), swapattempts.end(), 0 );
+	std::fill ( swapaccepts.begin(), swapaccepts.end(), 0 );
+
+	// Between exchanges, the cold chain keeps its states; these are stored afterwards
+	cold->tracing = true;
+	for ( done=0; done<(unsigned long)N*thin; done+=n ) {
+		cold->trace.clear();
+		n = advance ( std::min ( (unsigned long) swapinterval, (unsigned long)N*thin-done ), false );
+		for ( i=0; i<n; i++ ) {
+			if ( (done+i+1)%thin!=0 )
+				continue;
+			record_sample ( model, data, cold->trace[i], &localdata, getStream(), &rec );
+			if ( list!=NULL )
+				list->setRecord ( stored++, rec );
+			else
+				summary->add ( rec );
+		}
+	}
+	cold->tracing = false;
+	cold->trace.clear();
+}
+
+MCMCList ParallelTempering::sample ( unsigned int N, unsigned int burnin, unsigned int thin ) {
+	MCMCList out ( N, getModel()->getNparams(), getData()->getNblocks() );
+	run ( N, burnin, thin, &out, NULL );
+	out.set_accept_rate ( chains.back()->steps>0 ? double(chains.back()->accepted)/chains.back()->steps : 0 );
+	return out;
+}
+
+void ParallelTempering::sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin, unsigned int thin ) {
+	unsigned long nbefore ( summary->getNsamples() );
+	if ( summary->getNparams()!=getModel()->getNparams() || summary->getNblocks()!=getData()->getNblocks() )
+		throw BadArgumentError ( "ParallelTempering::sample: summary does not match the model or the data" );
+	run ( N, burnin, thin, NULL, summary );
+	if ( summary->getNsamples()>0 )
+		summary->set_accept_rate ( ( summary->get_accept_rate()*nbefore
+					+ ( chains.back()->steps>0 ? double(chains.back()->accepted)/chains.back()->steps : 0 )*N ) / summary->getNsamples() );
+}
+
 /**********************************************************************
  *
  * Evidence
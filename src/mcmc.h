@@ -6,9 +6,11 @@
 #define MCMC_H
 
 #include <vector>
+#include <string>
 #include "psychometric.h"
 #include "rng.h"
 #include "mclist.h"
+#include "mcsummary.h"
 #include "getstart.h"
 
 class PsiSampler
@@ -16,15 +18,32 @@ class PsiSampler
 	private:
 		const PsiPsychometric * model;
 		const PsiData * data;
+		PsiRandomStream * stream;
 	public:
-		PsiSampler ( const PsiPsychometric * Model, const PsiData * Data ) : model(Model), data(Data) {}///< set up a sampler to sample from the posterior of the parameters of pmf given the data dat
+		PsiSampler ( const PsiPsychometric * Model, const PsiData * Data ) : model(Model), data(Data), stream(NULL) {}///< set up a sampler to sample from the posterior of the parameters of pmf given the data dat
+		virtual ~PsiSampler ( void ) {}
+		virtual PsiSampler * clone ( void ) const { throw NotImplementedError(); }                    ///< copy the sampler including its current state (the model and the data are not copied)
+		virtual void setStream ( PsiRandomStream * newstream ) { stream = newstream; }                 ///< draw all random numbers from newstream (not copied, not deleted) instead of the default stream
+		PsiRandomStream * getStream ( void ) const { return stream; }                                  ///< stream used by the sampler (NULL for the default stream)
 		virtual std::vector<double> draw ( void ) { throw NotImplementedError(); }                     ///< draw a sample from the posterior
-		virtual void setTheta ( const std::vector<double> theta ) { throw NotImplementedError(); }     ///< set the "state" of the underlying markov chain
+		virtual void setTheta ( const std::vector<double>& theta ) { throw NotImplementedError(); }    ///< set the "state" of the underlying markov chain
 		virtual std::vector<double> getTheta ( void ) { throw NotImplementedError(); }                 ///< get the "state" of the underlying markov chain
 		virtual void setStepSize ( double size, unsigned int param ) { throw NotImplementedError(); }  ///< set the size of the steps for parameter param of the sampler
 		virtual void setStepSize ( const std::vector<double>& sizes ) { throw NotImplementedError(); } ///< set all stepsizes of the sampler
 		virtual double getDeviance ( void ) { throw NotImplementedError(); }                           ///< return the model deviance for the current state
-		virtual MCMCList sample ( unsigned int N ) { throw NotImplementedError(); }                   ///< draw N samples from the posterior
+		virtual MCMCList sample (
+			unsigned int N,                                                                    ///< number of samples to be stored
+			unsigned int burnin=0,                                                             ///< number of draws that are discarded before the first stored sample
+			unsigned int thin=1                                                                ///< only every thin-th draw is stored
+			) { throw NotImplementedError(); }   ///< draw N samples from the posterior (burnin+N*thin draws in total)
+		virtual void sample (
+			unsigned int N,                                                                    ///< number of samples to be added
+			MCMCSummary * summary,                                                             ///< summary that receives the samples
+			unsigned int burnin=0,                                                             ///< number of draws that are discarded before the first sample
+			unsigned int thin=1                                                                ///< only every thin-th draw is added
+			) { throw NotImplementedError(); }   ///< draw N samples from the posterior and add them to summary instead of storing them
+		virtual void saveState ( PsiCheckpointWriter * checkpoint ) const { throw NotImplementedError(); }  ///< write the state of the chain (but not the random number stream) to a checkpoint
+		virtual void loadState ( PsiCheckpointReader * checkpoint ) { throw NotImplementedError(); }        ///< continue the chain from a state that was written by saveState()
 		const PsiPsychometric * getModel() const { return model; }                                     ///< return the underlying model instance
 		const PsiData         * getData()  const { return data;  }                                     ///< return the underlying data instance
 };
@@ -36,27 +55,36 @@ class MetropolisHastings : public PsiSampler
 		std::vector<double> currenttheta;
 		std::vector<double> newtheta;
 		std::vector<double> stepwidths;
-		double currentdeviance;
+		PsiEvaluation currentstate;                                                       // evaluation of currenttheta
+		PsiEvaluation newstate;                                                           // evaluation of the last proposal (filled by acceptance_probability())
 		int accept;
+		void record ( PsiData * localdata, MCMCSampleRecord * rec );                      // posterior predictives and statistics of the current state
 	protected:
 		double qold;
+		virtual void adapt ( double acceptance ) {}                                       ///< called after each step with the probability that the proposal was accepted
 	public:
 		MetropolisHastings (
 			const PsiPsychometric * Model,                                                  ///< psychometric funciton model to sample from
 			const PsiData * Data,                                                           ///< data to base inference on
 			PsiRandom* proposal                                                             ///< proposal distribution (will usually be a gaussian)
 			);                                                          ///< initialize the sampler
+		MetropolisHastings ( const MetropolisHastings& sampler );                         ///< copy the sampler (the proposal distribution is copied, too)
 		~MetropolisHastings ( void ) { delete propose; }
+		PsiSampler * clone ( void ) const { return new MetropolisHastings ( *this ); }   ///< clone by value
+		void setStream ( PsiRandomStream * newstream );                                   ///< draw proposals and posterior predictive samples from newstream
 		std::vector<double> draw ( void );                                                ///< perform a metropolis hastings step and draw a sample from the posterior
-		virtual double acceptance_probability ( const std::vector<double>& current_theta, const std::vector<double>& new_theta );
+		virtual double acceptance_probability ( const std::vector<double>& current_theta, const std::vector<double>& new_theta );   ///< log of the (unnormalized) acceptance probability of new_theta, evaluates new_theta into the state of the proposal
 		void setTheta ( const std::vector<double>& prm );                                 ///< set the current state of the sampler
 		std::vector<double> getTheta ( void ) { return currenttheta; }                    ///< get the current state of the sampler
-		double getDeviance ( void ) { return currentdeviance; }                           ///< get the current deviance
+		double getDeviance ( void ) { return currentstate.deviance; }                     ///< get the current deviance
 		void setStepSize ( double size, unsigned int param );                             ///< set the standard deviation of the proposal distribution for parameter param
 		void setStepSize ( const std::vector<double>& sizes );                            ///< set standard deviations of the proposal distribution for all parameters at once
 		std::vector<double> getStepsize ( void ) { return stepwidths; }		  			  ///< return the current stepwidth (standard deviations of the proposal distribution)
-		MCMCList sample ( unsigned int N );                                               ///< draw N samples from the posterior
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< draw N samples from the posterior after discarding burnin draws, keeping every thin-th draw
+		void sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin=0, unsigned int thin=1 );  ///< draw N samples from the posterior and add them to summary (constant memory)
 		unsigned int getNparams ( void ) { return newtheta.size(); }                      ///< get the number of parameters for which the sampler is set up
+		void saveState ( PsiCheckpointWriter * checkpoint ) const;                        ///< write the current state, the step widths and numbers that the proposal has generated in advance
+		void loadState ( PsiCheckpointReader * checkpoint );                              ///< continue from a state that was written by saveState()
 		virtual void proposePoint( std::vector<double> &current_theta,
 									std::vector<double> &step_widths,
 									PsiRandom * proposal,
@@ -74,10 +102,13 @@ class GenericMetropolis : public MetropolisHastings
 			PsiRandom* proposal                                               			  ///< proposal distribution (will usually be a gaussian)
 			): MetropolisHastings ( Model, Data, proposal ),
 			   currentindex(0) {}
+		PsiSampler * clone ( void ) const { return new GenericMetropolis ( *this ); }    ///< clone by value
 		void proposePoint( std::vector<double> &current_theta,
 							std::vector<double> &step_widths,
 							PsiRandom * proposal,
 							std::vector<double> &new_theta);				  			  ///< propose a new sample and save it in new_theta
+		void saveState ( PsiCheckpointWriter * checkpoint ) const;                        ///< write the state including the index of the next parameter to be updated
+		void loadState ( PsiCheckpointReader * checkpoint );                              ///< continue from a state that was written by saveState()
 		/** \brief Find the optimal stepwidth by regressing each parameter against the others.
 		 *
 		 * For each parameter, do a regression using QR-decomposition and
@@ -97,7 +128,10 @@ class DefaultMCMC : public MetropolisHastings
 				const PsiData * Data,                                                     ///< data to base inference on
 				PsiRandom* proposal                                                       ///< IGNORED
 				);
+		DefaultMCMC ( const DefaultMCMC& sampler );                                       ///< copy the sampler (the proposal distributions are copied, too)
 		~DefaultMCMC ( void );
+		PsiSampler * clone ( void ) const { return new DefaultMCMC ( *this ); }          ///< clone by value
+		void setStream ( PsiRandomStream * newstream );                                   ///< draw proposals and posterior predictive samples from newstream
 		double acceptance_probability (
 				const std::vector<double> &current_theta,
 				const std::vector<double> &new_theta );
@@ -105,12 +139,64 @@ class DefaultMCMC : public MetropolisHastings
 				std::vector<double> &stepwidths,
 				PsiRandom * proposal,
 				std::vector<double> &new_theta);                                          ///< propose a new sample and save it in new_theta
+		void saveState ( PsiCheckpointWriter * checkpoint ) const { throw NotImplementedError(); }  ///< not supported: the proposal distributions keep random numbers of their own
+		void loadState ( PsiCheckpointReader * checkpoint ) { throw NotImplementedError(); }
         void set_proposal(unsigned int i, PsiPrior* proposal){
             delete proposaldistributions.at(i);
             proposaldistributions.at(i) = proposal->clone();
+            proposaldistributions.at(i)->setStream ( getStream() );
         }
 };
 
+/** \brief robust adaptive Metropolis sampling (Vihola, 2012)
+ *
+ * Proposals are theta+S*u, where u is drawn from the proposal distribution (standard normal) and S is a lower triangular
+ * factor of the proposal covariance. During the burnin of sample(), S is adapted after each step such that the acceptance
+ * rate approaches a target rate: With the acceptance probability a of the proposal, the covariance is updated to
+ *
+ * S*S^T + eta_n*(a-target)*(S*u)*(S*u)^T/|u|^2,    eta_n = min(1,nparams*n^-gamma),
+ *
+ * and S is the cholesky factor of the updated covariance. The proposal covariance thus learns the shape of the posterior
+ * (including correlations between parameters) without a pilot sample. S is frozen after the burnin, so the stored
+ * samples are from a proper markov chain. S starts as a diagonal matrix with the step widths on the diagonal.
+ *
+ * A proposal that has not been adapted yet is no better than that of MetropolisHastings, so sample() throws a
+ * BadArgumentError if burnin is 0 before the proposal was adapted (by an earlier call with burnin or from a checkpoint).
+ */
+class AdaptiveMetropolis : public MetropolisHastings
+{
+	private:
+		std::vector<double> cholfactor;                                                   // lower triangular S (row major)
+		std::vector<double> u;                                                            // innovation of the last proposal
+		double target;
+		double gamma;
+		unsigned long nadapted;
+		unsigned int nadaptleft;
+	protected:
+		void adapt ( double acceptance );                                                 ///< update the proposal covariance
+	public:
+		AdaptiveMetropolis (
+			const PsiPsychometric * Model,                                                ///< psychometric function model to sample from
+			const PsiData * Data,                                                         ///< data to base inference on
+			PsiRandom* proposal,                                                          ///< distribution of the innovations (should be standard normal)
+			double targetrate=0.234,                                                      ///< acceptance rate that the adaptation aims at
+			double decay=2./3                                                             ///< exponent gamma of the decay of the adaptation steps (between 0.5 and 1)
+			);                                                        ///< initialize the sampler
+		PsiSampler * clone ( void ) const { return new AdaptiveMetropolis ( *this ); }   ///< clone by value
+		void setStepSize ( double size, unsigned int param );                             ///< set the standard deviation of the proposals for parameter param (resets the covariance to a diagonal matrix and discards the adaptation)
+		void setStepSize ( const std::vector<double>& sizes );                            ///< set the standard deviations of the proposals for all parameters (resets the covariance to a diagonal matrix and discards the adaptation)
+		void proposePoint ( std::vector<double> &current_theta,
+				std::vector<double> &step_widths,
+				PsiRandom * proposal,
+				std::vector<double> &new_theta );                                         ///< propose a new sample and save it in new_theta
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< adapt the proposal during burnin draws, then draw N samples with the frozen proposal
+		void sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin=0, unsigned int thin=1 );  ///< adapt the proposal during burnin draws, then add N samples to summary
+		Matrix * getProposalCovariance ( void ) const;                                    ///< return a pointer to a newly allocated matrix with the current proposal covariance
+		unsigned long getNadapted ( void ) const { return nadapted; }                     ///< number of steps at which the proposal was adapted
+		void saveState ( PsiCheckpointWriter * checkpoint ) const;                        ///< write the state including the learned proposal covariance
+		void loadState ( PsiCheckpointReader * checkpoint );                              ///< continue from a state that was written by saveState()
+};
+
 class HybridMCMC : public PsiSampler
 {
 	private:
@@ -134,16 +220,248 @@ class HybridMCMC : public PsiSampler
 			const PsiData * Data,                                                          ///< data to base inference on
 			int Nleap                                                                     ///< number of leapfrog steps to be performed for each sample
 			);                                                             ///< initialize the sampler
+		HybridMCMC ( const HybridMCMC& sampler );                                         ///< copy the sampler
 		~HybridMCMC ( void ) { delete proposal; }
+		PsiSampler * clone ( void ) const { return new HybridMCMC ( *this ); }           ///< clone by value
+		void setStream ( PsiRandomStream * newstream ) { PsiSampler::setStream ( newstream ); proposal->setStream ( newstream ); } ///< draw momenta from newstream
 		std::vector<double> draw ( void );                                                ///< draw a sample from the posterior
 		void setTheta ( const std::vector<double>& prm );                                 ///< set the current state of the sampler
 		std::vector<double> getTheta ( void ) { return currenttheta; }                    ///< get the current state of the sampler
 		void setStepSize ( double size, unsigned int param );                             ///< set stepsize of the leapfrog integration for parameter param
 		void setStepSize ( const std::vector<double>& sizes );                            ///< set all stepsizes of leapfrog integration for all parameters at once
 		double getDeviance ( void );                                                      ///< get the current deviance
-		MCMCList sample ( unsigned int N );                                              ///< draw N samples from the posterior
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< draw N samples from the posterior after discarding burnin draws, keeping every thin-th draw
+};
+
+struct NUTSState;
+struct NUTSTree;
+
+/** \brief No-U-Turn sampling (Hoffman & Gelman, 2014)
+ *
+ * A variant of hybrid monte carlo that does not need a fixed number of leapfrog steps: Each draw doubles a leapfrog
+ * trajectory in random directions until it starts to turn back on itself (or until it holds 2^maxdepth steps) and picks the
+ * new state from the trajectory. Leapfrog steps use the gradient of the negative log posterior from dneglpost(). The step for
+ * parameter i is epsilon*scale_i.
+ *
+ * During the burnin of sample(), the global step size epsilon is tuned by dual averaging such that the mean acceptance
+ * statistic approaches a target (default 0.8). In addition, the scales are set to the posterior standard deviations that
+ * are estimated from the middle of the burnin, after which the dual averaging is restarted. Step sizes are frozen for the
+ * stored samples. Initial scales are taken from the curvature of the likelihood at the starting value.
+ */
+class NUTS : public PsiSampler
+{
+	private:
+		PsiRandom* proposal;
+		std::vector<double> currenttheta;
+		std::vector<double> currentgradient;
+		double energy;                                                                    // negative log posterior at currenttheta
+		std::vector<double> scales;
+		double epsilon;
+		double delta;
+		unsigned int maxdepth;
+		double mu;                                                                        // dual averaging state
+		double Hbar;
+		double logepsbar;
+		unsigned long nadapt;
+		unsigned int nwarmup;                                                             // length of the current burnin
+		unsigned int nwarmupdone;
+		std::vector<double> warmupmean;                                                   // moments of the burnin samples for the scales
+		std::vector<double> warmupm2;
+		unsigned long nwarmupsamples;
+		double acceptsum;
+		unsigned long nleapfrog;
+		unsigned long ndivergent;
+		double logjoint ( const NUTSState& state ) const;                                // log of the joint density of position and momentum
+		void leapfrog ( NUTSState * state, double step );                                 // one leapfrog step of size step (negative steps go back)
+		bool noturn ( const NUTSState& minus, const NUTSState& plus ) const;              // does the trajectory still expand at both ends?
+		void buildtree ( const NUTSState& start, double logu, int direction, unsigned int depth, double joint0, NUTSTree * tree );
+		double reasonable_epsilon ( void );                                               // step size with an acceptance probability of about 0.5
+		void adapt ( double acceptstat );                                                 // dual averaging and scale estimation during the burnin
+		void warmup ( unsigned int burnin );                                              // draw burnin samples and adapt the step sizes
+	public:
+		NUTS (
+			const PsiPsychometric * Model,                                                ///< psychometric function model to sample from
+			const PsiData * Data,                                                         ///< data to base inference on
+			double targetaccept=0.8,                                                      ///< mean acceptance statistic that the step size adaptation aims at
+			unsigned int depth=10                                                         ///< maximum depth of the trajectory tree (at most 2^depth leapfrog steps per draw)
+			);                                                        ///< initialize the sampler
+		NUTS ( const NUTS& sampler );                                                     ///< copy the sampler
+		~NUTS ( void ) { delete proposal; }
+		PsiSampler * clone ( void ) const { return new NUTS ( *this ); }                 ///< clone by value
+		void setStream ( PsiRandomStream * newstream ) { PsiSampler::setStream ( newstream ); proposal->setStream ( newstream ); } ///< draw momenta and trajectories from newstream
+		std::vector<double> draw ( void );                                                ///< draw a sample from the posterior
+		void setTheta ( const std::vector<double>& prm );                                 ///< set the current state of the sampler
+		std::vector<double> getTheta ( void ) { return currenttheta; }                    ///< get the current state of the sampler
+		void setStepSize ( double size, unsigned int param );                             ///< set the leapfrog step for parameter param (resets epsilon to 1)
+		void setStepSize ( const std::vector<double>& sizes );                            ///< set the leapfrog steps for all parameters (resets epsilon to 1)
+		std::vector<double> getStepsize ( void ) const;                                   ///< current leapfrog steps epsilon*scale_i
+		double getDeviance ( void );                                                      ///< get the current deviance
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< adapt the step sizes during burnin draws, then draw N samples with frozen step sizes
+		void sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin=0, unsigned int thin=1 );  ///< adapt the step sizes during burnin draws, then add N samples to summary
+		unsigned long getNleapfrog ( void ) const { return nleapfrog; }                   ///< number of leapfrog steps (gradient evaluations) so far
+		unsigned long getNdivergent ( void ) const { return ndivergent; }                 ///< number of trajectories that were stopped because the energy diverged
+};
+
+/** \brief affine invariant ensemble sampling with the stretch move (Goodman & Weare, 2010)
+ *
+ * The sampler advances an ensemble of walkers. The ensemble is split into two halves. Each walker X_k of one half
+ * proposes Y = X_j + z*(X_k-X_j), where X_j is a random walker of the other half and z is drawn from g(z)~1/sqrt(z) on
+ * [1/a,a]. Y is accepted with probability min(1,z^(nparams-1)*P(Y|data)/P(X_k|data)). The proposals adapt to the shape
+ * of the posterior that is spanned by the ensemble, so that strongly correlated parameters (e.g. threshold and width of
+ * a weibull) do not slow down sampling.
+ *
+ * All walkers of a half move independently of each other. Their negative log posteriors are evaluated with
+ * neglpost_batch() in chunks that are distributed over up to nthreads threads. Threads are only started for halves with
+ * at least a few thousand block evaluations per thread; smaller halves are cheaper to evaluate than to hand out to
+ * threads. All random numbers are drawn before the evaluation, so that the result does not depend on the number of threads.
+ *
+ * sample() stores the chain of each walker as a chain of the MCMCList: walker w occupies samples w*N to (w+1)*N-1,
+ * MCMCList::getNchains() is the number of walkers and Rhat and the effective number of samples are determined as in
+ * sample_chains() (note that the walkers are not independent). draw() moves the whole ensemble and returns the first
+ * walker.
+ */
+class EnsembleSampler : public PsiSampler
+{
+	private:
+		PsiRandom* proposal;
+		std::vector< std::vector<double> > walkers;
+		std::vector<double> energies;                                                     // negative log posteriors of the walkers
+		std::vector<double> ballwidths;                                                   // spread of the walkers that are set up by setTheta()
+		double a;
+		unsigned int nthreads;
+		unsigned long naccepted;
+		unsigned long nproposed;
+		void update_half ( unsigned int first, unsigned int last, unsigned int cfirst, unsigned int clast );   // move walkers first..last-1 with the complement cfirst..clast-1
+		std::vector<double> evaluate ( const std::vector< std::vector<double> >& prm ) const;               // negative log posteriors in parallel chunks
+	public:
+		EnsembleSampler (
+			const PsiPsychometric * Model,                                                ///< psychometric function model to sample from
+			const PsiData * Data,                                                         ///< data to base inference on
+			unsigned int nwalkers=0,                                                      ///< number of walkers (even, at least 4; 0 uses 4*nparams)
+			double stretch=2.,                                                            ///< scale a of the stretch move (a>1)
+			unsigned int threads=1                                                        ///< number of threads that evaluate the proposals
+			);                                                        ///< initialize the sampler with walkers around the starting value of the model
+		EnsembleSampler ( const EnsembleSampler& sampler );                               ///< copy the sampler
+		~EnsembleSampler ( void ) { delete proposal; }
+		PsiSampler * clone ( void ) const { return new EnsembleSampler ( *this ); }      ///< clone by value
+		void setStream ( PsiRandomStream * newstream ) { PsiSampler::setStream ( newstream ); proposal->setStream ( newstream ); } ///< draw all random numbers from newstream
+		std::vector<double> draw ( void );                                                ///< move all walkers once and return the first walker
+		void setTheta ( const std::vector<double>& prm );                                 ///< place the first walker at prm and the others in a gaussian ball around prm
+		std::vector<double> getTheta ( void ) { return walkers[0]; }                      ///< get the position of the first walker
+		void setWalkers ( const std::vector< std::vector<double> >& positions );          ///< set the positions of all walkers
+		const std::vector< std::vector<double> >& getWalkers ( void ) const { return walkers; }   ///< positions of all walkers
+		unsigned int getNwalkers ( void ) const { return walkers.size(); }                ///< number of walkers
+		void setStepSize ( double size, unsigned int param );                             ///< set the spread of the ball of walkers for parameter param (used by setTheta())
+		void setStepSize ( const std::vector<double>& sizes );                            ///< set the spread of the ball of walkers for all parameters (used by setTheta())
+		double getDeviance ( void );                                                      ///< deviance of the first walker
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< move the ensemble burnin+N*thin times and store every thin-th position of each walker after the burnin (N*getNwalkers() samples)
+		void sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin=0, unsigned int thin=1 );  ///< as sample(), but add the positions of all walkers to summary
+};
+
+struct TemperedChain;
+
+/** \brief replica exchange (parallel tempering) sampling for multimodal posteriors
+ *
+ * The sampler runs one Metropolis Hastings chain for each inverse temperature beta_0<beta_1<...<beta_{K-1}=1. The chain at
+ * temperature beta samples from the tempered posterior, that is proportional to L(theta)^beta * prior(theta). Hot chains
+ * (small beta) move freely between the modes of the likelihood. Every swapinterval sweeps (one step of every chain),
+ * neighbouring chains propose to exchange their states, alternating between even and odd pairs. Through these exchanges,
+ * states that were found by the hot chains reach the cold chain (beta=1), that samples from the posterior.
+ *
+ * The chains run on up to nthreads threads between the exchanges. Each chain draws from its own PsiRandomStream, that is
+ * seeded from the sampler's stream when sampling starts, so the result does not depend on the number of threads. During
+ * the burnin, the stepwidths are scaled separately for each chain to an acceptance rate of about 0.234.
+ *
+ * After sampling, the mean log likelihood E_beta[log L] of all chains gives a thermodynamic integration estimate of the log
+ * evidence, log p(data) = int_0^1 E_beta[log L] d beta (trapezoidal rule over the temperatures). The default ladder
+ * beta_k = (k/(K-1))^5 starts at beta_0=0 (the hottest chain samples from the prior), so this estimate requires proper
+ * priors, as does ModelEvidence().
+ */
+class ParallelTempering : public PsiSampler
+{
+	private:
+		std::vector<TemperedChain*> chains;                 // ordered from hot to cold
+		std::vector<double> stepwidths;
+		unsigned int swapinterval;
+		unsigned int nthreads;
+		unsigned long nsweeps;                              // number of sweeps since the chains were set up
+		std::vector<unsigned long> swapattempts;            // for neighbouring chains k,k+1
+		std::vector<unsigned long> swapaccepts;
+		void seed_chains ( void );                          // give each chain its own substream of the sampler's stream
+		unsigned int advance ( unsigned int n, bool adapt );// run n sweeps (at most up to the next exchange), exchange states if it is due and return the number of sweeps
+		void exchange ( void );
+		void run ( unsigned int N, unsigned int burnin, unsigned int thin, MCMCList * list, MCMCSummary * summary );  // store the states of the cold chain in list or add them to summary
+	public:
+		ParallelTempering (
+			const PsiPsychometric * Model,                  ///< psychometric function model to sample from
+			const PsiData * Data,                           ///< data to base inference on
+			PsiRandom * proposal,                           ///< proposal distribution of the chains (scaled by the stepwidths, typically GaussRandom)
+			unsigned int ntemperatures=8,                   ///< number of chains (at least 2)
+			unsigned int interval=10,                       ///< number of sweeps between exchanges of states
+			unsigned int threads=1                          ///< number of threads that run the chains
+			);   ///< set up the chains at the starting value of the model
+		ParallelTempering ( const ParallelTempering& sampler );                           ///< copy the sampler including the states of all chains
+		~ParallelTempering ( void );
+		PsiSampler * clone ( void ) const { return new ParallelTempering ( *this ); }    ///< clone by value
+		std::vector<double> draw ( void );                                                ///< one sweep (with exchanges if they are due), returns the state of the cold chain
+		void setTheta ( const std::vector<double>& prm );                                 ///< set the states of all chains to prm
+		std::vector<double> getTheta ( void );                                            ///< state of the cold chain
+		void setStepSize ( double size, unsigned int param );                             ///< set the stepwidth for parameter param (each chain scales it during the burnin)
+		void setStepSize ( const std::vector<double>& sizes );                            ///< set the stepwidths for all parameters (each chain scales them during the burnin)
+		double getDeviance ( void );                                                      ///< deviance of the state of the cold chain
+		void setTemperatures ( const std::vector<double>& betas );                        ///< set the inverse temperatures (increasing from >=0 to 1, one for each chain)
+		std::vector<double> getTemperatures ( void ) const;                               ///< inverse temperatures of the chains from hot to cold
+		unsigned int getNtemperatures ( void ) const { return chains.size(); }            ///< number of chains
+		double getSwapRate ( unsigned int k ) const;                                      ///< fraction of accepted exchanges between chains k and k+1 in the last call to sample()
+		double getLogEvidence ( void ) const;                                             ///< thermodynamic integration estimate of the log evidence from the last call to sample()
+		MCMCList sample ( unsigned int N, unsigned int burnin=0, unsigned int thin=1 );  ///< burnin+N*thin sweeps, stores every thin-th state of the cold chain after the burnin
+		void sample ( unsigned int N, MCMCSummary * summary, unsigned int burnin=0, unsigned int thin=1 );  ///< as sample(), but add the states of the cold chain to summary
 };
 
+/** \brief run several markov chains in parallel
+ *
+ * For each starting value in start, a copy of sampler is made with clone() and N samples are drawn from that copy
+ * in a thread of its own. Each chain draws from its own PsiRandomStream: The streams are substreams 0,1,...
+ * of a seed that is taken from the default stream, so that the result does not depend on the scheduling of the
+ * threads. The model and the data are shared between the chains; their evaluation is read only.
+ *
+ * The chains are stored one after the other in the returned list (chain c occupies samples c*N to (c+1)*N-1).
+ * The acceptance rate of the list is the average over all chains. In addition, the list holds the
+ * potential scale reduction factor Rhat (Gelman & Rubin, 1992) and the effective number of samples for each
+ * parameter (see MCMCList::getRhat() and MCMCList::getNeff()).
+ *
+ * \param sampler  sampler to be copied for the chains. Step widths and other settings are taken from this sampler.
+ * \param start    starting values for the chains, one vector of parameters per chain
+ * \param N        number of samples to be stored for each chain
+ * \param burnin   number of draws that each chain discards before its first stored sample
+ * \param thin     each chain stores only every thin-th draw
+ */
+MCMCList sample_chains ( const PsiSampler * sampler, const std::vector< std::vector<double> >& start, unsigned int N, unsigned int burnin=0, unsigned int thin=1 );
+
+/** \brief sample a single chain with periodic checkpoints
+ *
+ * Draws the same samples as sampler->sample(N,burnin,thin) in chunks: first the burnin, then interval samples at a time.
+ * After each chunk, the new samples are appended to the log filename.samples, and the state of the sampler (see
+ * PsiSampler::saveState()) and of its random number stream (the default stream if the sampler has no stream of its own)
+ * are written to the checkpoint file. The cost of a checkpoint thus does not grow with the number of samples.
+ *
+ * If the checkpoint file exists when sample_checkpointed() is called, the run is resumed from the checkpoint instead:
+ * the sampler continues from the stored state, so that an interrupted and resumed run gives bit-identical results to a
+ * run that was not interrupted (with the same interval). Long runs can thus be split across jobs with limited wall time
+ * by calling sample_checkpointed() with the same file in each job. A checkpoint of a completed run simply returns the
+ * stored samples. A PsiError is thrown if the checkpoint belongs to a different dataset, model (see
+ * PsiPsychometric::getFingerprint()) or number of samples, and samplers that do not implement saveState() throw
+ * NotImplementedError.
+ *
+ * \param sampler  sampler to be run; its state is only used if there is no checkpoint yet
+ * \param N        number of samples to be stored
+ * \param burnin   number of draws that are discarded before the first stored sample
+ * \param thin     only every thin-th draw is stored
+ * \param filename checkpoint file
+ * \param interval number of samples between checkpoints
+ */
+MCMCList sample_checkpointed ( PsiSampler * sampler, unsigned int N, unsigned int burnin, unsigned int thin, const std::string& filename, unsigned int interval=1000 );
+
 /**
  * Model evidence (or marginal likelihood) is given by the following integral
  *
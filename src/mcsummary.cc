@@ -0,0 +1,300 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#include "mcsummary.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+/************************************************************
+ * PsiQuantileSketch methods
+ */
+
+PsiQuantileSketch::PsiQuantileSketch ( unsigned int k )
+	: k ( k<2 ? 2 : k ), levels ( 1 ), n ( 0 ), oddhalf ( false )
+{
+}
+
+void PsiQuantileSketch::compact ( unsigned int h )
+{
+	unsigned int i;
+	double keep ( 0 );
+	bool odd ( levels[h].size()%2==1 );
+
+	std::sort ( levels[h].begin(), levels[h].end() );
+	if ( odd ) {
+		// An odd value stays at this level so that the total weight is preserved
+		keep = levels[h].back();
+		levels[h].pop_back();
+	}
+
+	if ( levels.size()==h+1 )
+		levels.push_back ( std::vector<double> () );
+	for ( i=( oddhalf ? 1 : 0 ); i<levels[h].size(); i+=2 )
+		levels[h+1].push_back ( levels[h][i] );
+	oddhalf = !oddhalf;
+
+	levels[h].clear();
+	if ( odd )
+		levels[h].push_back ( keep );
+
+	if ( levels[h+1].size()>=k )
+		compact ( h+1 );
+}
+
+void PsiQuantileSketch::add ( double x )
+{
+	levels[0].push_back ( x );
+	n++;
+	if ( levels[0].size()>=k )
+		compact ( 0 );
+}
+
+void PsiQuantileSketch::merge ( const PsiQuantileSketch& sketch )
+{
+	unsigned int h;
+	while ( levels.size()<sketch.levels.size() )
+		levels.push_back ( std::vector<double> () );
+	for ( h=0; h<sketch.levels.size(); h++ )
+		levels[h].insert ( levels[h].end(), sketch.levels[h].begin(), sketch.levels[h].end() );
+	n += sketch.n;
+	for ( h=0; h<levels.size(); h++ )
+		if ( levels[h].size()>=k )
+			compact ( h );
+}
+
+double PsiQuantileSketch::quantile ( double p ) const
+{
+	if ( p<0 || p>1 )
+		throw BadArgumentError ( "PsiQuantileSketch::quantile: p should be between 0 and 1" );
+	if ( n==0 )
+		throw BadIndexError ();
+
+	unsigned int h, i;
+	double weight ( 0 ), target ( p*n );
+	std::vector< std::pair<double,double> > items;    // value, weight
+
+	for ( h=0; h<levels.size(); h++ )
+		for ( i=0; i<levels[h].size(); i++ )
+			items.push_back ( std::pair<double,double> ( levels[h][i], ldexp ( 1., h ) ) );
+	std::sort ( items.begin(), items.end() );
+
+	// The value at position int(p*n) of the sorted sample: the first value with more than p*n values up to it
+	for ( i=0; i<items.size(); i++ ) {
+		weight += items[i].second;
+		if ( weight>floor ( target ) )
+			return items[i].first;
+	}
+	return items.back().first;
+}
+
+unsigned int PsiQuantileSketch::size ( void ) const
+{
+	unsigned int h, s ( 0 );
+	for ( h=0; h<levels.size(); h++ )
+		s += levels[h].size();
+	return s;
+}
+
+/************************************************************
+ * MCMCSummary methods
+ */
+
+MCMCSummary::MCMCSummary ( unsigned int nprm, unsigned int nblocks, unsigned int reservoirsize, unsigned int sketchsize, unsigned long seed )
+	: nparams ( nprm ),
+	nblocks ( nblocks ),
+	nsamples ( 0 ),
+	mean ( nprm, 0 ),
+	m2 ( nprm, 0 ),
+	sketches ( nprm, PsiQuantileSketch ( sketchsize ) ),
+	deviancesum ( 0 ),
+	ndeviance ( 0 ),
+	nRpd ( 0 ),
+	nRkd ( 0 ),
+	logratiosum ( nblocks, 0 ),
+	logratiomax ( nblocks, -HUGE_VAL ),
+	logratioexpsum ( nblocks, 0 ),
+	reservoirsize ( reservoirsize ),
+	reservoirstream ( seed ),
+	accept_rate ( 0 )
+{
+}
+
+/** add exp(x) to the sum exp(max)*expsum without overflow */
+static void logsumexp_add ( double x, double * max, double * expsum )
+{
+	if ( x<=*max ) {
+		*expsum += exp ( x-*max );
+	} else {
+		*expsum = *expsum * exp ( *max-x ) + 1;
+		*max = x;
+	}
+}
+
+void MCMCSummary::add ( const MCMCSampleRecord& record )
+{
+	unsigned int prm, k;
+	unsigned long slot;
+	double delta;
+
+	if ( record.est.size()!=nparams || record.logratios.size()!=nblocks )
+		throw BadArgumentError ( "MCMCSummary::add: record does not match the number of parameters or blocks" );
+
+	nsamples++;
+	for ( prm=0; prm<nparams; prm++ ) {
+		delta = record.est[prm] - mean[prm];
+		mean[prm] += delta/nsamples;
+		m2[prm] += delta*(record.est[prm]-mean[prm]);
+		sketches[prm].add ( record.est[prm] );
+	}
+
+	deviancesum += record.deviance;
+	ndeviance += record.ppdeviance>=record.deviance;
+	nRpd += record.ppRpd>=record.Rpd;
+	nRkd += record.ppRkd>=record.Rkd;
+
+	for ( k=0; k<nblocks; k++ ) {
+		logratiosum[k] += record.logratios[k];
+		logsumexp_add ( record.logratios[k], &(logratiomax[k]), &(logratioexpsum[k]) );
+	}
+
+	// Reservoir sampling (algorithm R)
+	if ( reservoirsize==0 )
+		return;
+	if ( reservoirdeviance.size()<reservoirsize ) {
+		reservoir.insert ( reservoir.end(), record.est.begin(), record.est.end() );
+		reservoirdeviance.push_back ( record.deviance );
+	} else {
+		slot = (unsigned long) ( reservoirstream.genrand_real2() * nsamples );
+		if ( slot<reservoirsize ) {
+			std::copy ( record.est.begin(), record.est.end(), reservoir.begin()+slot*nparams );
+			reservoirdeviance[slot] = record.deviance;
+		}
+	}
+}
+
+void MCMCSummary::merge ( const MCMCSummary& summary )
+{
+	unsigned int prm, k, i, j;
+	unsigned long n ( nsamples+summary.nsamples );
+	double delta;
+
+	if ( summary.nparams!=nparams || summary.nblocks!=nblocks )
+		throw BadArgumentError ( "MCMCSummary::merge: summaries do not match in the number of parameters or blocks" );
+	if ( summary.nsamples==0 )
+		return;
+
+	// Moments are combined as in Chan, Golub & LeVeque (1979)
+	for ( prm=0; prm<nparams; prm++ ) {
+		delta = summary.mean[prm]-mean[prm];
+		mean[prm] += delta*summary.nsamples/n;
+		m2[prm] += summary.m2[prm] + delta*delta*double(nsamples)*summary.nsamples/n;
+		sketches[prm].merge ( summary.sketches[prm] );
+	}
+
+	deviancesum += summary.deviancesum;
+	ndeviance += summary.ndeviance;
+	nRpd += summary.nRpd;
+	nRkd += summary.nRkd;
+
+	for ( k=0; k<nblocks; k++ ) {
+		logratiosum[k] += summary.logratiosum[k];
+		if ( summary.logratiomax[k]<=logratiomax[k] ) {
+			logratioexpsum[k] += summary.logratioexpsum[k] * exp ( summary.logratiomax[k]-logratiomax[k] );
+		} else {
+			logratioexpsum[k] = logratioexpsum[k] * exp ( logratiomax[k]-summary.logratiomax[k] ) + summary.logratioexpsum[k];
+			logratiomax[k] = summary.logratiomax[k];
+		}
+	}
+
+	accept_rate = ( accept_rate*nsamples + summary.accept_rate*summary.nsamples ) / n;
+
+	// Both reservoirs are uniform subsets of their chains: fill the new reservoir from either of them in proportion to
+	// the number of samples that they represent
+	if ( reservoirsize>0 ) {
+		std::vector<double> newreservoir, newdeviance;
+		unsigned long restthis ( nsamples ), restother ( summary.nsamples );
+		i = j = 0;
+		while ( newdeviance.size()<reservoirsize && ( i<reservoirdeviance.size() || j<summary.reservoirdeviance.size() ) ) {
+			if ( j>=summary.reservoirdeviance.size()
+					|| ( i<reservoirdeviance.size() && reservoirstream.genrand_real2()*(restthis+restother)<restthis ) ) {
+				newreservoir.insert ( newreservoir.end(), reservoir.begin()+i*nparams, reservoir.begin()+(i+1)*nparams );
+				newdeviance.push_back ( reservoirdeviance[i] );
+				i++; restthis--;
+			} else {
+				newreservoir.insert ( newreservoir.end(), summary.reservoir.begin()+j*nparams, summary.reservoir.begin()+(j+1)*nparams );
+				newdeviance.push_back ( summary.reservoirdeviance[j] );
+				j++; restother--;
+			}
+		}
+		reservoir = newreservoir;
+		reservoirdeviance = newdeviance;
+	}
+
+	nsamples = n;
+}
+
+double MCMCSummary::getMean ( unsigned int prm ) const
+{
+	if ( prm>=nparams )
+		throw BadIndexError();
+	return mean[prm];
+}
+
+double MCMCSummary::getStd ( unsigned int prm ) const
+{
+	if ( prm>=nparams )
+		throw BadIndexError();
+	return sqrt ( m2[prm]/(nsamples-1) );
+}
+
+double MCMCSummary::getPercentile ( double p, unsigned int prm ) const
+{
+	if ( prm>=nparams )
+		throw BadIndexError();
+	return sketches[prm].quantile ( p );
+}
+
+double MCMCSummary::getDevianceMean ( void ) const
+{
+	return deviancesum/nsamples;
+}
+
+double MCMCSummary::getBayesianP_deviance ( void ) const
+{
+	return double(ndeviance)/nsamples;
+}
+
+double MCMCSummary::getBayesianP_Rpd ( void ) const
+{
+	return double(nRpd)/nsamples;
+}
+
+double MCMCSummary::getBayesianP_Rkd ( void ) const
+{
+	return double(nRkd)/nsamples;
+}
+
+double MCMCSummary::getlogratioMean ( unsigned int block ) const
+{
+	if ( block>=nblocks )
+		throw BadIndexError();
+	return logratiosum[block]/nsamples;
+}
+
+double MCMCSummary::getInfluence ( unsigned int block ) const
+{
+	if ( block>=nblocks )
+		throw BadIndexError();
+	return logratiomax[block] + log ( logratioexpsum[block]/nsamples ) - logratiosum[block]/nsamples;
+}
+
+PsiMClist MCMCSummary::getReservoir ( void ) const
+{
+	unsigned int i;
+	PsiMClist out ( reservoirdeviance.size(), nparams );
+	for ( i=0; i<reservoirdeviance.size(); i++ )
+		out.setEst ( i, std::vector<double> ( reservoir.begin()+i*nparams, reservoir.begin()+(i+1)*nparams ), reservoirdeviance[i] );
+	return out;
+}
@@ -0,0 +1,107 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#ifndef MCSUMMARY_H
+#define MCSUMMARY_H
+
+#include <vector>
+#include "errors.h"
+#include "rng.h"
+#include "mclist.h"
+
+/** \brief mergeable sketch of a distribution for approximate quantiles
+ *
+ * The sketch keeps a hierarchy of buffers (compactors, as in Karnin, Lang & Liberty, 2016). Values that enter the sketch
+ * are stored at level 0. If a level holds k values, they are sorted and every second value is moved to the next level,
+ * where it counts twice. Which half survives alternates between compactions, so the sketch does not consume random numbers.
+ * Memory is O(k log(N/k)) for N values and the rank error of a quantile is a small multiple of N/k. As long as at most k
+ * values entered the sketch, quantiles are exact.
+ */
+class PsiQuantileSketch
+{
+	private:
+		unsigned int k;
+		std::vector< std::vector<double> > levels;     // values at level h count 2^h times
+		unsigned long n;
+		bool oddhalf;
+		void compact ( unsigned int h );
+	public:
+		PsiQuantileSketch (
+			unsigned int k=256                         ///< number of values per level (larger is more accurate)
+			);   ///< set up an empty sketch
+		void add ( double x );                         ///< add a value
+		void merge ( const PsiQuantileSketch& sketch );///< add all values of another sketch
+		double quantile (
+			double p                                   ///< probability in [0,1]
+			) const;   ///< approximate p-quantile (same convention as PsiMClist::getPercentile())
+		unsigned long getN ( void ) const { return n; }   ///< number of values that entered the sketch
+		unsigned int size ( void ) const;                 ///< number of values that are currently stored
+};
+
+/** \brief constant memory summary of a posterior sample
+ *
+ * MCMCSummary is a sink for MCMC samples that replaces an MCMCList for long runs. Instead of storing every sample, it
+ * accumulates
+ *
+ * - the mean and standard deviation of each parameter (Welford's online algorithm),
+ * - a PsiQuantileSketch for the quantiles of each parameter,
+ * - the mean deviance and the number of samples for which the posterior predictive deviance, Rpd and Rkd are at least as
+ *   large as their observed counterparts (Bayesian p-values),
+ * - the mean of the log posterior ratios and the log of the mean of their exponentials for each block (influence), and
+ * - optionally a uniform random subset of bounded size of the samples (reservoir sampling), e.g. for plotting.
+ *
+ * Memory does not depend on the number of samples. Summaries of several chains can be combined with merge().
+ */
+class MCMCSummary
+{
+	private:
+		unsigned int nparams;
+		unsigned int nblocks;
+		unsigned long nsamples;
+		std::vector<double> mean;
+		std::vector<double> m2;                    // sum of squared deviations from the mean
+		std::vector<PsiQuantileSketch> sketches;
+		double deviancesum;
+		unsigned long ndeviance;
+		unsigned long nRpd;
+		unsigned long nRkd;
+		std::vector<double> logratiosum;
+		std::vector<double> logratiomax;           // log sum exp is accumulated relative to the largest log ratio
+		std::vector<double> logratioexpsum;
+		unsigned int reservoirsize;
+		std::vector<double> reservoir;             // reservoirsize x nparams, row major
+		std::vector<double> reservoirdeviance;
+		PsiRandomStream reservoirstream;
+		double accept_rate;
+	public:
+		MCMCSummary (
+			unsigned int nprm,                     ///< number of parameters in the model
+			unsigned int nblocks,                  ///< number of blocks in the experiment
+			unsigned int reservoirsize=0,          ///< number of samples that are kept (0 keeps no samples)
+			unsigned int sketchsize=256,           ///< number of values per level of the quantile sketches
+			unsigned long seed=0                   ///< seed of the random numbers for the reservoir (the sampler's stream is not touched)
+			);   ///< set up an empty summary
+		void add ( const MCMCSampleRecord& record );          ///< add a sample
+		void merge ( const MCMCSummary& summary );            ///< add all samples of another summary (e.g. another chain)
+		unsigned long getNsamples ( void ) const { return nsamples; }   ///< number of samples in the summary
+		unsigned int getNparams ( void ) const { return nparams; }      ///< number of parameters
+		unsigned int getNblocks ( void ) const { return nblocks; }      ///< number of blocks
+		double getMean ( unsigned int prm ) const;                      ///< posterior mean of parameter prm
+		double getStd ( unsigned int prm ) const;                       ///< posterior standard deviation of parameter prm
+		double getPercentile (
+			double p,                              ///< desired percentile (in the range (0,1))
+			unsigned int prm                       ///< index of the parameter of interest
+			) const;   ///< approximate percentile of parameter prm
+		double getDevianceMean ( void ) const;                          ///< posterior mean of the deviance
+		double getBayesianP_deviance ( void ) const;                    ///< fraction of samples with posterior predictive deviance >= deviance
+		double getBayesianP_Rpd ( void ) const;                         ///< fraction of samples with posterior predictive Rpd >= Rpd
+		double getBayesianP_Rkd ( void ) const;                         ///< fraction of samples with posterior predictive Rkd >= Rkd
+		double getlogratioMean ( unsigned int block ) const;            ///< mean log posterior ratio for leaving out block
+		double getInfluence ( unsigned int block ) const;               ///< log of the mean posterior ratio minus the mean log posterior ratio for block (as in pypsignifit)
+		PsiMClist getReservoir ( void ) const;                          ///< samples in the reservoir (at most reservoirsize) with their deviances
+		void set_accept_rate ( double rate ) { accept_rate = rate; }    ///< set the acceptance rate
+		double get_accept_rate ( void ) const { return accept_rate; }   ///< get the acceptance rate
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include "getstart.h"
 #include <cmath>
 #include <limits>
+#include <sys/time.h>
 
 // #define DEBUG_OPTIMIZER
 
@@ -30,6 +31,24 @@ PsiOptimizer::PsiOptimizer ( const PsiPsychometric * model, const PsiData * data
 
 PsiOptimizer::~PsiOptimizer ( void ) {}
 
+void PsiOptimizerReport::add ( const PsiOptimizerReport& report )
+{
+	nevaluations += report.nevaluations;
+	ngradients   += report.ngradients;
+	niterations  += report.niterations;
+	nshrinks     += report.nshrinks;
+	walltime     += report.walltime;
+	simplexsize   = report.simplexsize;
+	fspread       = report.fspread;
+	termination   = report.termination;
+}
+
+static double walltime ( void ) {
+	struct timeval t;
+	gettimeofday ( &t, NULL );
+	return t.tv_sec + 1e-6*t.tv_usec;
+}
+
 double testfunction(const std::vector<double>& x) {
 	double out(0);
 	unsigned int k;
@@ -89,9 +108,11 @@ void copy_lgst(const std::vector<double>& in, std::vector<double>& out, int npar
 }
 
 
-std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, const PsiData * data, const std::vector<double>* startingvalue )
+std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, const PsiData * data, const std::vector<double>* startingvalue, PsiOptimizerReport* report )
 {
 	int k, l;
+	PsiOptimizerReport rep;
+	double starttime ( walltime() );
 	std::vector<double> incr ( model->getNparams() );
 	if (startingvalue==NULL) {
 		// start = model->getStart(data);
@@ -176,6 +197,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 				if (modified[k]) {
 					copy_lgst(simplex[k], prm, nparameters);
 					fx[k] = model->neglpost(prm, data );
+					rep.nevaluations++;
 					modified[k] = false;
 				}
 				// fx[k] = testfunction(simplex[k]);
@@ -197,6 +219,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 					}
 					copy_lgst(simplex[k], prm, nparameters);
 					fx[k] = model->neglpost(prm, data );
+					rep.nevaluations++;
 				}
 			}
 
@@ -204,8 +227,11 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 			stepsize = 0;
 			for (k=0; k<nparameters; k++)
 				stepsize += (simplex[maxind][k]-simplex[minind][k])*(simplex[maxind][k]-simplex[minind][k]);
+			rep.simplexsize = stepsize;
+			rep.fspread = fx[maxind]-fx[minind];
 			// Simplex size
 			if (stepsize<maxstep) {
+				rep.termination = TERMINATION_SIMPLEXSIZE;
 #ifdef DEBUG_OPTIMIZER
 				logfile << "Terminating optimization due to small simplex size (" << stepsize << ") after " << iter << " iterations\n";
 				logfile.flush();
@@ -214,6 +240,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 			}
 			// function value differences
 			if ((fstepsize=(fx[maxind]-fx[minind])) < maxfstep ) {
+				rep.termination = TERMINATION_FVALUES;
 #ifdef DEBUG_OPTIMIZER
 				logfile << "Terminating optimization due to small function value variation (" << fstepsize << ") after " << iter << " iterations\n";
 				logfile.flush();
@@ -241,6 +268,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 			// Now check what to do
 			copy_lgst(xx, prm, nparameters);
 			ffx = model->neglpost(prm,data);
+			rep.nevaluations++;
 			// ffx = testfunction(xx);
 			if (ffx<fx[minind]) {
 				// The reflected point is better than the previous worst point ~> Expand
@@ -248,6 +276,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 				modified[maxind] = true;
 			} else if (ffx>fx[maxind]) {
 				// The reflected point is even worse than it was before ~> Shrink
+				rep.nshrinks++;
 				for (k=0; k<nparameters+1; k++) {
 					for (l=0; l<nparameters; l++)
 						simplex[k][l] = simplex[minind][l] + 0.5 * (simplex[k][l] - simplex[minind][l]);
@@ -260,7 +289,9 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 			}
 
 			// Also cancel if the number of iterations gets to large
+			rep.niterations++;
 			if (iter++ > maxiter) {
+				rep.termination = TERMINATION_MAXITER;
 #ifdef DEBUG_OPTIMIZER
 				logfile << "Terminating optimization due to large number of iterations (" << iter << "). Final stepsize: " << stepsize << "\n";
 				logfile.flush();
@@ -280,6 +311,7 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 					}
 				}
 				fx[k] = model->neglpost( prm, data );
+				rep.nevaluations++;
 				modified[k] = false;
 			}
 			// fx[k] = testfunction(simplex[k]);
@@ -344,5 +376,191 @@ std::vector<double> PsiOptimizer::optimize ( const PsiPsychometric * model, cons
 
 #endif
 
+	if ( report!=NULL ) {
+		rep.walltime = walltime()-starttime;
+		*report = rep;
+	}
+
 	return output;
 }
+
+/************************************************************
+ * PsiLBFGSOptimizer
+ */
+
+const int    lbfgs_maxiter ( 100 );
+const int    lbfgs_maxhalvings ( 40 );
+const double lbfgs_decrease ( 1e-9 );       // terminate if the predicted decrease of the posterior is smaller than this
+
+PsiLBFGSOptimizer::PsiLBFGSOptimizer ( const PsiPsychometric * model, const PsiData * data, unsigned int memory )
+	: PsiOptimizer ( model, data ), memory ( memory )
+{}
+
+/** negative log posterior and its gradient with respect to the optimization parameters (lambda and gamma on the logit scale) */
+static double lbfgs_objective ( const PsiPsychometric * model, const PsiData * data, const std::vector<double>& u, std::vector<double>* gradient )
+{
+	int l, nprm ( u.size() );
+	std::vector<double> prm ( nprm );
+	copy_lgst ( u, prm, nprm );
+
+	if ( gradient!=NULL ) {
+		*gradient = model->dneglpost ( prm, data );
+		for ( l=2; l<4 && l<nprm; l++ )
+			(*gradient)[l] *= prm[l]*(1-prm[l]);
+	}
+
+	return model->neglpost ( prm, data );
+}
+
+static double dot ( const std::vector<double>& a, const std::vector<double>& b )
+{
+	unsigned int k;
+	double s ( 0 );
+	for ( k=0; k<a.size(); k++ )
+		s += a[k]*b[k];
+	return s;
+}
+
+std::vector<double> PsiLBFGSOptimizer::optimize ( const PsiPsychometric * model, const PsiData * data, const std::vector<double>* startingvalue, PsiOptimizerReport* report )
+{
+	PsiOptimizerReport rep, simplexrep;
+	double starttime ( walltime() );
+	int k, m, iter, halvings, nprm ( model->getNparams() );
+	bool converged ( false );
+	double f, fnew, gd, step, b, sy;
+	std::vector<double> start ( nprm ), incr ( nprm );
+	std::vector<double> u ( nprm ), unew ( nprm ), g ( nprm ), gnew ( nprm ), d ( nprm ), h0 ( nprm, 1. );
+	std::vector<double> alpha ( memory );
+	std::vector< std::vector<double> > s, y;
+	std::vector<double> rho;
+
+	if ( startingvalue==NULL ) {
+		start = getstart ( model, data, 8, 3, 3, &incr );
+	} else {
+		for ( k=0; k<nprm; k++ ) {
+			start[k] = startingvalue->at(k);
+			incr[k] = ( k+nprm<int(startingvalue->size()) ? startingvalue->at(k+nprm) : 0.1*start[k] );
+		}
+	}
+
+	for ( k=0; k<nprm; k++ )
+		u[k] = ( k==2 || k==3 ? lgit ( start[k] ) : start[k] );
+	copy_lgst ( u, start, nprm );
+	f = lbfgs_objective ( model, data, u, &g );
+	rep.nevaluations++; rep.ngradients++;
+
+	// Initial inverse Hessian from the expected Fisher Information
+	try {
+		Matrix fisher ( nprm, nprm );
+		model->negllikeli_derivatives ( start, data, NULL, NULL, &fisher );
+		for ( k=0; k<nprm; k++ ) {
+			b = fisher(k,k);
+			if ( k==2 || k==3 )
+				b *= start[k]*(1-start[k]) * start[k]*(1-start[k]);
+			if ( b>0 && b==b )
+				h0[k] = 1./b;
+		}
+	} catch ( NotImplementedError ) {}
+
+	for ( iter=0; iter<lbfgs_maxiter && f==f && f<std::numeric_limits<double>::infinity(); iter++ ) {
+		// Search direction by the two loop recursion
+		d = g;
+		for ( m=s.size()-1; m>=0; m-- ) {
+			alpha[m] = rho[m] * dot ( s[m], d );
+			for ( k=0; k<nprm; k++ ) d[k] -= alpha[m]*y[m][k];
+		}
+		for ( k=0; k<nprm; k++ ) d[k] *= h0[k];
+		for ( m=0; m<int(s.size()); m++ ) {
+			b = rho[m] * dot ( y[m], d );
+			for ( k=0; k<nprm; k++ ) d[k] += (alpha[m]-b)*s[m][k];
+		}
+		for ( k=0; k<nprm; k++ ) d[k] = -d[k];
+
+		gd = dot ( g, d );
+		if ( !(gd<0) ) {
+			// Not a descent direction: forget the history
+			s.clear(); y.clear(); rho.clear();
+			for ( k=0; k<nprm; k++ ) d[k] = -h0[k]*g[k];
+			gd = dot ( g, d );
+		}
+
+		if ( -0.5*gd < lbfgs_decrease ) {
+			converged = true;
+			rep.termination = TERMINATION_DECREASE;
+			break;
+		}
+
+		// Backtracking line search
+		step = 1;
+		for ( halvings=0; halvings<lbfgs_maxhalvings; halvings++ ) {
+			for ( k=0; k<nprm; k++ ) unew[k] = u[k] + step*d[k];
+			fnew = lbfgs_objective ( model, data, unew, NULL );
+			rep.nevaluations++;
+			if ( fnew <= f + 1e-4*step*gd )
+				break;
+			step *= 0.5;
+		}
+		if ( halvings==lbfgs_maxhalvings )
+			break;
+
+		fnew = lbfgs_objective ( model, data, unew, &gnew );
+		rep.nevaluations++; rep.ngradients++;
+
+		// Update the history
+		for ( k=0; k<nprm; k++ ) {
+			d[k] = unew[k]-u[k];
+			gnew[k] -= g[k];
+		}
+		sy = dot ( d, gnew );
+		if ( sy>0 ) {
+			if ( s.size()==memory ) {
+				s.erase ( s.begin() ); y.erase ( y.begin() ); rho.erase ( rho.begin() );
+			}
+			s.push_back ( d );
+			y.push_back ( gnew );
+			rho.push_back ( 1./sy );
+		}
+		for ( k=0; k<nprm; k++ )
+			g[k] += gnew[k];
+
+		u = unew;
+		f = fnew;
+		rep.niterations++;
+	}
+
+	copy_lgst ( u, start, nprm );
+#ifdef DEBUG_OPTIMIZER
+	logfile << "L-BFGS: " << ( converged ? "converged" : "did not converge" ) << " after " << iter << " iterations\n";
+	logfile.flush();
+#endif
+
+	if ( !converged ) {
+		// Fall back to the simplex, starting from the best point so far
+		if ( !( f==f && f<std::numeric_limits<double>::infinity() ) ) {
+			start = PsiOptimizer::optimize ( model, data, startingvalue, &simplexrep );
+		} else {
+			start.insert ( start.end(), incr.begin(), incr.end() );
+			start = PsiOptimizer::optimize ( model, data, &start, &simplexrep );
+		}
+		rep.add ( simplexrep );
+	}
+
+	if ( report!=NULL ) {
+		rep.walltime = walltime()-starttime;
+		*report = rep;
+	}
+
+	return start;
+}
+
+PsiOptimizer * allocateOptimizer ( PsiOptimizerType type, const PsiPsychometric * model, const PsiData * data )
+{
+	switch ( type ) {
+		case OPTIMIZER_SIMPLEX:
+			return new PsiOptimizer ( model, data );
+		case OPTIMIZER_LBFGS:
+			return new PsiLBFGSOptimizer ( model, data );
+		default:
+			throw BadArgumentError ( "Unknown optimizer" );
+	}
+}
@@ -9,6 +9,40 @@
 #include "psychometric.h"
 #include "data.h"
 
+/** \brief optimization methods for maximum likelihood and MAP fits */
+enum PsiOptimizerType {
+	OPTIMIZER_SIMPLEX,                               ///< Nelder-Mead simplex (PsiOptimizer)
+	OPTIMIZER_LBFGS                                  ///< quasi Newton method with analytic gradients (PsiLBFGSOptimizer)
+};
+
+/** \brief reasons to terminate an optimization */
+enum PsiTermination {
+	TERMINATION_SIMPLEXSIZE,                         ///< the simplex became smaller than the tolerance
+	TERMINATION_FVALUES,                             ///< function values at the simplex nodes differed less than the tolerance
+	TERMINATION_MAXITER,                             ///< the maximum number of iterations was reached
+	TERMINATION_DECREASE                             ///< the decrease of the posterior predicted by the quasi Newton method became smaller than the tolerance
+};
+
+/** \brief report on the work that was done in a single optimization
+ *
+ * Counts are summed over all stages of the optimization (the simplex is restarted once after convergence, the quasi Newton
+ * method may be finished by the simplex). Termination and spread refer to the final stage.
+ */
+struct PsiOptimizerReport
+{
+	unsigned int nevaluations;                       ///< number of evaluations of the posterior
+	unsigned int ngradients;                         ///< number of evaluations of the gradient of the posterior
+	unsigned int niterations;                        ///< number of iterations
+	unsigned int nshrinks;                           ///< number of simplex shrink steps
+	double simplexsize;                              ///< final squared distance between the best and the worst simplex node (0 if no simplex was used)
+	double fspread;                                  ///< final difference between the worst and the best function value on the simplex (0 if no simplex was used)
+	double walltime;                                 ///< time spent in the optimization (in seconds)
+	PsiTermination termination;                      ///< why did the optimization stop?
+	PsiOptimizerReport ( void ) : nevaluations ( 0 ), ngradients ( 0 ), niterations ( 0 ), nshrinks ( 0 ),
+		simplexsize ( 0 ), fspread ( 0 ), walltime ( 0 ), termination ( TERMINATION_SIMPLEXSIZE ) {} ///< empty report
+	void add ( const PsiOptimizerReport& report );   ///< add counts and time of a subsequent optimization, termination and spread are taken from report
+};
+
 /** \brief Simplex optimization */
 class PsiOptimizer
 {
@@ -26,12 +60,44 @@ class PsiOptimizer
 			const PsiPsychometric * model,           ///< model to be fitted (this is needed at this point only to determine the amount of internal memory that is required)
 			const PsiData * data                     ///< data to be fitted (this is needed at this point only to determine the amount of internal memory that is required)
 			); ///< set up everything
-		~PsiOptimizer ( void );                                   ///< clean up everything
+		virtual ~PsiOptimizer ( void );                           ///< clean up everything
+		virtual std::vector<double> optimize (
+			const PsiPsychometric * model,           ///< model to be fitted
+			const PsiData * data,                    ///< data to be fitted
+			const std::vector<double>* startingvalue=NULL,   ///< starting value for optimization --- if this is longer the the number of parameters in the model, the additional values are used to span the simplex
+			PsiOptimizerReport* report=NULL                  ///< if not NULL, a report on the optimization is stored here
+			); ///< Start the optimization process
+};
+
+/** \brief Quasi Newton optimization using the analytic gradient of the posterior
+ *
+ * Limited memory BFGS on the same parameterization as the simplex in PsiOptimizer: lambda and gamma are optimized on the logit
+ * scale. Gradients are obtained from PsiPsychometric::dneglpost(). The initial inverse Hessian is the inverse of the diagonal of
+ * the expected Fisher information at the starting value (if the model provides it). Steps are accepted by a backtracking line
+ * search. Starting from a good starting value, a few iterations are sufficient.
+ *
+ * If the iteration does not converge within a fixed number of iterations or the line search fails, the optimization is
+ * continued from the current point using the simplex of PsiOptimizer.
+ */
+class PsiLBFGSOptimizer : public PsiOptimizer
+{
+	private:
+		unsigned int memory;                         // number of steps that are used to approximate the Hessian
+	public:
+		PsiLBFGSOptimizer (
+			const PsiPsychometric * model,           ///< model to be fitted
+			const PsiData * data,                    ///< data to be fitted
+			unsigned int memory=5                    ///< number of previous steps used to approximate the Hessian
+			);  ///< set up everything
 		std::vector<double> optimize (
 			const PsiPsychometric * model,           ///< model to be fitted
 			const PsiData * data,                    ///< data to be fitted
-			const std::vector<double>* startingvalue=NULL    ///< starting value for optimization --- if this is longer the the number of parameters in the model, the additional values are used to span the simplex
+			const std::vector<double>* startingvalue=NULL,   ///< starting value for optimization --- additional values are used as simplex increments if the simplex is needed
+			PsiOptimizerReport* report=NULL                  ///< if not NULL, a report on the optimization is stored here
 			); ///< Start the optimization process
 };
 
+/** \brief allocate an optimizer of the given type (to be deleted by the caller) */
+PsiOptimizer * allocateOptimizer ( PsiOptimizerType type, const PsiPsychometric * model, const PsiData * data );
+
 #endif
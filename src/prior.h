@@ -23,6 +23,7 @@ class PsiPrior
 		virtual double pdf ( double x ) const { return 1.;}    ///< evaluate the pdf of the prior at position x (in this default form, the parameter is completely unconstrained)
 		virtual double dpdf ( double x ) { return 0.; }  ///< evaluate the derivative of the pdf of the prior at position x (in this default form, the parameter is completely unconstrained)
 		virtual double rand ( void ) { return rng.draw(); } ///< draw a random number
+		virtual void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); } ///< draw random numbers from stream instead of the default stream
 		virtual PsiPrior * clone ( void ) const { throw NotImplementedError(); }///< clone by value
 		virtual double mean ( void ) const { return 0; } ///< return the mean
 		virtual double std  ( void ) const { return 1e5; } ///< return the standard deviation
@@ -54,6 +55,7 @@ class UniformPrior : public PsiPrior
 		double pdf ( double x ) const { return ( x>lower && x<upper ? height : 0 ); }                      ///< evaluate the pdf of the prior at position x
 		double dpdf ( double x ) { return ( x!=lower && x!=upper ? 0 : (x==lower ? 1e20 : -1e20 ));} ///< derivative of the pdf of the prior at position x (jumps at lower and upper are replaced by large numbers)
 		double rand ( void ) { return rng.draw(); }                                                 ///< draw a random number
+		void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); }          ///< draw random numbers from stream instead of the default stream
         PsiPrior * clone ( void ) const { return new UniformPrior(*this); }
 		double mean ( void ) const { return 0.5*(lower+upper); }  ///< return the mean
 		double std  ( void ) const { return sqrt((upper-lower)*(upper-lower)/12); }
@@ -90,8 +92,9 @@ class GaussPrior : public PsiPrior
                                                     twovar(original.twovar),
                                                     rng(original.rng) {} ///< copy contructor
 		double pdf ( double x ) const { return normalization * exp ( - (x-mu)*(x-mu)/twovar ); }                                              ///< return pdf of the prior at position x
-		double dpdf ( double x ) { return - x * pdf ( x ) / var; }                                                                      ///< return derivative of the prior at position x
+		double dpdf ( double x ) { return - (x-mu) * pdf ( x ) / var; }                                                                      ///< return derivative of the prior at position x
 		double rand ( void ) {return rng.draw(); }
+		void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); }          ///< draw random numbers from stream instead of the default stream
         PsiPrior * clone ( void ) const { return new GaussPrior(*this); }
 		double mean ( void ) const { return mu; } ///< mean
 		double std  ( void ) const { return sg; } ///< return standard deviation
@@ -130,8 +133,9 @@ class BetaPrior : public PsiPrior
                                                  rng(original.rng),
                                                  mode(original.mode) {} ///< copy constructor
 		double pdf ( double x ) const { return (x<1e-15||x>1.-1e-15 ? 0 : pow(x,alpha-1)*pow(1-x,beta-1)/normalization); }             ///< return beta pdf
-		double dpdf ( double x ) { return (x<1e-15||x>1.-1e-15 ? 0 : ((alpha-1)*pow(x,alpha-2)*pow(1-x,beta-1) + (beta-1)*pow(1-x,beta-2)*pow(x,alpha-1))/normalization); }      ///< return derivative of beta pdf
+		double dpdf ( double x ) { return (x<1e-15||x>1.-1e-15 ? 0 : ((alpha-1)*pow(x,alpha-2)*pow(1-x,beta-1) - (beta-1)*pow(1-x,beta-2)*pow(x,alpha-1))/normalization); }      ///< return derivative of beta pdf
 		double rand ( void ) {return rng.draw();};                                                                                         ///< draw a random number using rejection sampling
+		void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); }          ///< draw random numbers from stream instead of the default stream
         PsiPrior * clone ( void ) const { return new BetaPrior(*this); }
 		double mean ( void ) const { return alpha/(alpha+beta); }
 		double std  ( void ) const { return sqrt ( alpha*beta/((alpha+beta)*(alpha+beta)*(alpha+beta+1)) ); }
@@ -167,6 +171,7 @@ class GammaPrior : public PsiPrior
 		virtual double pdf ( double x ) const { return (x>1e-15 ? pow(x,k-1)*exp(-x/theta)/normalization : 0 );}                                                             ///< return pdf at position x
 		virtual double dpdf ( double x ) { return (x>1e-15 ? ( (k-1)*pow(x,k-2)*exp(-x/theta)-pow(x,k-1)*exp(-x/theta)/theta)/normalization : 0 ); }                   ///< return derivative of pdf
 		virtual double rand ( void ) {return rng.draw(); };
+		void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); }          ///< draw random numbers from stream instead of the default stream
         PsiPrior * clone ( void ) const { return new GammaPrior(*this); }
 		virtual double mean ( void ) const { return k*theta; }
 		double std  ( void ) const { return sqrt ( k*theta*theta ); }
@@ -228,6 +233,7 @@ class invGammaPrior : public PsiPrior
 		virtual double pdf ( double x ) const { return ( x>0 ? pow ( x, -alpha-1 ) * exp ( -beta/x ) * normalization : 0 ); }
 		virtual double dpdf ( double x ) { return (x>0 ? ( (-alpha-1)*pow(x,-alpha-2) * exp ( -beta/x ) + pow(x,-alpha-1) * exp ( -beta/x ) * beta / (x*x) ) * normalization : 0 ); }
 		virtual double rand ( void ) { return 1./rng.draw(); }
+		void setStream ( PsiRandomStream * stream ) { rng.setStream ( stream ); }          ///< draw random numbers from stream instead of the default stream
 		PsiPrior * clone ( void ) const { return new invGammaPrior(*this); }
 		virtual double mean ( void ) const { return beta/(alpha-1); }
 		double std ( void ) const { return ( alpha>2 ? beta / ( (alpha-1)*sqrt(alpha-2) ) : 1e5 ); }
@@ -19,5 +19,9 @@
 #include "special.h"
 #include "getstart.h"
 #include "integrate.h"
+#include "specialized.h"
+#include "fitcache.h"
+#include "mcsummary.h"
+#include "checkpoint.h"
 
 #endif
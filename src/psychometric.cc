@@ -72,65 +72,60 @@ double PsiPsychometric::evaluate ( double x, const std::vector<double>& prm ) co
 double PsiPsychometric::negllikeli ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	unsigned int i;
-	int n,k;
 	double l(0);
-	double x,p,lognoverk;
 
 	for (i=0; i<data->getNblocks(); i++)
-	{
-		n = data->getNtrials(i);
-		k = data->getNcorrect(i);
-		x = data->getIntensity(i);
-		lognoverk = data->getNoverK(i);
-		p = evaluate(x, prm);
-		l -= lognoverk;
-		if (p>0)
-			l -= k*log(p);
-		else
-			l += 1e10;
-		if (p<1)
-			l -= (n-k)*log(1-p);
-		else
-			l += 1e10;
-	}
+		l += binomial_negllikeli_term ( evaluate ( data->getIntensity(i), prm ), data->getNtrials(i), data->getNcorrect(i), data->getNoverK(i) );
 
 	return l;
 }
 
+std::vector<double> PsiPsychometric::logratios ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	// The priors do not depend on the data and cancel: Each ratio is the likelihood contribution of the omitted block
+	unsigned int i;
+	std::vector<double> out ( data->getNblocks() );
+
+	for (i=0; i<data->getNblocks(); i++)
+		out[i] = binomial_negllikeli_term ( evaluate ( data->getIntensity(i), prm ), data->getNtrials(i), data->getNcorrect(i), data->getNoverK(i) );
+
+	return out;
+}
+
 double PsiPsychometric::leastfavourable ( const std::vector<double>& prm, const PsiData* data, double cut, bool threshold ) const
 {
 	if (!threshold) throw NotImplementedError();  // So far we only have this for the threshold
 
-	std::vector<double> delta (prm.size(),0), du(prm.size(),0);
-	Matrix * I;
+	double delta[Matrix::nsmall], du[Matrix::nsmall];
+	Matrix I ( prm.size(), prm.size() );
 	double ythres;
-	double rz,nz,xz,pz,fac1;
+	double rz,nz,xz,pz,fac1,gz,fz,dfz;
+	double guess ( getGuess(prm) );
 	double l_LF(0);
 	double s;
 	unsigned int i,z;
 
+	if ( prm.size()>Matrix::nsmall )
+		throw BadArgumentError ( "leastfavourable: too many parameters" );
+	for (i=0; i<prm.size(); i++)
+		du[i] = 0;
+
 	// Fill u
 	ythres = Sigmoid->inv(cut);
 	du[0] = Core->dinv(ythres,prm,0);
 	du[1] = Core->dinv(ythres,prm,1);
 
 	// Determine 2nd derivative
-	I = ddnegllikeli ( prm, data );
+	negllikeli_derivatives ( prm, data, NULL, &I );
 
 	// Now we have to solve I*delta = du for delta
-	try {
-		delta = I->solve ( du );
-	} catch (std::string){
+	if ( !solve_small ( I, du, delta ) ) {
 		// In this case, the matrix is numerically singular
 		// Thats bad. We simply
-		delete I;
 		return 0;
 		// in that case
 	}
 
-	// I is not needed anymore
-	delete I;
-
 	// Normalize the result
 	s = 0;
 	for (i=0; i<prm.size(); i++)
@@ -144,13 +139,16 @@ double PsiPsychometric::leastfavourable ( const std::vector<double>& prm, const
 		rz = data->getNcorrect(z);
 		nz = data->getNtrials(z);
 		xz = data->getIntensity(z);
-		pz = evaluate(xz,prm);
+		gz = Core->g(xz,prm);
+		fz = Sigmoid->f(gz);
+		dfz = Sigmoid->df(gz);
+		pz = guess + (1-guess-prm[2]) * fz;
 		fac1 = rz/pz - (nz-rz)/(1-pz);
 		for (i=0; i<2; i++)
-			l_LF += delta[i] * fac1 * Sigmoid->df(Core->g(xz,prm)) * Core->dg(xz,prm,i);
+			l_LF += delta[i] * fac1 * dfz * Core->dg(xz,prm,i);
 	
 		for (i=2; i<prm.size(); i++)
-			l_LF += delta[i] * fac1 * ( (i==2 ? 1 : 0) - Sigmoid->f(Core->g(xz,prm)) );
+			l_LF += delta[i] * fac1 * ( (i==2 ? 1 : 0) - fz );
 	}
 
 	// If l_LF is nan, return 0
@@ -163,98 +161,199 @@ double PsiPsychometric::leastfavourable ( const std::vector<double>& prm, const
 Matrix * PsiPsychometric::ddnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	Matrix * I = new Matrix ( prm.size(), prm.size() );
+	negllikeli_derivatives ( prm, data, NULL, I );
+	return I;
+}
 
-	double rz,nz,pz,xz,dldf,ddlddf;
-	unsigned int z,i,j;
+std::vector<double> PsiPsychometric::dnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	std::vector<double> gradient;
+	negllikeli_derivatives ( prm, data, &gradient, NULL );
+	return gradient;
+}
 
-	// Fill I
-	for (z=0; z<data->getNblocks(); z++) {
-		nz = data->getNtrials(z);
-		xz = data->getIntensity(z);
-		pz = evaluate(xz,prm);
-		rz = data->getNcorrect(z);
-		// rz = pz*nz;     // expected Fisher Information matrix
-		dldf   = (nz-rz)/(1-pz) - rz/pz;
-		ddlddf = rz/(pz*pz) + (nz-rz)/((1-pz)*(1-pz));
-
-		// These parts must be determined
-		/*
-		for (i=0; i<2; i++) {
-			for (j=i; j<2; j++) {
-				(*I)(i,j) += fac1 * (1-guessingrate-prm[2]) * (Sigmoid->ddf(Core->g(xz,prm)) * Core->dg(xz,prm,i) * Core->dg(xz,prm,j) + Sigmoid->df(Core->g(xz,prm)) * Core->ddg(xz,prm,i,j));
-				(*I)(i,j) -= fac2 * (1-guessingrate-prm[2]) * (1-guessingrate-prm[2]) * pow(Sigmoid->df(Core->g(xz,prm)),2) * Core->dg(xz,prm,i) * Core->dg(xz,prm,j);
-			}
-			for (j=2; j<prm.size(); j++) {
-				(*I)(i,j) -= fac1 * Sigmoid->df(Core->g(xz,prm)) * Core->dg(xz,prm,i);
-				(*I)(i,j) -= fac2 * (1-guessingrate-prm[2]) * Sigmoid->df(Core->g(xz,prm)) * Core->dg(xz,prm,i) * ( (j==2 ? 0 : 1) - Sigmoid->f(Core->g(xz,prm)) );
-			}
-		}
-		for ( i=2; i<prm.size(); i++ ) {
-			for ( j=2; j<prm.size(); j++ ) {
-				(*I)(i,j) -= fac2 * ( (j==2 ? 0 : 1) - Sigmoid->f(Core->g(xz,prm)) ) * ( (i==2 ? 0 : 1 ) - Sigmoid->f(Core->g(xz,prm)) );
-			}
-		}
-		*/
-		for ( i=0; i<prm.size(); i++ ) {
-			for ( j=i; j<prm.size(); j++ ) {
-				(*I)(i,j) -= ddlddf * dpredict(prm,xz,i) * dpredict(prm,xz,j);
-				(*I)(i,j) -= dldf   * ddpredict ( prm, xz, i, j );
-			}
-		}
-	}
+double PsiPsychometric::negllikeli_derivatives ( const std::vector<double>& prm, const PsiData* data, std::vector<double>* gradient, Matrix* hessian, Matrix* fisher ) const
+{
+	return negllikeli_sweep ( PsiVirtualParts ( Core, Sigmoid ), prm, data, getGuess ( prm ), PsiPsychometric::getNparams(), gradient, hessian, fisher );
+}
+
+double PsiPsychometric::deviance ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i;
+	double D(0);
 
-	// The remaining parts of I can be copied
-	for (i=1; i<prm.size(); i++)
-		for (j=0; j<i; j++)
-			(*I)(i,j) = (*I)(j,i);
+	for ( i=0; i<data->getNblocks(); i++ )
+		D += binomial_deviance_term ( evaluate ( data->getIntensity(i), prm ), data->getNtrials(i), data->getPcorrect(i) );
 
-	return I;
+	return D;
 }
 
-std::vector<double> PsiPsychometric::dnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
+void PsiPsychometric::evaluate_state ( const std::vector<double>& prm, const PsiData* data, PsiEvaluation* state ) const
 {
-	std::vector<double> gradient (prm.size());
-	double rz,xz,pz,nz,dldf;
-	unsigned int z,i;
-	double guess (guessingrate);
-	if ( Nalternatives < 2 ) guess = prm[3];
-
-	for (z=0; z<data->getNblocks(); z++) {
-		rz = data->getNcorrect(z);
-		nz = data->getNtrials(z);
-		xz = data->getIntensity(z);
-		pz = evaluate(xz,prm);
-		dldf = rz/pz - (nz-rz)/(1-pz);
+	unsigned int i;
 
-		// fill gradient vector
-		for ( i=0; i<prm.size(); i++ ) {
-			gradient[i] -= dldf * dpredict ( prm, xz, i );
-		}
-	}
+	state->prm = prm;
+	state->p.resize ( data->getNblocks() );
+	for ( i=0; i<data->getNblocks(); i++ )
+		state->p[i] = evaluate ( data->getIntensity(i), prm );
 
-	return gradient;
+	score_state ( data, state );
 }
 
-double PsiPsychometric::deviance ( const std::vector<double>& prm, const PsiData* data ) const
+void PsiPsychometric::score_state ( const PsiData* data, PsiEvaluation* state ) const
 {
+	// The block terms are summed in the same order as in negllikeli(), neglpost() and deviance(), so the results are identical
 	unsigned int i;
-	int n;
-	double D(0);
-	double x,y,p;
+	double l(0),D(0);
+
+	state->logratios.resize ( data->getNblocks() );
+	state->devianceterms.resize ( data->getNblocks() );
 
 	for ( i=0; i<data->getNblocks(); i++ )
 	{
-		n = data->getNtrials(i);
-		y = data->getPcorrect(i);
-		x = data->getIntensity(i);
-		p = evaluate( x, prm );
-		if (y>0)
-			D += n*y*log(y/p);
-		if (y<1)
-			D += n*(1-y)*log((1-y)/(1-p));
+		state->logratios[i] = binomial_negllikeli_term ( state->p[i], data->getNtrials(i), data->getNcorrect(i), data->getNoverK(i) );
+		state->devianceterms[i] = binomial_deviance_term ( state->p[i], data->getNtrials(i), data->getPcorrect(i) );
+		l += state->logratios[i];
+		D += state->devianceterms[i];
 	}
-	D *= 2;
-	return D;
+
+	state->negllikeli = l;
+	state->deviance = D;
+	// Derived models may have more parameters than priors; their posterior is determined by score_state_unbatched()
+	for (i=0; i<priors.size(); i++)
+		l -= log( priors[i]->pdf(state->prm[i]) );
+	state->neglpost = l;
+}
+
+void PsiPsychometric::score_state_unbatched ( const PsiData* data, PsiEvaluation* state ) const
+{
+	PsiPsychometric::score_state ( data, state );    // deviance terms of the binomial model
+	state->negllikeli = negllikeli ( state->prm, data );
+	state->neglpost = neglpost ( state->prm, data );
+	state->deviance = deviance ( state->prm, data );
+	state->logratios = logratios ( state->prm, data );
+}
+
+std::vector<double> PsiPsychometric::batch_by_calls ( Statistic f, const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m;
+	std::vector<double> out ( prm.size() );
+
+	for ( m=0; m<prm.size(); m++ )
+		out[m] = (this->*f) ( prm[m], data );
+
+	return out;
+}
+
+std::vector< std::vector<double> > PsiPsychometric::batch_by_calls ( VectorStatistic f, const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m;
+	std::vector< std::vector<double> > out ( prm.size() );
+
+	for ( m=0; m<prm.size(); m++ )
+		out[m] = (this->*f) ( prm[m], data );
+
+	return out;
+}
+
+std::vector<double> PsiPsychometric::negllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m, i, nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const int * k ( elements_of ( data->getNcorrect() ) );
+	const double * lognoverk ( elements_of ( data->getNoverK() ) );
+	std::vector<double> fx ( nblocks );
+	std::vector<double> out ( prm.size() );
+	double l, guess, scale;
+
+	for ( m=0; m<prm.size(); m++ ) {
+		Core->g_batch ( nblocks, x, prm[m], elements_of ( fx ) );
+		Sigmoid->f_batch ( nblocks, elements_of ( fx ), elements_of ( fx ) );
+		guess = getGuess ( prm[m] );
+		scale = 1-guess-prm[m][2];
+		l = 0;
+		for ( i=0; i<nblocks; i++ )
+			l += binomial_negllikeli_term ( guess + scale * fx[i], n[i], k[i], lognoverk[i] );
+		out[m] = l;
+	}
+
+	return out;
+}
+
+std::vector<double> PsiPsychometric::neglpost_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m, i;
+	std::vector<double> out ( negllikeli_batch ( prm, data ) );
+
+	for ( m=0; m<prm.size(); m++ )
+		for ( i=0; i<getNparams(); i++ )
+			out[m] -= log ( priors[i]->pdf ( prm[m][i] ) );
+
+	return out;
+}
+
+std::vector<double> PsiPsychometric::deviance_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m, i, nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const double * y ( elements_of ( data->getPcorrect() ) );
+	std::vector<double> fx ( nblocks );
+	std::vector<double> out ( prm.size() );
+	double D, guess, scale;
+
+	for ( m=0; m<prm.size(); m++ ) {
+		Core->g_batch ( nblocks, x, prm[m], elements_of ( fx ) );
+		Sigmoid->f_batch ( nblocks, elements_of ( fx ), elements_of ( fx ) );
+		guess = getGuess ( prm[m] );
+		scale = 1-guess-prm[m][2];
+		D = 0;
+		for ( i=0; i<nblocks; i++ )
+			D += binomial_deviance_term ( guess + scale * fx[i], n[i], y[i] );
+		out[m] = D;
+	}
+
+	return out;
+}
+
+std::vector< std::vector<double> > PsiPsychometric::dnegllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m, z, nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const int * k ( elements_of ( data->getNcorrect() ) );
+	std::vector<double> gx ( nblocks ), fx ( nblocks ), dfx ( nblocks ), dg0 ( nblocks ), dg1 ( nblocks ), dldf ( nblocks );
+	std::vector< std::vector<double> > out ( prm.size() );
+	double pz, guess, scale;
+
+	for ( m=0; m<prm.size(); m++ ) {
+		const std::vector<double>& theta ( prm[m] );
+		Core->g_batch ( nblocks, x, theta, elements_of ( gx ) );
+		Core->dg_batch ( nblocks, x, theta, 0, elements_of ( dg0 ) );
+		Core->dg_batch ( nblocks, x, theta, 1, elements_of ( dg1 ) );
+		Sigmoid->f_batch ( nblocks, elements_of ( gx ), elements_of ( fx ) );
+		Sigmoid->df_batch ( nblocks, elements_of ( gx ), elements_of ( dfx ) );
+		guess = getGuess ( theta );
+		scale = 1-guess-theta[2];
+		for ( z=0; z<nblocks; z++ ) {
+			pz = guess + scale * fx[z];
+			dldf[z] = k[z]/pz - (n[z]-k[z])/(1-pz);
+		}
+
+		// same terms as in dpredict()
+		out[m] = std::vector<double> ( theta.size(), 0 );
+		for ( z=0; z<nblocks; z++ ) {
+			out[m][0] -= dldf[z] * ( scale * dfx[z] * dg0[z] );
+			out[m][1] -= dldf[z] * ( scale * dfx[z] * dg1[z] );
+			out[m][2] -= dldf[z] * ( -fx[z] );
+		}
+		if ( theta.size()>3 && getNalternatives()<2 )
+			for ( z=0; z<nblocks; z++ )
+				out[m][3] -= dldf[z] * ( 1-fx[z] );
+	}
+
+	return out;
 }
 
 void PsiPsychometric::setPrior ( unsigned int index, PsiPrior* prior ) throw(BadArgumentError)
@@ -437,40 +536,75 @@ std::vector<double> PsiPsychometric::getStart ( const PsiData* data ) const
 	return out;
 }
 
+std::vector<double> PsiPsychometric::getFingerprint ( const PsiData* data ) const
+{
+	// Different cores, sigmoids or priors give different starting values or different predictions at the starting values
+	unsigned int i;
+	std::vector<double> prm ( getStart ( data ) ), out;
+
+	out.push_back ( getNparams() );
+	out.push_back ( Nalternatives );
+	out.insert ( out.end(), prm.begin(), prm.end() );
+	for ( i=0; i<data->getNblocks(); i++ )
+		out.push_back ( evaluate ( data->getIntensity(i), prm ) );
+	for ( i=0; i<priors.size() && i<prm.size(); i++ ) {
+		out.push_back ( priors[i]->pdf ( prm[i] ) );
+		out.push_back ( priors[i]->mean() );
+		out.push_back ( priors[i]->std() );
+	}
+	// NaN would not compare equal to itself
+	for ( i=0; i<out.size(); i++ )
+		if ( out[i]!=out[i] )
+			out[i] = -1e300;
+
+	return out;
+}
+
 std::vector<double> PsiPsychometric::getDevianceResiduals ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	unsigned int i;
-	int n;
-	double x,y,p;
+	double y,p;
 	std::vector<double> out (data->getNblocks());
 
 	for ( i=0; i<data->getNblocks(); i++ )
 	{
-		n = data->getNtrials(i);
 		y = data->getPcorrect(i);
-		x = data->getIntensity(i);
-		p = evaluate(x,prm);
-		out[i] = 0;
-		if (y>0)
-			out[i] += n*y*log(y/p);
-		if (y<1)
-			out[i] += n*(1-y)*log((1-y)/(1-p));
-		out[i] = (y>p?1:-1) * sqrt(2*out[i]);
+		p = evaluate(data->getIntensity(i),prm);
+		out[i] = (y>p?1:-1) * sqrt(binomial_deviance_term ( p, data->getNtrials(i), y ));
 	}
 
 	return out;
 }
 
+std::vector<double> PsiPsychometric::getDevianceResiduals ( const PsiEvaluation& state, const PsiData* data ) const
+{
+	unsigned int i;
+	std::vector<double> out (data->getNblocks());
+
+	for ( i=0; i<data->getNblocks(); i++ )
+		out[i] = (data->getPcorrect(i)>state.p[i]?1:-1) * sqrt(state.devianceterms[i]);
+
+	return out;
+}
+
 double PsiPsychometric::getRpd ( const std::vector<double>& devianceresiduals, const std::vector<double>& prm, const PsiData* data ) const {
 	int k,N(data->getNblocks());
-	double Ed(0),Ep(0),vard(0),varp(0),R(0);
-	std::vector<double> p ( N );
+	PsiEvaluation state;
 
 	// Evaluate p values in advance
+	state.p.resize ( N );
 	for ( k=0; k<N; k++ ) {
-		p[k] = evaluate(data->getIntensity(k),prm);
+		state.p[k] = evaluate(data->getIntensity(k),prm);
 	}
 
+	return getRpd ( devianceresiduals, state );
+}
+
+double PsiPsychometric::getRpd ( const std::vector<double>& devianceresiduals, const PsiEvaluation& state ) const {
+	int k,N(state.p.size());
+	double Ed(0),Ep(0),vard(0),varp(0),R(0);
+	const std::vector<double>& p ( state.p );
+
 	// Calculate averages
 	for ( k=0; k<N; k++ ) {
 		Ed += devianceresiduals[k];
@@ -560,10 +694,45 @@ double PsiPsychometric::dllikeli ( std::vector<double> prm, const PsiData* data,
 
 double PsiPsychometric::dlposteri ( std::vector<double> prm, const PsiData* data, unsigned int i ) const
 {
-	if ( i < getNparams() )
-		return dllikeli ( prm, data, i ) + priors[i]->dpdf(prm[i]);
-	else
+	double p;
+	if ( i >= getNparams() )
 		return 0;
+	// log(prior) contributes dpdf/pdf
+	p = priors[i]->pdf ( prm[i] );
+	return dllikeli ( prm, data, i ) + ( p>0 ? priors[i]->dpdf(prm[i])/p : 0 );
+}
+
+std::vector<double> PsiPsychometric::dlposteri ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i;
+	std::vector<double> out ( getNparams() );
+	for ( i=0; i<getNparams(); i++ )
+		out[i] = dlposteri ( prm, data, i );
+	return out;
+}
+
+std::vector<double> PsiPsychometric::dneglpost ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	std::vector< std::vector<double> > theta ( 1, prm );
+	return dneglpost_batch ( theta, data )[0];
+}
+
+std::vector< std::vector<double> > PsiPsychometric::dneglpost_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m, i;
+	double p;
+	std::vector< std::vector<double> > out ( dnegllikeli_batch ( prm, data ) );
+
+	// -log(prior) contributes -dpdf/pdf
+	for ( m=0; m<prm.size(); m++ ) {
+		for ( i=0; i<priors.size() && i<prm[m].size(); i++ ) {
+			p = priors[i]->pdf ( prm[m][i] );
+			if ( p>0 )
+				out[m][i] -= priors[i]->dpdf ( prm[m][i] ) / p;
+		}
+	}
+
+	return out;
 }
 
 double PsiPsychometric::dpredict ( const std::vector<double>& prm, double x, unsigned int i ) const {
@@ -599,79 +768,94 @@ double PsiPsychometric::ddpredict ( const std::vector<double>& prm, double x, un
 
 double PMF_with_JeffreysPrior::neglpost ( const std::vector<double>& prm, const PsiData* data ) const
 {
-	unsigned int i, j, k;
-	double dd, pk, dpi, dpj;
-
-	// calculate expected Fisher Information
-	for ( i=0; i<getNparams(); i++ ) {
-		for ( j=i; j<getNparams(); j++ ) {
-			dd = 0;
-			for ( k=0; k<data->getNblocks(); k++ ) {
-				pk = evaluate ( data->getIntensity(k), prm );
-				dpi = dpredict ( prm, data->getIntensity(k), i );
-				dpj = dpredict ( prm, data->getIntensity(k), j );
-				dd += data->getNtrials(k) * (1./pk + 1./(1-pk)) * dpi * dpj;
-			}
-			fisher(i,j) = fisher(j,i) = dd;
+	double l;
+	Matrix fisher ( getNparams(), getNparams() );      // local to keep neglpost safe for concurrent callers
+
+	// negative log likelihood and expected Fisher Information in one sweep
+	l = negllikeli_derivatives ( prm, data, NULL, NULL, &fisher );
+
+	return l - 0.5*logdet_small ( fisher );
+}
+
+std::vector<double> PMF_with_JeffreysPrior::logratios ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	// Jeffreys prior depends on the data: Each block contributes a rank one term to the expected Fisher Information.
+	unsigned int i, j, k, nprm ( getNparams() ), nblocks ( data->getNblocks() );
+	double pk, logdet;
+	std::vector<double> out ( PsiPsychometric::logratios ( prm, data ) );
+	std::vector<double> w ( nblocks );
+	std::vector< std::vector<double> > dp ( nblocks, std::vector<double> ( nprm ) );
+	Matrix fisher ( nprm, nprm );
+	Matrix reduced ( nprm, nprm );
+
+	for ( k=0; k<nblocks; k++ ) {
+		pk = evaluate ( data->getIntensity(k), prm );
+		w[k] = data->getNtrials(k) * (1./pk + 1./(1-pk));
+		for ( i=0; i<nprm; i++ )
+			dp[k][i] = dpredict ( prm, data->getIntensity(k), i );
+		for ( i=0; i<nprm; i++ )
+			for ( j=0; j<nprm; j++ )
+				fisher(i,j) += w[k] * dp[k][i] * dp[k][j];
+	}
+	logdet = logdet_small ( fisher );
+
+	for ( k=0; k<nblocks; k++ ) {
+		for ( i=0; i<nprm; i++ )
+			for ( j=0; j<nprm; j++ )
+				reduced(i,j) = fisher(i,j) - w[k] * dp[k][i] * dp[k][j];
+		out[k] += 0.5*logdet_small ( reduced ) - 0.5*logdet;
+	}
+
+	return out;
+}
+
+std::vector<double> PMF_with_JeffreysPrior::dneglpost ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i, j, z, nprm ( getNparams() );
+	double xz, pz, nz, w, dwdp, q;
+	std::vector<double> gradient;
+	double dp[Matrix::nsmall], v[Matrix::nsmall], trace[Matrix::nsmall];
+	Matrix fisher ( nprm, nprm );
+	Matrix ddp ( nprm, nprm );
+	Matrix fisherinv ( nprm, nprm );
+
+	// gradient of the likelihood term and expected Fisher Information in one sweep (this rejects more than Matrix::nsmall parameters)
+	negllikeli_derivatives ( prm, data, &gradient, NULL, &fisher );
+	inverse_small ( fisher, &fisherinv );
+	for ( i=0; i<nprm; i++ )
+		trace[i] = 0;
+
+	// fisher is the sum of w_z * dp_z * dp_z^T, thus the derivatives of log det(fisher) are
+	// sum_z dw_z/dtheta_i * dp_z^T fisherinv dp_z + 2 * w_z * dp_z^T fisherinv d(dp_z)/dtheta_i
+	for ( z=0; z<data->getNblocks(); z++ ) {
+		xz = data->getIntensity ( z );
+		nz = data->getNtrials ( z );
+		pz = evaluate ( xz, prm );
+		w    = nz * (1./pz + 1./(1-pz));
+		dwdp = nz * (1./((1-pz)*(1-pz)) - 1./(pz*pz));
+		for ( i=0; i<nprm; i++ ) {
+			dp[i] = dpredict ( prm, xz, i );
+			for ( j=i; j<nprm; j++ )
+				ddp(i,j) = ddp(j,i) = ddpredict ( prm, xz, i, j );
+		}
+		q = 0;
+		for ( i=0; i<nprm; i++ ) {
+			v[i] = 0;
+			for ( j=0; j<nprm; j++ )
+				v[i] += fisherinv(i,j) * dp[j];
+			q += dp[i] * v[i];
+		}
+		for ( i=0; i<nprm; i++ ) {
+			trace[i] += dwdp * dp[i] * q;
+			for ( j=0; j<nprm; j++ )
+				trace[i] += 2 * w * v[j] * ddp(j,i);
 		}
 	}
-	
-	// Calculate Determinant
-	if (getNparams()==3) {
-		dd = fisher(0,0)*fisher(1,1)*fisher(2,2)
-			+ fisher(0,1)*fisher(1,2)*fisher(2,0)
-			+ fisher(1,0)*fisher(2,1)*fisher(0,2)
-			- fisher(0,2)*fisher(1,1)*fisher(2,0)
-			- fisher(0,0)*fisher(1,2)*fisher(2,1)
-			- fisher(2,2)*fisher(0,1)*fisher(1,0);
-	} else if (getNparams()==4) {
-		dd = fisher(0,0)*
-			( fisher(1,1)*fisher(2,2)*fisher(3,3) + fisher(1,2)*fisher(2,3)*fisher(3,1) + fisher(2,1)*fisher(3,2)*fisher(1,3)
-			- fisher(1,3)*fisher(2,2)*fisher(3,1) - fisher(1,2)*fisher(2,1)*fisher(3,3) - fisher(1,1)*fisher(2,3)*fisher(3,2) );
-		// std::cout << "dd0 = " << dd << "\n";
-		dd -= fisher(1,0)*
-			( fisher(0,1)*fisher(2,2)*fisher(3,3) + fisher(0,2)*fisher(2,3)*fisher(3,1) + fisher(0,3)*fisher(2,1)*fisher(3,2)
-			- fisher(0,3)*fisher(2,2)*fisher(3,1) - fisher(0,2)*fisher(2,1)*fisher(3,3) - fisher(0,1)*fisher(2,3)*fisher(3,2) );
-		// std::cout << "dd1 = " << dd << "\n";
-		dd += fisher(2,0)*
-			( fisher(0,1)*fisher(1,2)*fisher(3,3) + fisher(0,2)*fisher(1,3)*fisher(3,1) + fisher(0,3)*fisher(1,1)*fisher(3,2)
-			- fisher(0,3)*fisher(1,2)*fisher(3,1) - fisher(0,2)*fisher(1,1)*fisher(3,3) - fisher(0,1)*fisher(1,3)*fisher(3,2) );
-		// std::cout << "dd2 = " << dd << "\n";
-		dd -= fisher(3,0)*
-			( fisher(0,1)*fisher(1,2)*fisher(2,3) + fisher(0,2)*fisher(1,3)*fisher(2,1) + fisher(0,3)*fisher(1,1)*fisher(2,2)
-			- fisher(0,3)*fisher(1,2)*fisher(2,1) - fisher(0,2)*fisher(1,1)*fisher(2,3) - fisher(0,1)*fisher(1,3)*fisher(2,2) );
-		// std::cout << "dd3 = " << dd << "\n";
-	}
-
-	// std::cerr << prm[0] << " " << prm[1] << " " << prm[2] << " " << dd << " " << negllikeli (prm, data ) << " " << 0.5*log(dd) << "\n";
-
-	// if ( dd!=dd ) {
-	// 	std::cerr << "I = [ [ " << fisher(0,0) << ", " << fisher(0,1) << ", " << fisher(0,2) << "],\n"
-	// 					<< "[ " << fisher(1,0) << ", " << fisher(1,1) << ", " << fisher(1,2) << "],\n"
-	// 					<< "[ " << fisher(2,0) << ", " << fisher(2,1) << ", " << fisher(2,2) << "]]\n";
-	// }
-
-	/*
-	std::cout << "I = [ [ " << fisher(0,0) << ", " << fisher(0,1) << ", " << fisher(0,2) << ", " << fisher(0,3) << "],\n"
-					<< "[ " << fisher(1,0) << ", " << fisher(1,1) << ", " << fisher(1,2) << ", " << fisher(1,3) << "],\n"
-					<< "[ " << fisher(2,0) << ", " << fisher(2,1) << ", " << fisher(2,2) << ", " << fisher(2,3) << "],\n"
-					<< "[ " << fisher(3,0) << ", " << fisher(3,1) << ", " << fisher(3,2) << ", " << fisher(3,3) << "]]\n";
-
-	std::cout << "dd = " << dd << "\n";
-	*/
-
-	return negllikeli ( prm, data ) - 0.5*log(dd);
-}
-
-double PMF_with_JeffreysPrior::dlposteri ( std::vector<double> prm, const PsiData* data, unsigned int i ) const
-{
-	// numerical approximation
-	double df, h(.001);
-	std::vector<double> prm2 (prm);
-
-	prm2[i] += h;
-	df = neglpost ( prm2, data ) - neglpost ( prm, data );
-	return df/h;
+
+	for ( i=0; i<nprm; i++ )
+		gradient[i] -= 0.5*trace[i];
+
+	return gradient;
 }
 
 /******************************** BetaPsychometric **************************************/
@@ -711,6 +895,38 @@ double BetaPsychometric::negllikeli ( const std::vector<double>& prm, const PsiD
 	return l;
 };
 
+std::vector<double> BetaPsychometric::logratios ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i;
+	int n;
+	double k;
+	double p,al,bt;
+	double nu ( prm[getNparams()-1] );
+	std::vector<double> out ( data->getNblocks() );
+
+	for (i=0; i<data->getNblocks(); i++)
+	{
+		n = data->getNtrials(i);
+		k = data->getPcorrect(i);
+		if ( k==1 || k==0 )
+			k = double (data->getNcorrect(i))/(0.5+n);
+		p = evaluate (data->getIntensity(i), prm);
+		al = p*nu*n;
+		bt = (1-p)*nu*n;
+		out[i] = - gammaln ( nu*n ) + gammaln ( al ) + gammaln ( bt );
+		if (k>0)
+			out[i] -= (al-1)*log(k);
+		else
+			out[i] += 1e10;
+		if (k<1)
+			out[i] -= (bt-1)*log(1-k);
+		else
+			out[i] += 1e10;
+	}
+
+	return out;
+}
+
 std::vector<double> BetaPsychometric::dnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	std::vector<double> out ( prm.size(), 0 );
@@ -754,11 +970,37 @@ std::vector<double> BetaPsychometric::dnegllikeli ( const std::vector<double>& p
 Matrix * BetaPsychometric::ddnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	Matrix * I = new Matrix ( prm.size(), prm.size() );
+	negllikeli_derivatives ( prm, data, NULL, I );
+	return I;
+};
+
+double BetaPsychometric::negllikeli_derivatives ( const std::vector<double>& prm, const PsiData* data, std::vector<double>* gradient, Matrix* hessian, Matrix* fisher ) const
+{
+	if ( fisher!=NULL )
+		throw NotImplementedError();  // The expected Fisher Information is not yet implemented for the beta binomial model
+
+	if ( gradient!=NULL )
+		*gradient = dnegllikeli ( prm, data );
+
+	if ( hessian!=NULL )
+		fill_hessian ( prm, data, hessian );
+
+	return negllikeli ( prm, data );
+}
+
+void BetaPsychometric::fill_hessian ( const std::vector<double>& prm, const PsiData* data, Matrix* hessian ) const
+{
 	unsigned int i, j, z;
 	double xz, pz, nz, nunz, fz, dldf, ddlddf, dfda, ddldfdnu;
 	unsigned int nupos ( getNparams()-1 );
 	double nu ( prm[nupos] );
 
+	if ( hessian->getnrows()!=prm.size() || hessian->getncols()!=prm.size() )
+		throw BadArgumentError ( "negllikeli_derivatives: matrices should have one row and one column per parameter" );
+	for ( i=0; i<prm.size(); i++ )
+		for ( j=0; j<prm.size(); j++ )
+			(*hessian)(i,j) = 0;
+
 	for ( z=0; z<data->getNblocks(); z++ ) {
 		xz = data->getIntensity(z);
 		pz = data->getPcorrect(z);
@@ -768,7 +1010,7 @@ Matrix * BetaPsychometric::ddnegllikeli ( const std::vector<double>& prm, const
 		fz = evaluate ( xz, prm );
 		nunz = nz*nu;
 		// d2l/dnu2
-		(*I)(nupos,nupos) += digamma(nunz)*nz*nz - fz*fz*nz*nz * digamma(fz*nunz) - (1-fz)*(1-fz)*nz*nz*digamma((1-fz)*nunz);
+		(*hessian)(nupos,nupos) += digamma(nunz)*nz*nz - fz*fz*nz*nz * digamma(fz*nunz) - (1-fz)*(1-fz)*nz*nz*digamma((1-fz)*nunz);
 
 		// Now partial derivatives for chainrule
 		ddlddf   = - nunz*nunz * ( digamma( fz*nunz ) + digamma( (1-fz)*nunz) );
@@ -782,25 +1024,23 @@ Matrix * BetaPsychometric::ddnegllikeli ( const std::vector<double>& prm, const
 			dfda = dpredict ( prm, xz, i);
 			// partial derivatives (classical)
 			for ( j=i; j<nupos; j++ ) {
-				(*I)(i,j) += ddlddf * dfda * dpredict ( prm, xz, j );
-				(*I)(i,j) += dldf   * ddpredict ( prm, xz, i, j );
+				(*hessian)(i,j) += ddlddf * dfda * dpredict ( prm, xz, j );
+				(*hessian)(i,j) += dldf   * ddpredict ( prm, xz, i, j );
 			}
 			// partial derivatives w.r.t. classical and nu
-			(*I)(i,nupos) += ddldfdnu * dfda;
+			(*hessian)(i,nupos) += ddldfdnu * dfda;
 		}
 	}
 
 	// Now fill the remaining parts
 	for ( i=0; i<prm.size(); i++ ) {
 		for ( j=i; j<prm.size(); j++ ) {
-			(*I)(j,i) = (*I)(i,j);
+			(*hessian)(j,i) = (*hessian)(i,j);
 		}
 	}
 
-	I->scale(-1);
-
-	return I;
-};
+	hessian->scale(-1);
+}
 
 double BetaPsychometric::fznull ( unsigned int z, const PsiData * data, double nu ) const {
 	double x ( data->getPcorrect ( z ) );
@@ -900,32 +1140,51 @@ double OutlierModel::negllikeli ( const std::vector<double>& prm, const PsiData*
 double OutlierModel::deviance ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	unsigned int i;
-	int n;
 	double D(0);
-	double x,y,p;
+	double p;
 
 	for ( i=0; i<data->getNblocks(); i++ )
 	{
-		n = data->getNtrials(i);
-		y = data->getPcorrect(i);
-		x = data->getIntensity(i);
 		if (i==jout)
 			p = getp( prm );
 		else
-			p = evaluate( x, prm );
-		if (y>0)
-			D += n*y*log(y/p);
-		if (y<1)
-			D += n*(1-y)*log((1-y)/(1-p));
+			p = evaluate( data->getIntensity(i), prm );
+		D += binomial_deviance_term ( p, data->getNtrials(i), data->getPcorrect(i) );
 	}
 
 	if (D!=D)
 		std::cerr << p << "\n";
 
-	D *= 2;
 	return D;
 }
 
+std::vector<double> OutlierModel::logratios ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	// The block index jout refers to the full data set: The reduced data sets have to be evaluated explicitely
+	unsigned int i, j, k, nblocks ( data->getNblocks() );
+	std::vector<double> x ( nblocks-1 );
+	std::vector<int>    nc ( nblocks-1 );
+	std::vector<int>    n ( nblocks-1 );
+	std::vector<double> out ( nblocks );
+	double l ( neglpost ( prm, data ) );
+
+	for ( k=0; k<nblocks; k++ ) {
+		j = 0;
+		for ( i=0; i<nblocks; i++ ) {
+			if ( i!=k ) {
+				x[j]  = data->getIntensity(i);
+				nc[j] = data->getNcorrect(i);
+				n[j]  = data->getNtrials(i);
+				j++;
+			}
+		}
+		PsiData reduceddata ( x, n, nc, data->getNalternatives() );
+		out[k] = l - neglpost ( prm, &reduceddata );
+	}
+
+	return out;
+}
+
 double OutlierModel::neglpost ( const std::vector<double>& prm, const PsiData* data ) const
 {
 	unsigned int i;
@@ -15,6 +15,204 @@
 #include "data.h"
 #include "linalg.h"
 
+/** \brief pointer to the elements of a vector, NULL for an empty vector (where &v[0] is undefined) */
+template <class T>
+inline const T * elements_of ( const std::vector<T>& v ) { return v.empty() ? NULL : &(v[0]); }
+/** \brief pointer to the elements of a vector, NULL for an empty vector (where &v[0] is undefined) */
+template <class T>
+inline T * elements_of ( std::vector<T>& v ) { return v.empty() ? NULL : &(v[0]); }
+
+/** \brief contribution of a single block to the negative log likelihood of the binomial model
+ *
+ * All likelihood computations of the binomial model sum these terms, so that they agree to the last bit. A prediction of
+ * 0 or 1 that conflicts with the data is penalized by 1e10 instead of an infinite log.
+ */
+inline double binomial_negllikeli_term (
+		double p,                                                                ///< predicted probability of a correct response
+		int n,                                                                   ///< number of trials in the block
+		int k,                                                                   ///< number of correct responses in the block
+		double lognoverk                                                         ///< log of the binomial coefficient n over k
+		)
+{
+	double l ( -lognoverk );
+	if (p>0)
+		l -= k*log(p);
+	else
+		l += 1e10;
+	if (p<1)
+		l -= (n-k)*log(1-p);
+	else
+		l += 1e10;
+	return l;
+}
+
+/** \brief contribution of a single block to the deviance of the binomial model (the squared deviance residual) */
+inline double binomial_deviance_term (
+		double p,                                                                ///< predicted probability of a correct response
+		int n,                                                                   ///< number of trials in the block
+		double y                                                                 ///< observed fraction of correct responses in the block
+		)
+{
+	double D ( 0 );
+	if (y>0)
+		D += n*y*log(y/p);
+	if (y<1)
+		D += n*(1-y)*log((1-y)/(1-p));
+	return 2*D;
+}
+
+/** \brief core and sigmoid of a psychometric function model accessed through their virtual functions
+ *
+ * negllikeli_sweep() gets the core and the sigmoid as a "parts" object with the member functions g, dg, ddg, f, df and ddf.
+ * This one calls the virtual functions of PsiCore and PsiSigmoid. SpecializedPsychometric uses a parts object with qualified
+ * calls that can be inlined.
+ */
+struct PsiVirtualParts
+{
+	const PsiCore * core;
+	const PsiSigmoid * sigmoid;
+	PsiVirtualParts ( const PsiCore * c, const PsiSigmoid * s ) : core ( c ), sigmoid ( s ) {}
+	double g ( double x, const std::vector<double>& prm ) const { return core->g ( x, prm ); }
+	double dg ( double x, const std::vector<double>& prm, int i ) const { return core->dg ( x, prm, i ); }
+	double ddg ( double x, const std::vector<double>& prm, int i, int j ) const { return core->ddg ( x, prm, i, j ); }
+	double f ( double z ) const { return sigmoid->f ( z ); }
+	double df ( double z ) const { return sigmoid->df ( z ); }
+	double ddf ( double z ) const { return sigmoid->ddf ( z ); }
+};
+
+/** \brief negative log likelihood of the binomial model and its derivatives in a single sweep over the data
+ *
+ * This is the common implementation of PsiPsychometric::negllikeli_derivatives() and of the specialized models. Core and
+ * sigmoid are evaluated once per block. gradient, hessian and fisher may be NULL, matrices have to be nprm x nprm.
+ */
+template <class Parts>
+double negllikeli_sweep (
+		const Parts& parts,                                                      ///< core and sigmoid (see PsiVirtualParts)
+		const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
+		const PsiData* data,                                                     ///< data for which the likelihood should be evaluated
+		double guess,                                                            ///< guessing rate for these parameters
+		unsigned int nmodel,                                                     ///< number of parameters of the model (the fitted function may have more)
+		std::vector<double>* gradient,                                           ///< output: 1st derivative (or NULL)
+		Matrix* hessian,                                                         ///< output: 2nd derivative (or NULL)
+		Matrix* fisher                                                           ///< output: expected Fisher information (or NULL)
+		)
+{
+	unsigned int z, i, j, nprm ( prm.size() ), nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const int * k ( elements_of ( data->getNcorrect() ) );
+	const double * lognoverk ( elements_of ( data->getNoverK() ) );
+	double scale ( 1-guess-prm[2] );
+	double l(0), gz, fz, dfz, ddfz, pz, rz, nz, dldf, ddlddf, w, ddp;
+	double dg[2], ddg[2][2];
+	double dp[Matrix::nsmall];
+	bool derivatives ( gradient!=NULL || hessian!=NULL || fisher!=NULL );
+
+	if ( nprm>Matrix::nsmall )
+		throw BadArgumentError ( "negllikeli_derivatives: too many parameters" );
+	if ( ( hessian!=NULL && ( hessian->getnrows()!=nprm || hessian->getncols()!=nprm ) )
+			|| ( fisher!=NULL && ( fisher->getnrows()!=nprm || fisher->getncols()!=nprm ) ) )
+		throw BadArgumentError ( "negllikeli_derivatives: matrices should have one row and one column per parameter" );
+
+	if ( gradient!=NULL )
+		gradient->assign ( nprm, 0 );
+	for ( i=0; i<nprm; i++ ) {
+		dp[i] = 0;
+		for ( j=0; j<nprm; j++ ) {
+			if ( hessian!=NULL ) (*hessian)(i,j) = 0;
+			if ( fisher!=NULL )  (*fisher)(i,j) = 0;
+		}
+	}
+
+	for ( z=0; z<nblocks; z++ ) {
+		gz = parts.g ( x[z], prm );
+		fz = parts.f ( gz );
+		pz = guess + scale * fz;
+		l += binomial_negllikeli_term ( pz, n[z], k[z], lognoverk[z] );
+
+		if ( !derivatives )
+			continue;
+
+		// first derivatives of the prediction (same terms as in dpredict())
+		dfz = parts.df ( gz );
+		dg[0] = parts.dg ( x[z], prm, 0 );
+		dg[1] = parts.dg ( x[z], prm, 1 );
+		dp[0] = scale * dfz * dg[0];
+		dp[1] = scale * dfz * dg[1];
+		dp[2] = -fz;
+		if ( nprm>3 )
+			dp[3] = ( nmodel>3 ? 1-fz : 0 );
+
+		rz = k[z];
+		nz = n[z];
+
+		if ( gradient!=NULL ) {
+			dldf = rz/pz - (nz-rz)/(1-pz);
+			for ( i=0; i<nprm; i++ )
+				(*gradient)[i] -= dldf * dp[i];
+		}
+
+		if ( hessian!=NULL ) {
+			// second derivatives of the prediction (same terms as in ddpredict())
+			ddfz = parts.ddf ( gz );
+			ddg[0][0] = parts.ddg ( x[z], prm, 0, 0 );
+			ddg[0][1] = parts.ddg ( x[z], prm, 0, 1 );
+			ddg[1][1] = parts.ddg ( x[z], prm, 1, 1 );
+			dldf   = (nz-rz)/(1-pz) - rz/pz;
+			ddlddf = rz/(pz*pz) + (nz-rz)/((1-pz)*(1-pz));
+			for ( i=0; i<nprm; i++ ) {
+				for ( j=i; j<nprm; j++ ) {
+					if ( j<2 ) {
+						ddp  = ddfz * dg[i] * dg[j];
+						ddp += dfz * ddg[i][j];
+						ddp *= scale;
+					} else if ( i<2 && j<nmodel ) {
+						ddp = - dfz * dg[i];
+					} else {
+						ddp = 0;
+					}
+					(*hessian)(i,j) -= ddlddf * dp[i] * dp[j];
+					(*hessian)(i,j) -= dldf * ddp;
+				}
+			}
+		}
+
+		if ( fisher!=NULL ) {
+			w = nz * (1./pz + 1./(1-pz));
+			for ( i=0; i<nprm; i++ )
+				for ( j=i; j<nprm; j++ )
+					(*fisher)(i,j) += w * dp[i] * dp[j];
+		}
+	}
+
+	// The remaining parts of the matrices can be copied
+	for ( i=1; i<nprm; i++ )
+		for ( j=0; j<i; j++ ) {
+			if ( hessian!=NULL ) (*hessian)(i,j) = (*hessian)(j,i);
+			if ( fisher!=NULL )  (*fisher)(i,j)  = (*fisher)(j,i);
+		}
+
+	return l;
+}
+
+/** \brief evaluation of a psychometric function for one parameter vector on all blocks of a data set
+ *
+ * Sampling needs many statistics of the same parameter vector: the posterior for the acceptance step, the deviance,
+ * deviance residuals, Rpd, log posterior ratios and the probabilities for posterior predictive data. All of them depend
+ * on the data only through the predicted probabilities of the blocks. PsiPsychometric::evaluate_state() determines the
+ * predictions once and keeps the terms of each block, so that the statistics do not evaluate the model again.
+ */
+struct PsiEvaluation
+{
+	std::vector<double> prm;            ///< parameters of the psychometric function model
+	std::vector<double> p;              ///< predicted probability of a correct response for each block
+	std::vector<double> logratios;      ///< log posterior ratios for leaving out each block (see PsiPsychometric::logratios(), for the binomial model the terms of the negative log likelihood)
+	std::vector<double> devianceterms;  ///< contribution of each block to the deviance of the binomial model (squared deviance residuals)
+	double negllikeli;                  ///< negative log likelihood
+	double neglpost;                    ///< negative log posterior
+	double deviance;                    ///< deviance
+};
+
 /** \brief Standard psychometric function model
  *
  * Standard model for the psychometric function that assumes that the number of correct responses is a
@@ -49,13 +247,18 @@ class PsiPsychometric {
 			PsiSigmoid * sigmoid,                                                   ///< "external" saturating part of the nonlinear function
 			unsigned int nparameters                                                ///< number of parameters given explicitely
 			);                  ///< Set up a psychometric function model for an nAFC task, explicitely specifiing the number of parameters (useful for derived classes)
+		void score_state_unbatched ( const PsiData* data, PsiEvaluation* state ) const;   ///< score_state() by calls to negllikeli(), neglpost(), deviance() and logratios() (for derived models that override these)
+		typedef double (PsiPsychometric::*Statistic) ( const std::vector<double>&, const PsiData* ) const;                   ///< a statistic of one parameter vector such as negllikeli() or deviance()
+		typedef std::vector<double> (PsiPsychometric::*VectorStatistic) ( const std::vector<double>&, const PsiData* ) const;   ///< a vector statistic of one parameter vector such as dnegllikeli() or dneglpost()
+		std::vector<double> batch_by_calls ( Statistic f, const std::vector< std::vector<double> >& prm, const PsiData* data ) const;   ///< f for M parameter vectors by M virtual calls (the *_batch() methods of derived models without a fused kernel)
+		std::vector< std::vector<double> > batch_by_calls ( VectorStatistic f, const std::vector< std::vector<double> >& prm, const PsiData* data ) const;   ///< f for M parameter vectors by M virtual calls
 	public:
 		PsiPsychometric (
 			int nAFC,                                                                ///< number of alternatives in the task (1 indicating yes/no)
 			PsiCore * core,                                                          ///< internal part of the nonlinear function (in many cases this is actually a linear function)
 			PsiSigmoid * sigmoid                                                     ///< "external" saturating part of the nonlinear function
 			);    ///< Set up a psychometric function model for an nAFC task (nAFC=1 ~> yes/no)
-		~PsiPsychometric ( void );   ///< destructor (also deletes the core and sigmoid objects)
+		virtual ~PsiPsychometric ( void );   ///< destructor (also deletes the core and sigmoid objects)
 		virtual double evaluate (
 			double x,                                                                ///< stimulus intensity
 			const std::vector<double>& prm                                           ///< parameters of the psychometric function model
@@ -68,6 +271,16 @@ class PsiPsychometric {
 			const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
 			const PsiData* data                                                      ///< data for which the posterior should be evaluated
 			) const;     ///< negative log posterior  (unnormalized)
+		/** \brief log posterior ratios for leaving out single blocks
+		 *
+		 * The k-th element of the result is neglpost(prm,data) minus neglpost for the same data without block k. For models with
+		 * priors that do not depend on the data, this is the contribution of block k to the negative log likelihood, so that all
+		 * ratios are obtained in a single pass over the data.
+		 */
+		virtual std::vector<double> logratios (
+			const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
+			const PsiData* data                                                      ///< full data set
+			) const;
 		virtual double leastfavourable (
 			const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
 			const PsiData* data,                                                     ///< data for which the likelihood should be evaluated
@@ -86,6 +299,54 @@ class PsiPsychometric {
 				const std::vector<double>& prm,                                      ///< parameters at which the first derivative should be evaluated
 				const PsiData* data                                                  ///< data for which the likelihood should be evaluated
 				) const;                                          ///< 1st derivative of the negative log likelihood
+		/** \brief negative log likelihood and its derivatives in a single sweep over the data
+		 *
+		 * For every block, the core, the sigmoid and their derivatives are evaluated exactly once and all requested quantities
+		 * are accumulated from these values. Any of gradient, hessian and fisher may be NULL if the respective quantity is not
+		 * needed. The gradient is the same as the result of dnegllikeli(), hessian is the same matrix as the result of
+		 * ddnegllikeli() and fisher is the expected Fisher information. The matrices should have prm.size() rows and columns.
+		 *
+		 * \return the negative log likelihood
+		 */
+		virtual double negllikeli_derivatives (
+				const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
+				const PsiData* data,                                                 ///< data for which the likelihood should be evaluated
+				std::vector<double>* gradient,                                       ///< output: 1st derivative of the negative log likelihood (or NULL)
+				Matrix* hessian,                                                     ///< output: 2nd derivative as returned by ddnegllikeli() (or NULL)
+				Matrix* fisher=NULL                                                  ///< output: expected Fisher information (or NULL)
+				) const;
+		/** \brief negative log likelihoods for M parameter vectors at once
+		 *
+		 * The data are read from the arrays held by PsiData. For each parameter vector, the core and the sigmoid are evaluated for all
+		 * blocks by one call to PsiCore::g_batch and PsiSigmoid::f_batch, and the inner loops run over contiguous arrays. Only cores
+		 * and sigmoids that override the default batch loops (such as PsiLogistic) avoid a virtual call per block; SpecializedPsychometric
+		 * avoids them for all combinations. The results are the same as those of M calls to negllikeli().
+		 */
+		virtual std::vector<double> negllikeli_batch (
+				const std::vector< std::vector<double> >& prm,                       ///< M parameter vectors
+				const PsiData* data                                                  ///< data for which the likelihood should be evaluated
+				) const;
+		virtual std::vector<double> neglpost_batch (
+				const std::vector< std::vector<double> >& prm,                       ///< M parameter vectors
+				const PsiData* data                                                  ///< data for which the posterior should be evaluated
+				) const;                                          ///< negative log posteriors for M parameter vectors at once (see negllikeli_batch())
+		virtual std::vector<double> deviance_batch (
+				const std::vector< std::vector<double> >& prm,                       ///< M parameter vectors
+				const PsiData* data                                                  ///< data for which the deviance should be evaluated
+				) const;                                          ///< deviances for M parameter vectors at once (see negllikeli_batch())
+		virtual std::vector< std::vector<double> > dnegllikeli_batch (
+				const std::vector< std::vector<double> >& prm,                       ///< M parameter vectors
+				const PsiData* data                                                  ///< data for which the likelihood should be evaluated
+				) const;                                          ///< 1st derivatives of the negative log likelihood for M parameter vectors at once (see negllikeli_batch())
+		void evaluate_state (
+				const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
+				const PsiData* data,                                                 ///< data for which the model should be evaluated
+				PsiEvaluation* state                                                 ///< output: predictions and statistics of prm
+				) const;                                          ///< predict all blocks once and score the predictions with score_state()
+		virtual void score_state (
+				const PsiData* data,                                                 ///< data on which the predictions are scored (same intensities as for the predictions)
+				PsiEvaluation* state                                                 ///< predictions (state->prm and state->p) on input, all statistics on output
+				) const;                                          ///< likelihood, posterior, deviance and their terms per block for given predictions (the results equal those of negllikeli(), neglpost(), deviance() and logratios())
 		const PsiCore* getCore ( void ) const { return Core; }                ///< get the core of the psychometric function
 		const PsiSigmoid* getSigmoid ( void ) const { return Sigmoid; }       ///< get the sigmoid of the psychometric function
 		virtual void setPrior ( unsigned int index, PsiPrior* prior ) throw(BadArgumentError);                   ///< set a Prior for the parameter indicated by index
@@ -95,6 +356,7 @@ class PsiPsychometric {
 		int getNalternatives ( void ) const { return Nalternatives; }         ///< get the number of alternatives (1 means yes/no)
 		virtual unsigned int getNparams ( void ) const { return (Nalternatives==1 ? (gammaislambda ? 3 : 4 ) : 3 ); } ///< get the number of free parameters of the psychometric function
 		virtual std::vector<double> getStart ( const PsiData* data ) const ;                ///< determine a starting value using logistic regression on a dataset
+		std::vector<double> getFingerprint ( const PsiData* data ) const;          ///< numbers that identify core, sigmoid and priors of the model (starting values for data, predictions and prior densities there)
 		double getThres (
 			const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
 			double cut                                                               ///< performance level at which the threshold should be evaluated
@@ -112,6 +374,14 @@ class PsiPsychometric {
 			const std::vector<double>& prm,                                          ///< parameters of the psychometric function model
 			const PsiData* data                                                      ///< data set corresponding to the deviance residuals
 			) const;          ///< correlation between deviance residuals and predictions
+		std::vector<double> getDevianceResiduals (
+			const PsiEvaluation& state,                                              ///< state as determined by evaluate_state() for data
+			const PsiData* data                                                      ///< data on which state was scored
+			) const;  ///< deviance residuals from the terms of state
+		double getRpd (
+			const std::vector<double>& devianceresiduals,                            ///< deviance residuals as determined by getDevianceResiduals
+			const PsiEvaluation& state                                               ///< state that holds the predictions
+			) const;          ///< correlation between deviance residuals and the predictions of state
 		double getRkd ( const std::vector<double>& devianceresiduals, const PsiData* data ) const;        ///< correlation between deviance residuals and block sequence
 		double dllikeli (
 			std::vector<double> prm,                                                     ///< parameters of the model
@@ -123,6 +393,18 @@ class PsiPsychometric {
 			const PsiData* data,                                                         ///< data for which the likelihood should be valuated
 			unsigned int i                                                               ///< index of the parameter for which the derivative should be evaluated
 			) const;                                                                 ///< derivative of the negative log posterior with respect to parameter i
+		virtual std::vector<double> dlposteri (
+			const std::vector<double>& prm,                                              ///< parameters of the psychometric function model
+			const PsiData* data                                                          ///< data for which the likelihood should be evaluated
+			) const;                                                                 ///< derivatives of dlposteri() with respect to all parameters at once
+		virtual std::vector<double> dneglpost (
+			const std::vector<double>& prm,                                              ///< parameters of the psychometric function model
+			const PsiData* data                                                          ///< data for which the posterior should be evaluated
+			) const;                                                                 ///< gradient of the negative log posterior (see neglpost())
+		virtual std::vector< std::vector<double> > dneglpost_batch (
+			const std::vector< std::vector<double> >& prm,                               ///< M parameter vectors
+			const PsiData* data                                                          ///< data for which the posterior should be evaluated
+			) const;                                                                 ///< gradients of the negative log posterior for M parameter vectors at once (see negllikeli_batch())
 		void setgammatolambda ( void ) { gammaislambda=true; };                          ///< calling this function applies the constraint that gamma and lambda should be equal in a yes/no paradigm
 		double getGuess ( const std::vector<double>& prm ) const { return (gammaislambda ? prm[2] : ( getNalternatives() < 2 ? prm[3] : 1./Nalternatives )); }
 		double dpredict ( const std::vector<double>& prm, double x, unsigned int i ) const;    ///< partial derivative of psychometric function prediction w.r.t. i-th parameter
@@ -140,28 +422,43 @@ class PsiPsychometric {
  * the priors.
  *
  * Second, evaluating the neglpost method takes a bit longer -- Jeffrey's prior is realtively costly to evaluate.
+ *
+ * Jeffrey's prior couples all parameters, so its derivatives are only available as a whole gradient (dneglpost() or
+ * dlposteri(prm,data)). There is no derivative with respect to a single parameter.
  */
 class PMF_with_JeffreysPrior : public PsiPsychometric
 {
-	private:
-		Matrix fisher;
 	public:
 		PMF_with_JeffreysPrior (
 			int nAFC,                                                                ///< number of alternatives in the task (1 indicating yes/no)
 			PsiCore * core,                                                          ///< internal part of the nonlinear function (in many cases this is actually a linear function)
 			PsiSigmoid * sigmoid                                                     ///< "external" saturating part of the nonlinear function
-			) : PsiPsychometric ( nAFC, core, sigmoid ), fisher(getNparams(), getNparams()) { }    ///< Set up a psychometric function model for an nAFC task (nAFC=1 ~> yes/no)
+			) : PsiPsychometric ( nAFC, core, sigmoid ) { }    ///< Set up a psychometric function model for an nAFC task (nAFC=1 ~> yes/no)
 		~PMF_with_JeffreysPrior () { }
 
 		double neglpost ( const std::vector<double>& prm,
 				const PsiData* data
 				) const;
-		double dlposteri (
-			std::vector<double> prm,                                                     ///< parameters of the psychometric function model
-			const PsiData* data,                                                         ///< data for which the likelihood should be valuated
-			unsigned int i                                                               ///< index of the parameter for which the derivative should be evaluated
-			) const;                                                                 ///< derivative of the negative log posterior with respect to parameter i
+		std::vector<double> neglpost_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::neglpost, prm, data ); }  ///< negative log posteriors for M parameter vectors
+		std::vector<double> logratios (
+			const std::vector<double>& prm,                                              ///< parameters of the psychometric function model
+			const PsiData* data                                                          ///< full data set
+			) const;                                                                 ///< log posterior ratios for leaving out single blocks (including the change of the prior)
+		std::vector<double> dlposteri ( const std::vector<double>& prm, const PsiData* data ) const { return dneglpost ( prm, data ); }  ///< derivatives of the negative log posterior with respect to all parameters at once
+		/** \brief gradient of the negative log posterior
+		 *
+		 * The gradient of the log determinant of the expected Fisher information I is given by tr ( I^{-1} dI/dtheta_i ). The
+		 * derivatives of I are obtained from dpredict() and ddpredict(), so that the complete gradient requires two sweeps over the data.
+		 */
+		std::vector<double> dneglpost (
+			const std::vector<double>& prm,                                              ///< parameters of the psychometric function model
+			const PsiData* data                                                          ///< data for which the posterior should be evaluated
+			) const;
+		std::vector< std::vector<double> > dneglpost_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::dneglpost, prm, data ); }  ///< gradients of the negative log posterior for M parameter vectors
 		void setPrior ( unsigned int index, PsiPrior* prior ) throw(BadArgumentError) { throw BadArgumentError ( "With Jeffrey's prior, you can't set independent priors for individual parameters" ); }                   ///< set a Prior for the parameter indicated by index
+		void score_state ( const PsiData* data, PsiEvaluation* state ) const { score_state_unbatched ( data, state ); }   ///< statistics of the predictions in state
 };
 
 
@@ -176,12 +473,17 @@ class BetaPsychometric : public PsiPsychometric {
 	private:
 		double fznull ( unsigned int z, const PsiData* data, double nu ) const;
 		double negllikelinull ( const PsiData* data, double nu ) const;
+		void fill_hessian ( const std::vector<double>& prm, const PsiData* data, Matrix* hessian ) const;  // 2nd derivative of the negative log likelihood into hessian
 	public:
 		BetaPsychometric ( int nAFC, PsiCore * core, PsiSigmoid * sigmoid ) : PsiPsychometric ( nAFC, core, sigmoid, ( nAFC<2 ? 5 : 4 ) ) {}
 		double negllikeli (
 			const std::vector<double>& prm,           ///< parameters of the psychometric function model
 			const PsiData* data                       ///< data for which the likelihood should be evaluated
 			) const; ///< negative log likelihood
+		std::vector<double> logratios (
+			const std::vector<double>& prm,           ///< parameters of the psychometric function model
+			const PsiData* data                       ///< full data set
+			) const; ///< log posterior ratios for leaving out single blocks
 		std::vector<double> dnegllikeli (
 				const std::vector<double>& prm,       ///< parameters at which the first derivative should be evaluated
 				const PsiData* data                   ///< data for which the likelihood should be evaluated
@@ -190,11 +492,25 @@ class BetaPsychometric : public PsiPsychometric {
 				const std::vector<double>& prm,       ///< parameters at which the second derivative should be evaluated
 				const PsiData* data                   ///< data for which the likelihood should be evaluated
 				) const;                 ///< 2nd derivative of the negative log likelihood (newly allocated matrix)
+		double negllikeli_derivatives (
+				const std::vector<double>& prm,       ///< parameters of the psychometric function model
+				const PsiData* data,                  ///< data for which the likelihood should be evaluated
+				std::vector<double>* gradient,        ///< output: 1st derivative of the negative log likelihood (or NULL)
+				Matrix* hessian,                      ///< output: 2nd derivative as returned by ddnegllikeli() (or NULL)
+				Matrix* fisher=NULL                   ///< expected Fisher information is not available for this model and should be NULL
+				) const;                 ///< negative log likelihood and its derivatives (combines negllikeli(), dnegllikeli() and ddnegllikeli())
 		unsigned int getNparams ( void ) const { return PsiPsychometric::getNparams()+1; }   ///< get the number of free parameters of the psychometric function
 		double deviance (
 			const std::vector<double>& prm,                      ///< parameters of the psychometric function model
 			const PsiData * data                                 ///< data for which the likelihood should be evaluated
 			) const; ///< deviance for a given data set and parameter constellation
+		std::vector<double> negllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::negllikeli, prm, data ); }  ///< negative log likelihoods for M parameter vectors
+		std::vector<double> deviance_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::deviance, prm, data ); }    ///< deviances for M parameter vectors
+		std::vector< std::vector<double> > dnegllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::dnegllikeli, prm, data ); }  ///< derivatives of the negative log likelihood for M parameter vectors
+		void score_state ( const PsiData* data, PsiEvaluation* state ) const { score_state_unbatched ( data, state ); }   ///< statistics of the predictions in state
 
 		std::vector<double> getStart ( const PsiData* data ) const { std::vector<double> out (PsiPsychometric::getStart ( data )); out[out.size()-1] = .99999; return out;}
 };
@@ -230,14 +546,32 @@ class OutlierModel : public PsiPsychometric {
 			const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
 			const PsiData * data                                                 ///< data for which the likelihood should be evaluated
 			) const;                         ///< negative log likelihood
+		double negllikeli_derivatives (
+			const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
+			const PsiData* data,                                                 ///< data for which the likelihood should be evaluated
+			std::vector<double>* gradient,                                       ///< output: 1st derivative with respect to the fitted function (or NULL)
+			Matrix* hessian,                                                     ///< output: 2nd derivative with respect to the fitted function (or NULL)
+			Matrix* fisher=NULL                                                  ///< output: expected Fisher information of the fitted function (or NULL)
+			) const { PsiPsychometric::negllikeli_derivatives ( prm, data, gradient, hessian, fisher ); return negllikeli ( prm, data ); } ///< negative log likelihood and derivatives with respect to the fitted function
 		double neglpost (
 			const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
 			const PsiData * data                                                 ///< data for which the likelihood should be evaluated
 			) const;                         ///< negative log likelihood
+		std::vector<double> logratios (
+			const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
+			const PsiData * data                                                 ///< full data set
+			) const;                         ///< log posterior ratios for leaving out single blocks (evaluates the reduced data sets)
 		double deviance (
 			const std::vector<double>& prm,                                      ///< parameters of the psychometric function model
 			const PsiData* data                                                  ///< data for which the deviance should be evaluated
 			) const;                        ///< deviance
+		std::vector<double> negllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::negllikeli, prm, data ); }  ///< negative log likelihoods for M parameter vectors
+		std::vector<double> neglpost_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::neglpost, prm, data ); }    ///< negative log posteriors for M parameter vectors
+		std::vector<double> deviance_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+			{ return batch_by_calls ( &PsiPsychometric::deviance, prm, data ); }    ///< deviances for M parameter vectors
+		void score_state ( const PsiData* data, PsiEvaluation* state ) const { score_state_unbatched ( data, state ); }   ///< statistics of the predictions in state
 		unsigned int getNparams ( void ) const { return PsiPsychometric::getNparams()+1; }
 		double randPrior ( unsigned int index ) const { return ( index<PsiPsychometric::getNparams() ? PsiPsychometric::randPrior(index) : PsiRandom().rngcall() ); }                            ///< sample form a prior
 };
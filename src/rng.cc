@@ -3,6 +3,8 @@
  *   the copyright and license terms
  */
 #include "rng.h"
+#include <vector>
+#include <pthread.h>
 
 /****** BEGINNING OF MERSENNE TWISTER *****/
 
@@ -49,20 +51,15 @@
    email: m-mat @ math.sci.hiroshima-u.ac.jp (remove space)
 */
 
-#include <stdio.h>
-
 /* Period parameters */
-#define N 624
+#define N PSI_MT_N
 #define M 397
 #define MATRIX_A 0x9908b0dfUL   /* constant vector a */
 #define UPPER_MASK 0x80000000UL /* most significant w-r bits */
 #define LOWER_MASK 0x7fffffffUL /* least significant r bits */
 
-static unsigned long mt[N]; /* the array for the state vector  */
-static int mti=N+1; /* mti==N+1 means mt[N] is not initialized */
-
 /* initializes mt[N] with a seed */
-void init_genrand(unsigned long s)
+void PsiRandomStream::init_genrand(unsigned long s)
 {
     mt[0]= s & 0xffffffffUL;
     for (mti=1; mti<N; mti++) {
@@ -81,7 +78,7 @@ void init_genrand(unsigned long s)
 /* init_key is the array for initializing keys */
 /* key_length is its length */
 /* slight change for C++, 2004/2/26 */
-void init_by_array(unsigned long init_key[], int key_length)
+void PsiRandomStream::init_by_array(unsigned long init_key[], int key_length)
 {
     int i, j, k;
     init_genrand(19650218UL);
@@ -107,10 +104,10 @@ void init_by_array(unsigned long init_key[], int key_length)
 }
 
 /* generates a random number on [0,0xffffffff]-interval */
-unsigned long genrand_int32(void)
+unsigned long PsiRandomStream::genrand_int32(void)
 {
     unsigned long y;
-    static unsigned long mag01[2]={0x0UL, MATRIX_A};
+    static const unsigned long mag01[2]={0x0UL, MATRIX_A};
     /* mag01[x] = x * MATRIX_A  for x=0,1 */
 
     if (mti >= N) { /* generate N words at one time */
@@ -144,65 +141,231 @@ unsigned long genrand_int32(void)
     return y;
 }
 
-/* generates a random number on [0,0x7fffffff]-interval */
-long genrand_int31(void)
+/****** END OF MERSENNE TWISTER *****/
+
+void PsiRandomStream::seed ( unsigned long seedval, unsigned long streamid )
 {
-    return (long)(genrand_int32()>>1);
+	// Different keys give unrelated initial states; the constants keep the keys distinct from
+	// the key that is used by setSeed()
+	unsigned long long sd ( seedval ), st ( streamid );
+	unsigned long init[4]={
+		(unsigned long) (sd & 0xffffffffUL),
+		(unsigned long) (st & 0xffffffffUL),
+		(unsigned long) (0x9e3779b9UL ^ (sd>>32)),
+		(unsigned long) (0x7f4a7c15UL ^ (st>>32)) };
+	init_by_array ( init, 4 );
 }
 
-/* generates a random number on [0,1]-real-interval */
-double genrand_real1(void)
+void PsiRandomStream::saveState ( PsiCheckpointWriter * checkpoint ) const
 {
-    return genrand_int32()*(1.0/4294967295.0); 
-    /* divided by 2^32-1 */ 
+	int i;
+	for ( i=0; i<N; i++ )
+		checkpoint->putInteger ( mt[i] );
+	checkpoint->putInteger ( mti );
 }
 
-/* generates a random number on [0,1)-real-interval */
-double genrand_real2(void)
+void PsiRandomStream::loadState ( PsiCheckpointReader * checkpoint )
 {
-    return genrand_int32()*(1.0/4294967296.0); 
-    /* divided by 2^32 */
+	int i;
+	unsigned long index;
+	for ( i=0; i<N; i++ )
+		mt[i] = checkpoint->getInteger () & 0xffffffffUL;
+	index = checkpoint->getInteger ();
+	if ( index>N+1UL )
+		throw PsiError ( "PsiRandomStream::loadState: invalid state in checkpoint" );
+	mti = index;
 }
 
-/* generates a random number on (0,1)-real-interval */
-double genrand_real3(void)
+/****** JUMP AHEAD *****/
+
+/*
+   Jumping ahead follows
+
+   Haramoto, Matsumoto, Nishimura, Panneton, L'Ecuyer (2008). Efficient jump ahead for F_2-linear random
+   number generators. INFORMS Journal on Computing, 20(3), 385-390.
+
+   If T is the (linear) transition of the generator and phi its characteristic polynomial, T^n = g(T) with
+   g(x) = x^n mod phi. g(T)s is evaluated by Horner's scheme, which needs deg(phi)=19937 transitions and
+   additions of states. phi is found once by the Berlekamp-Massey algorithm from a sequence of output bits.
+*/
+
+#define MEXP 19937
+#define PW ((2*MEXP+63)/64+1)        /* words in a polynomial of degree < 2*MEXP */
+
+typedef std::vector<unsigned long long> gf2poly;
+
+static gf2poly charpoly;                     // characteristic polynomial of MT19937
+static std::vector<gf2poly> jumppolys;       // jumppolys[k] = x^(2^k) mod charpoly
+static pthread_mutex_t jumplock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline int getbit ( const gf2poly& a, unsigned int i ) { return (a[i>>6]>>(i&63))&1; }
+static inline void flipbit ( gf2poly& a, unsigned int i ) { a[i>>6] ^= 1ULL<<(i&63); }
+
+static int degree ( const gf2poly& a )
 {
-    return (((double)genrand_int32()) + 0.5)*(1.0/4294967296.0); 
-    /* divided by 2^32 */
+	int w,b;
+	for ( w=a.size()-1; w>=0; w-- )
+		if ( a[w] )
+			for ( b=63; b>=0; b-- )
+				if ( (a[w]>>b)&1 ) return 64*w+b;
+	return -1;
 }
 
-/* generates a random number on [0,1) with 53-bit resolution*/
-double genrand_res53(void) 
-{ 
-    unsigned long a=genrand_int32()>>5, b=genrand_int32()>>6; 
-    return(a*67108864.0+b)*(1.0/9007199254740992.0); 
-} 
-/* These real versions are due to Isaku Wada, 2002/01/09 added */
+/* a += b * x^shift */
+static void addshifted ( gf2poly& a, const gf2poly& b, unsigned int shift, unsigned int nwords )
+{
+	unsigned int w, ws ( shift>>6 ), bs ( shift&63 );
+	for ( w=0; w<nwords && w+ws<a.size(); w++ ) {
+		a[w+ws] ^= b[w]<<bs;
+		if ( bs && w+ws+1<a.size() ) a[w+ws+1] ^= b[w]>>(64-bs);
+	}
+}
 
-/****** END OF MERSENNE TWISTER *****/
+/* Berlekamp-Massey on the least significant output bits of an arbitrary stream */
+static void find_charpoly ( void )
+{
+	unsigned int len ( 2*MEXP+64 ), n, i, w, off, q, r;
+	int L(0), m(1), d;
+	unsigned long long x;
+	PsiRandomStream stream;
+	gf2poly rev ( len/64+2, 0 ), C ( PW, 0 ), B ( PW, 0 ), T;
+
+	// rev holds the sequence in reverse order such that s[n-i] for i=0..L is a contiguous bit range
+	for ( n=0; n<len; n++ )
+		if ( stream.genrand_int32()&1 ) flipbit ( rev, len-1-n );
+
+	C[0] = B[0] = 1;
+	for ( n=0; n<len; n++ ) {
+		// discrepancy: sum_{i=0}^{L} c_i s[n-i] with rev[len-1-n+i] = s[n-i]
+		off = len-1-n;
+		x = 0;
+		for ( w=0; 64*w<=(unsigned int)L; w++ ) {
+			q = (off>>6)+w; r = off&63;
+			x ^= C[w] & ( (rev[q]>>r) | ( r ? rev[q+1]<<(64-r) : 0 ) );
+		}
+		d = __builtin_parityll ( x );
+		if ( d==0 ) {
+			m++;
+		} else if ( 2*L<=(int)n ) {
+			T = C;
+			addshifted ( C, B, m, (MEXP+64)/64+1 );
+			L = n+1-L;
+			B = T;
+			m = 1;
+		} else {
+			addshifted ( C, B, m, (MEXP+64)/64+1 );
+			m++;
+		}
+	}
 
-/*
-int main(void)
+	// C(x) is the connection polynomial: the characteristic polynomial is its reciprocal
+	charpoly.assign ( PW, 0 );
+	for ( i=0; i<=(unsigned int)L; i++ )
+		if ( getbit ( C, i ) ) flipbit ( charpoly, L-i );
+	if ( L!=MEXP )
+		throw PsiError ( "find_charpoly: unexpected degree of characteristic polynomial" );
+}
+
+/* a = a*a mod charpoly */
+static void sqrmod ( gf2poly& a )
 {
-    int i;
-    unsigned long init[4]={0x123, 0x234, 0x345, 0x456}, length=4;
-    init_by_array(init, length);
-    printf("1000 outputs of genrand_int32()\n");
-    for (i=0; i<1000; i++) {
-      printf("%10lu ", genrand_int32());
-      if (i%5==4) printf("\n");
-    }
-    printf("\n1000 outputs of genrand_real2()\n");
-    for (i=0; i<1000; i++) {
-      printf("%10.8f ", genrand_real2());
-      if (i%5==4) printf("\n");
-    }
-    return 0;
+	static std::vector<gf2poly> shifted;          // charpoly*x^b for b=0..63, filled on first call (under jumplock)
+	gf2poly sq ( PW, 0 );
+	unsigned long long x, y;
+	int i, w, b, nw ( MEXP/64+2 );
+
+	if ( shifted.size()==0 ) {
+		shifted.assign ( 64, gf2poly ( nw, 0 ) );
+		for ( b=0; b<64; b++ )
+			addshifted ( shifted[b], charpoly, b, MEXP/64+1 );
+	}
+
+	// squaring in GF(2)[x] spreads the bits: bit i goes to bit 2i
+	for ( w=0; w<=MEXP/64; w++ ) {
+		for ( x=a[w], i=0, y=0; i<32; i++ ) y |= ((x>>i)&1ULL)<<(2*i);
+		sq[2*w] = y;
+		for ( x=a[w]>>32, i=0, y=0; i<32; i++ ) y |= ((x>>i)&1ULL)<<(2*i);
+		sq[2*w+1] = y;
+	}
+
+	// reduction from the top
+	for ( i=2*MEXP-2; i>=MEXP; i-- ) {
+		if ( sq[i>>6]==0 ) { i &= ~63; continue; }
+		if ( getbit ( sq, i ) ) {
+			b = (i-MEXP)&63;
+			x = (i-MEXP)>>6;
+			for ( w=0; w<nw && w+(int)x<PW; w++ ) sq[w+x] ^= shifted[b][w];
+		}
+	}
+	sq.resize ( MEXP/64+1 );
+	sq.resize ( PW, 0 );
+	a = sq;
 }
-*/
 
-double PsiRandom::rngcall ( void ) {
-	return genrand_real2();
+/* get x^(2^k) mod charpoly (computed on first request) */
+static const gf2poly& getjumppoly ( unsigned int k )
+{
+	pthread_mutex_lock ( &jumplock );
+	if ( charpoly.size()==0 ) {
+		try {
+			find_charpoly ();
+		} catch ( ... ) {
+			pthread_mutex_unlock ( &jumplock );
+			throw;
+		}
+		jumppolys.push_back ( gf2poly ( PW, 0 ) );
+		flipbit ( jumppolys[0], 1 );
+	}
+	while ( jumppolys.size()<=k ) {
+		jumppolys.push_back ( jumppolys.back() );
+		sqrmod ( jumppolys.back() );
+	}
+	const gf2poly& out ( jumppolys[k] );    // elements are never modified once they are in the list
+	pthread_mutex_unlock ( &jumplock );
+	return out;
+}
+
+void PsiRandomStream::jump ( unsigned int k )
+{
+	static const unsigned long mag01[2]={0x0UL, MATRIX_A};
+	unsigned long long i, n;
+	unsigned long acc[N], y;
+	int p(0), j, deg;
+
+	if ( mti == N+1 )
+		init_genrand ( 5489UL );
+
+	if ( k<16 ) {
+		// cheaper to just draw the numbers
+		for ( n=0, i=1ULL<<k; n<i; n++ ) genrand_int32 ();
+		return;
+	}
+
+	// The current block mt[0..N-1] is a window of N consecutive words of the sequence; T generates the next word
+	// after the window and shifts the window by one. Horner: acc = sum_j g_j T^j mt
+	const gf2poly& g ( getjumppoly ( k ) );
+	deg = degree ( g );
+	for ( j=0; j<N; j++ ) acc[j] = 0;
+	for ( ; deg>=0; deg-- ) {
+		// acc = T acc; p is the position of the oldest word in the window
+		y = (acc[p]&UPPER_MASK)|(acc[(p+1)%N]&LOWER_MASK);
+		acc[p] = acc[(p+M)%N] ^ (y >> 1) ^ mag01[y & 0x1UL];
+		p = (p+1)%N;
+		// acc += g_deg * mt
+		if ( getbit ( g, deg ) )
+			for ( j=0; j<N; j++ ) acc[(p+j)%N] ^= mt[j];
+	}
+
+	// The result is the block 2^k words later. Keeping mti, the next output is also 2^k words later. Only the lower
+	// bits of the oldest word are not determined by the characteristic polynomial, but mti>0 and the oldest word
+	// only enters the next block with its most significant bit.
+	for ( j=0; j<N; j++ ) mt[j] = acc[(p+j)%N];
+}
+
+static PsiRandomStream defaultstream;
+
+PsiRandomStream * getDefaultStream ( void ) {
+	return &defaultstream;
 }
 
 double GaussRandom::draw ( void )
@@ -224,13 +387,161 @@ double GaussRandom::draw ( void )
 	}
 }
 
+void GaussRandom::saveState ( PsiCheckpointWriter * checkpoint ) const
+{
+	checkpoint->putInteger ( good );
+	checkpoint->putDouble ( good ? y : 0 );
+}
+
+void GaussRandom::loadState ( PsiCheckpointReader * checkpoint )
+{
+	good = checkpoint->getInteger ()!=0;
+	y = checkpoint->getDouble ();
+}
+
 double BinomialRandom::draw ( void )
 {
-	int k(0),i;
-	for (i=0; i<n; i++)
-		if ( rngcall() < p )
-			k++;
-	return k;
+	/* implementation from numpy: numpy/random/mtrand/distributions.c */
+	if ( n<=0 || p<=0 ) return 0;
+	if ( p>=1 ) return n;
+
+	if ( p<=0.5 ) {
+		if ( p*n<=30.0 )
+			return draw_inversion ( n, p );
+		else
+			return draw_btpe ( n, p );
+	} else {
+		if ( (1-p)*n<=30.0 )
+			return n - draw_inversion ( n, 1-p );
+		else
+			return n - draw_btpe ( n, 1-p );
+	}
+}
+
+int BinomialRandom::draw_inversion ( int n, double p )
+{
+	double q, qn, np, px, U;
+	int X, bound;
+
+	q = 1.0 - p;
+	qn = exp ( n*log(q) );
+	np = n*p;
+	bound = int ( np + 10.0*sqrt(np*q + 1) );
+	if ( bound>n ) bound = n;
+
+	X = 0;
+	px = qn;
+	U = rngcall();
+	while ( U > px ) {
+		X++;
+		if ( X > bound ) {
+			X = 0;
+			px = qn;
+			U = rngcall();
+		} else {
+			U -= px;
+			px  = ((n-X+1) * p * px)/(X*q);
+		}
+	}
+	return X;
+}
+
+int BinomialRandom::draw_btpe ( int n, double p )
+{
+	/* Kachitvichyanukul, Schmeiser (1988). Binomial random variate generation. Communications of the ACM, 31(2), 216-222. */
+	double r,q,fm,p1,xm,xl,xr,c,laml,lamr,p2,p3,p4;
+	double a,u,v,s,F,rho,t,A,nrq,x1,x2,f1,f2,z,z2,w,w2,x;
+	int m,y,k,i;
+
+	// Setup
+	r = p;
+	q = 1.0 - r;
+	fm = n*r + r;
+	m = int ( floor ( fm ) );
+	p1 = floor ( 2.195*sqrt(n*r*q) - 4.6*q ) + 0.5;
+	xm = m + 0.5;
+	xl = xm - p1;
+	xr = xm + p1;
+	c = 0.134 + 20.5/(15.3 + m);
+	a = (fm - xl)/(fm - xl*r);
+	laml = a*(1.0 + a/2.0);
+	a = (xr - fm)/(xr*q);
+	lamr = a*(1.0 + a/2.0);
+	p2 = p1*(1.0 + 2.0*c);
+	p3 = p2 + c/laml;
+	p4 = p3 + c/lamr;
+	nrq = n*r*q;
+
+	for (;;) {
+		u = rngcall()*p4;
+		v = rngcall();
+		if ( u<=p1 ) {
+			// triangular region: accept immediately
+			y = int ( floor ( xm - p1*v + u ) );
+			break;
+		} else if ( u<=p2 ) {
+			// parallelograms
+			x = xl + (u - p1)/c;
+			v = v*c + 1.0 - fabs(m - x + 0.5)/p1;
+			if ( v>1.0 ) continue;
+			y = int ( floor ( x ) );
+		} else if ( u<=p3 ) {
+			// left exponential tail
+			if ( v==0.0 ) continue;   // log(0) would not give a finite y
+			y = int ( floor ( xl + log(v)/laml ) );
+			if ( y<0 ) continue;
+			v = v*(u-p2)*laml;
+		} else {
+			// right exponential tail
+			if ( v==0.0 ) continue;   // log(0) would not give a finite y
+			y = int ( floor ( xr - log(v)/lamr ) );
+			if ( y>n ) continue;
+			v = v*(u-p3)*lamr;
+		}
+
+		k = abs ( y - m );
+		if ( k<=20 || k>=nrq/2.0-1 ) {
+			// explicit evaluation of f(y)/f(m)
+			s = r/q;
+			a = s*(n+1);
+			F = 1.0;
+			if ( m<y ) {
+				for ( i=m+1; i<=y; i++ ) F *= (a/i - s);
+			} else if ( m>y ) {
+				for ( i=y+1; i<=m; i++ ) F /= (a/i - s);
+			}
+			if ( v>F ) continue;
+			break;
+		}
+
+		// squeeze using upper and lower bounds on log(f(y))
+		rho = (k/nrq)*((k*(k/3.0 + 0.625) + 0.16666666666666666)/nrq + 0.5);
+		t = -k*k/(2*nrq);
+		A = log(v);
+		if ( A<t-rho ) break;
+		if ( A>t+rho ) continue;
+
+		// final acceptance/rejection test using Stirling's formula
+		x1 = y+1;
+		f1 = m+1;
+		z = n+1-m;
+		w = n-y+1;
+		x2 = x1*x1;
+		f2 = f1*f1;
+		z2 = z*z;
+		w2 = w*w;
+		if ( A > (xm*log(f1/x1)
+					+ (n-m+0.5)*log(z/w)
+					+ (y-m)*log(w*r/(x1*q))
+					+ (13680.-(462.-(132.-(99.-140./f2)/f2)/f2)/f2)/f1/166320.
+					+ (13680.-(462.-(132.-(99.-140./z2)/z2)/z2)/z2)/z/166320.
+					+ (13680.-(462.-(132.-(99.-140./x2)/x2)/x2)/x2)/x1/166320.
+					+ (13680.-(462.-(132.-(99.-140./w2)/w2)/w2)/w2)/w/166320.) )
+			continue;
+		break;
+	}
+
+	return y;
 }
 
 double GammaRandom::draw ( void )
@@ -334,10 +645,13 @@ double BetaRandom::draw ( void )
 }
 
 void setSeed(long int seedval){
-    unsigned long init[4]={0x123, 0x234, 0x345, 0x456}, length=4;
-    unsigned long k;
-
-    init_by_array(init, length);
-
-	for ( k = 0; k<seedval; k++ ) genrand_int32();
+	// The key for seedval==0 is the reference key of MT19937.
+	unsigned long long sd ( (unsigned long) seedval );
+	unsigned long init[4]={
+		(unsigned long) (0x123UL ^ (sd & 0xffffffffUL)),
+		(unsigned long) (0x234UL ^ (sd>>32)),
+		0x345UL,
+		0x456UL }, length=4;
+
+	defaultstream.init_by_array(init, length);
 }
@@ -8,15 +8,70 @@
 #include <cstdlib>
 #include <cmath>
 #include "errors.h"
+#include "checkpoint.h"
 
+#define PSI_MT_N 624
 
+/** \brief a stream of uniform random numbers
+ *
+ * Each stream is a Mersenne Twister (MT19937) generator with its own state. Streams do not share any data, so
+ * that different threads (or different MCMC chains) can draw from their own streams without locking. A stream
+ * is identified by a seed and a stream id; streams with the same seed but different stream ids are initialized
+ * from different keys and can be used as independent substreams of one analysis. Seeding takes constant time.
+ *
+ * If substreams should be guaranteed not to overlap, they can be derived from a common stream with jump(): the
+ * stream is copied and each copy skips a different multiple of 2^k numbers.
+ */
+class PsiRandomStream
+{
+	private:
+		unsigned long mt[PSI_MT_N];  // the array for the state vector
+		int mti;                     // mti==PSI_MT_N+1 means mt is not initialized
+	public:
+		PsiRandomStream ( void ) : mti ( PSI_MT_N+1 ) {}     ///< set up an uninitialized stream (it is seeded with the MT19937 default on first use)
+		PsiRandomStream (
+			unsigned long seedval,                            ///< seed of the analysis
+			unsigned long streamid=0                          ///< index of the substream
+			) { seed ( seedval, streamid ); }                 ///< set up substream streamid for seed seedval
+		void seed ( unsigned long seedval, unsigned long streamid=0 );     ///< reinitialize to substream streamid for seed seedval
+		/** skip the next 2^k random numbers
+		 *
+		 * For large k, this multiplies the state by a power of the transition matrix that is represented by its reduction
+		 * modulo the characteristic polynomial of MT19937. The polynomial for each k is computed once per process
+		 * (about k polynomial squarings) and shared between all streams; after that a jump costs about as much
+		 * as drawing 20000 random numbers.
+		 */
+		void jump ( unsigned int k );
+		void init_genrand ( unsigned long s );                             ///< initialize the state with a single 32 bit word (original MT19937 seeding)
+		void init_by_array ( unsigned long init_key[], int key_length );   ///< initialize the state with an array of 32 bit words (original MT19937 seeding)
+		unsigned long genrand_int32 ( void );                              ///< draw a random number on [0,0xffffffff]
+		double genrand_real2 ( void ) { return genrand_int32()*(1.0/4294967296.0); } ///< draw a random number on [0,1)
+		void saveState ( PsiCheckpointWriter * checkpoint ) const;         ///< write the state of the generator to a checkpoint
+		void loadState ( PsiCheckpointReader * checkpoint );               ///< continue from a state that was written by saveState()
+};
+
+/** \brief the stream that is used by all random number objects that have not been assigned a stream of their own */
+PsiRandomStream * getDefaultStream ( void );
+
+/** \brief base class for random numbers
+ *
+ * All random numbers are derived from the uniform numbers delivered by rngcall(). By default, these come from the process wide
+ * default stream. To draw random numbers in several threads, each thread should assign its own PsiRandomStream using setStream().
+ */
 class PsiRandom
 {
+	private:
+		PsiRandomStream * stream;
 	public:
-		PsiRandom ( void ) {}
-		double rngcall ( void );
+		PsiRandom ( void ) : stream ( NULL ) {}
+		virtual ~PsiRandom ( void ) {}
+		double rngcall ( void ) { return ( stream==NULL ? getDefaultStream() : stream )->genrand_real2(); }  ///< uniform random number on [0,1)
 		virtual double draw ( void ) { throw NotImplementedError(); }
 		virtual PsiRandom * clone ( void ) const {throw NotImplementedError(); }
+		virtual void setStream ( PsiRandomStream * newstream ) { stream = newstream; } ///< draw from newstream (not copied, not deleted) instead of the default stream; NULL reverts to the default stream
+		PsiRandomStream * getStream ( void ) const { return stream; }            ///< stream from which this object draws (NULL for the default stream)
+		virtual void saveState ( PsiCheckpointWriter * checkpoint ) const {}     ///< write numbers that were generated but not yet delivered (the stream is not written)
+		virtual void loadState ( PsiCheckpointReader * checkpoint ) {}           ///< restore numbers that were written by saveState()
 };
 
 class GaussRandom : public PsiRandom
@@ -30,9 +85,11 @@ class GaussRandom : public PsiRandom
 		double w;
 		double y;
 	public:
-		GaussRandom ( double mean=0, double standarddeviation=1 ) : mu ( mean ), sigma ( standarddeviation ), good ( false ) {}
+		GaussRandom ( double mean=0, double standarddeviation=1 ) : mu ( mean ), sigma ( standarddeviation ), good ( false ), x1 ( 0 ), x2 ( 0 ), w ( 0 ), y ( 0 ) {}
 		double draw ( void );              ///< draw a random number using box muller transform
 		PsiRandom * clone ( void ) const { return new GaussRandom(*this); }
+		void saveState ( PsiCheckpointWriter * checkpoint ) const;        ///< write the second number of the last box muller pair if it has not been used
+		void loadState ( PsiCheckpointReader * checkpoint );
 };
 
 class UniformRandom : public PsiRandom
@@ -46,11 +103,18 @@ class UniformRandom : public PsiRandom
 		PsiRandom * clone ( void ) const { return new UniformRandom(*this); }
 };
 
+/** \brief binomial random numbers
+ *
+ * Draws take expected constant time: for n*min(p,1-p)<=30, the distribution function is inverted by sequential
+ * search, otherwise the BTPE algorithm of Kachitvichyanukul & Schmeiser (1988) is used.
+ */
 class BinomialRandom : public PsiRandom
 {
 	private:
 		int n;
 		double p;
+		int draw_inversion ( int n, double p );   ///< sequential search of the distribution function, for n*p<=30 and p<=0.5
+		int draw_btpe ( int n, double p );        ///< triangle/parallelogram/exponential rejection, for n*p>30 and p<=0.5
 	public:
 		BinomialRandom ( int number, double probability ) : n(number), p(probability) {}
 		double draw ( void );
@@ -68,6 +132,9 @@ class GammaRandom : public PsiRandom
 		GammaRandom ( double shape, double scale ) : k (shape), theta(scale), grng() {}
 		double draw ( void );              ///< draw a random number
 		PsiRandom * clone ( void ) const { return new GammaRandom(*this); }
+		void setStream ( PsiRandomStream * newstream ) { PsiRandom::setStream ( newstream ); grng.setStream ( newstream ); }
+		void saveState ( PsiCheckpointWriter * checkpoint ) const { grng.saveState ( checkpoint ); }
+		void loadState ( PsiCheckpointReader * checkpoint ) { grng.loadState ( checkpoint ); }
 };
 
 class BetaRandom : public PsiRandom
@@ -81,9 +148,12 @@ class BetaRandom : public PsiRandom
 		BetaRandom ( double alpha, double beta ) : alpha(alpha), beta(beta), grnga (alpha, 1), grngb (beta, 1) {}
 		double draw ( void );              ///< draw a random number
 		PsiRandom * clone ( void ) const { return new BetaRandom(*this); }
+		void setStream ( PsiRandomStream * newstream ) { PsiRandom::setStream ( newstream ); grnga.setStream ( newstream ); grngb.setStream ( newstream ); }
+		void saveState ( PsiCheckpointWriter * checkpoint ) const { grnga.saveState ( checkpoint ); grngb.saveState ( checkpoint ); }
+		void loadState ( PsiCheckpointReader * checkpoint ) { grnga.loadState ( checkpoint ); grngb.loadState ( checkpoint ); }
 };
 
 
-void setSeed(long int seedval);
+void setSeed(long int seedval);  ///< reset the default stream to the state associated with seedval (constant time)
 
 #endif
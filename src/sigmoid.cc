@@ -37,6 +37,23 @@ double PsiLogistic::ddf ( double x ) const
 	return f(x)*(1-f(x))*(1-2*f(x));
 }
 
+void PsiLogistic::f_batch ( unsigned int n, const double * x, double * out ) const
+{
+	unsigned int i;
+	for ( i=0; i<n; i++ )
+		out[i] = 1./(1.+exp(-x[i]));
+}
+
+void PsiLogistic::df_batch ( unsigned int n, const double * x, double * out ) const
+{
+	unsigned int i;
+	double fx;
+	for ( i=0; i<n; i++ ) {
+		fx = 1./(1.+exp(-x[i]));
+		out[i] = fx*(1-fx);
+	}
+}
+
 /** Gauss Sigmoid *************************************************************/
 
 double PsiGauss::f ( double x ) const
@@ -250,4 +267,3 @@ double PsiExponential::inv ( double p ) const throw(BadArgumentError)
 	else
 		throw BadArgumentError("PsiExponential.inv is only valid in the range 0<x<1");
 }
-
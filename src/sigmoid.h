@@ -18,6 +18,8 @@ class PsiSigmoid
 		virtual double df  ( double x ) const { throw NotImplementedError(); }            ///< This should give the first derivative of the sigmoid
 		virtual double ddf ( double x ) const { throw NotImplementedError(); }            ///< This should give the second derivative of the sigmoid
 		virtual double inv ( double p ) const { throw NotImplementedError(); }            ///< This should give the inverse of the sigmoid (taking values between 0 and 1)
+		virtual void f_batch  ( unsigned int n, const double * x, double * out ) const { unsigned int i; for ( i=0; i<n; i++ ) out[i] = f ( x[i] ); }   ///< evaluate the sigmoid at n positions x (out may be x)
+		virtual void df_batch ( unsigned int n, const double * x, double * out ) const { unsigned int i; for ( i=0; i<n; i++ ) out[i] = df ( x[i] ); }  ///< evaluate the first derivative at n positions x (out may be x)
 		virtual int    getcode ( void ) const { throw NotImplementedError(); }            ///< return the sigmoid identifier
         virtual PsiSigmoid * clone ( void ) const { throw NotImplementedError(); }                ///< clone object by value
         static std::string getDescriptor ( void ) { throw NotImplementedError(); }///< get a short string that identifies the type of sigmoid
@@ -37,6 +39,8 @@ class PsiId : public PsiSigmoid
 		double df  ( double x ) const { return 1; }
 		double ddf ( double x ) const { return 0; }
 		double inv ( double x ) const { return x; }
+		void f_batch  ( unsigned int n, const double * x, double * out ) const { unsigned int i; for ( i=0; i<n; i++ ) out[i] = x[i]; }
+		void df_batch ( unsigned int n, const double * x, double * out ) const { unsigned int i; for ( i=0; i<n; i++ ) out[i] = 1; }
 		int getcode ( void ) const { return 6; }
 		PsiSigmoid * clone ( void ) const { return new PsiId(*this); }
 		static std::string getDescriptor ( void ) { return "id"; }
@@ -55,6 +59,8 @@ class PsiLogistic : public PsiSigmoid
 		double df ( double x ) const;                ///< derivative of the sigmoid at position x
 		double ddf ( double x ) const;               ///< second derivative of the sigmoid
 		double inv ( double p ) const { return log(p/(1-p)); }  ///< inverse of the sigmoid
+		void f_batch  ( unsigned int n, const double * x, double * out ) const;   ///< values of the sigmoid at n positions
+		void df_batch ( unsigned int n, const double * x, double * out ) const;   ///< derivatives of the sigmoid at n positions
 		int getcode ( void ) const { return 1; }     ///< return the sigmoid identifier
         PsiSigmoid * clone ( void ) const {
             return new PsiLogistic(*this);
@@ -0,0 +1,63 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#include "specialized.h"
+#include <cstdlib>
+
+/** select the core for a sigmoid type that is already known */
+template <class SigmoidType>
+static PsiPsychometric * allocateWithSigmoid ( const std::string& core, int nAFC, const PsiData* data )
+{
+	SigmoidType sigmoid;
+
+	if ( !core.compare ( abCore::getDescriptor() ) ) {
+		abCore psicore ( data );
+		return new SpecializedPsychometric<abCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( 0, 2, mwCore::getDescriptor() ) ) {
+		mwCore psicore ( data, sigmoid.getcode(), atof ( core.substr ( 2 ).c_str() ) );
+		return new SpecializedPsychometric<mwCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( linearCore::getDescriptor() ) ) {
+		linearCore psicore ( data );
+		return new SpecializedPsychometric<linearCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( logCore::getDescriptor() ) ) {
+		logCore psicore ( data );
+		return new SpecializedPsychometric<logCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( polyCore::getDescriptor() ) ) {
+		polyCore psicore ( data );
+		return new SpecializedPsychometric<polyCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( weibullCore::getDescriptor() ) ) {
+		weibullCore psicore ( data );
+		return new SpecializedPsychometric<weibullCore,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	} else if ( !core.compare ( NakaRushton::getDescriptor() ) ) {
+		NakaRushton psicore ( data );
+		return new SpecializedPsychometric<NakaRushton,SigmoidType> ( nAFC, &psicore, &sigmoid );
+	}
+
+	throw BadArgumentError ( "Unknown core" );
+}
+
+PsiPsychometric * allocateSpecializedPsychometric (
+		const std::string& core,
+		const std::string& sigmoid,
+		int nAFC,
+		const PsiData* data
+		) throw (BadArgumentError)
+{
+	if ( !sigmoid.compare ( PsiLogistic::getDescriptor() ) )
+		return allocateWithSigmoid<PsiLogistic> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiGauss::getDescriptor() ) )
+		return allocateWithSigmoid<PsiGauss> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiGumbelL::getDescriptor() ) )
+		return allocateWithSigmoid<PsiGumbelL> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiGumbelR::getDescriptor() ) )
+		return allocateWithSigmoid<PsiGumbelR> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiCauchy::getDescriptor() ) )
+		return allocateWithSigmoid<PsiCauchy> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiExponential::getDescriptor() ) )
+		return allocateWithSigmoid<PsiExponential> ( core, nAFC, data );
+	else if ( !sigmoid.compare ( PsiId::getDescriptor() ) )
+		return allocateWithSigmoid<PsiId> ( core, nAFC, data );
+
+	throw BadArgumentError ( "Unknown sigmoid" );
+}
@@ -0,0 +1,172 @@
+/*
+ *   See COPYING file distributed along with the psignifit package for
+ *   the copyright and license terms
+ */
+#ifndef SPECIALIZED_H
+#define SPECIALIZED_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include "psychometric.h"
+
+/** \brief core and sigmoid of known types for negllikeli_sweep()
+ *
+ * Same as PsiVirtualParts, but with qualified calls to CoreType and SigmoidType.
+ */
+template <class CoreType, class SigmoidType>
+struct PsiStaticParts
+{
+	const CoreType * core;
+	const SigmoidType * sigmoid;
+	PsiStaticParts ( const CoreType * c, const SigmoidType * s ) : core ( c ), sigmoid ( s ) {}
+	double g ( double x, const std::vector<double>& prm ) const { return core->CoreType::g ( x, prm ); }
+	double dg ( double x, const std::vector<double>& prm, int i ) const { return core->CoreType::dg ( x, prm, i ); }
+	double ddg ( double x, const std::vector<double>& prm, int i, int j ) const { return core->CoreType::ddg ( x, prm, i, j ); }
+	double f ( double z ) const { return sigmoid->SigmoidType::f ( z ); }
+	double df ( double z ) const { return sigmoid->SigmoidType::df ( z ); }
+	double ddf ( double z ) const { return sigmoid->SigmoidType::ddf ( z ); }
+};
+
+/** \brief psychometric function model specialized for a fixed core and sigmoid
+ *
+ * This model is the same as PsiPsychometric, but the types of the core and the sigmoid are known at compile time. All
+ * calls to the core and the sigmoid in the likelihood loops are qualified calls to CoreType and SigmoidType: They are
+ * resolved at compile time and can be inlined, instead of going through two or more virtual calls per block. The
+ * derivatives and the batch functions evaluate core and sigmoid only once per block and combine all terms in a single loop.
+ *
+ * Results are the same as those of a PsiPsychometric object with the same core and sigmoid. Objects are usually created
+ * by allocateSpecializedPsychometric() that selects the specialization from the descriptors of core and sigmoid.
+ */
+template <class CoreType, class SigmoidType>
+class SpecializedPsychometric : public PsiPsychometric
+{
+	private:
+		const CoreType * core;
+		const SigmoidType * sigmoid;
+	public:
+		SpecializedPsychometric (
+			int nAFC,                                                                ///< number of alternatives in the task (1 indicating yes/no)
+			CoreType * core,                                                         ///< internal part of the nonlinear function
+			SigmoidType * sigmoid                                                    ///< "external" saturating part of the nonlinear function
+			) : PsiPsychometric ( nAFC, core, sigmoid ),
+				core ( static_cast<const CoreType*> ( getCore() ) ),
+				sigmoid ( static_cast<const SigmoidType*> ( getSigmoid() ) ) {}    ///< Set up a psychometric function model for an nAFC task (nAFC=1 ~> yes/no)
+		~SpecializedPsychometric ( void ) {}
+		double evaluate ( double x, const std::vector<double>& prm ) const {
+			double guess ( getGuess ( prm ) );
+			return guess + (1-guess-prm[2]) * sigmoid->SigmoidType::f ( core->CoreType::g ( x, prm ) );
+		}                                                                            ///< Evaluate the psychometric function at this position
+		double negllikeli ( const std::vector<double>& prm, const PsiData* data ) const;                            ///< negative log likelihood
+		double deviance ( const std::vector<double>& prm, const PsiData* data ) const;                              ///< deviance for a given data set and parameter constellation
+		std::vector<double> dnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const;              ///< 1st derivative of the negative log likelihood
+		double negllikeli_derivatives ( const std::vector<double>& prm, const PsiData* data,
+				std::vector<double>* gradient, Matrix* hessian, Matrix* fisher=NULL ) const;                           ///< negative log likelihood and its derivatives in a single sweep over the data
+		std::vector<double> negllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const;  ///< negative log likelihoods for M parameter vectors at once
+		std::vector<double> deviance_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const;    ///< deviances for M parameter vectors at once
+		std::vector< std::vector<double> > dnegllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const;  ///< 1st derivatives of the negative log likelihood for M parameter vectors at once
+};
+
+/** \brief allocate a psychometric function model for a core and a sigmoid given by their descriptors
+ *
+ * The descriptors are the strings returned by getDescriptor() of the respective classes: "ab", "mw<alpha>" (e.g. "mw0.1"),
+ * "linear", "log", "poly", "weibull" and "NakaRushton" for the core and "logistic", "gauss", "gumbel_l", "gumbel_r", "cauchy",
+ * "exponential" and "id" for the sigmoid. The returned object is a SpecializedPsychometric for the respective combination
+ * and should be deleted by the caller.
+ */
+PsiPsychometric * allocateSpecializedPsychometric (
+		const std::string& core,                                                     ///< descriptor of the core
+		const std::string& sigmoid,                                                  ///< descriptor of the sigmoid
+		int nAFC,                                                                    ///< number of alternatives in the task (1 indicating yes/no)
+		const PsiData* data                                                          ///< data set used to initialize the core
+		) throw (BadArgumentError);
+
+////////////////////////////////// SpecializedPsychometric ///////////////////////////////////
+
+template <class CoreType, class SigmoidType>
+double SpecializedPsychometric<CoreType,SigmoidType>::negllikeli ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i, nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const int * k ( elements_of ( data->getNcorrect() ) );
+	const double * lognoverk ( elements_of ( data->getNoverK() ) );
+	double guess ( getGuess ( prm ) );
+	double scale ( 1-guess-prm[2] );
+	double l(0);
+
+	for ( i=0; i<nblocks; i++ )
+		l += binomial_negllikeli_term ( guess + scale * sigmoid->SigmoidType::f ( core->CoreType::g ( x[i], prm ) ), n[i], k[i], lognoverk[i] );
+
+	return l;
+}
+
+template <class CoreType, class SigmoidType>
+double SpecializedPsychometric<CoreType,SigmoidType>::deviance ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	unsigned int i, nblocks ( data->getNblocks() );
+	const double * x ( elements_of ( data->getIntensities() ) );
+	const int * n ( elements_of ( data->getNtrials() ) );
+	const double * y ( elements_of ( data->getPcorrect() ) );
+	double guess ( getGuess ( prm ) );
+	double scale ( 1-guess-prm[2] );
+	double D(0);
+
+	for ( i=0; i<nblocks; i++ )
+		D += binomial_deviance_term ( guess + scale * sigmoid->SigmoidType::f ( core->CoreType::g ( x[i], prm ) ), n[i], y[i] );
+
+	return D;
+}
+
+template <class CoreType, class SigmoidType>
+std::vector<double> SpecializedPsychometric<CoreType,SigmoidType>::dnegllikeli ( const std::vector<double>& prm, const PsiData* data ) const
+{
+	std::vector<double> gradient;
+	SpecializedPsychometric<CoreType,SigmoidType>::negllikeli_derivatives ( prm, data, &gradient, NULL );
+	return gradient;
+}
+
+template <class CoreType, class SigmoidType>
+double SpecializedPsychometric<CoreType,SigmoidType>::negllikeli_derivatives ( const std::vector<double>& prm, const PsiData* data,
+		std::vector<double>* gradient, Matrix* hessian, Matrix* fisher ) const
+{
+	return negllikeli_sweep ( PsiStaticParts<CoreType,SigmoidType> ( core, sigmoid ), prm, data, getGuess ( prm ), PsiPsychometric::getNparams(), gradient, hessian, fisher );
+}
+
+template <class CoreType, class SigmoidType>
+std::vector<double> SpecializedPsychometric<CoreType,SigmoidType>::negllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m;
+	std::vector<double> out ( prm.size() );
+
+	for ( m=0; m<prm.size(); m++ )
+		out[m] = SpecializedPsychometric<CoreType,SigmoidType>::negllikeli ( prm[m], data );
+
+	return out;
+}
+
+template <class CoreType, class SigmoidType>
+std::vector<double> SpecializedPsychometric<CoreType,SigmoidType>::deviance_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m;
+	std::vector<double> out ( prm.size() );
+
+	for ( m=0; m<prm.size(); m++ )
+		out[m] = SpecializedPsychometric<CoreType,SigmoidType>::deviance ( prm[m], data );
+
+	return out;
+}
+
+template <class CoreType, class SigmoidType>
+std::vector< std::vector<double> > SpecializedPsychometric<CoreType,SigmoidType>::dnegllikeli_batch ( const std::vector< std::vector<double> >& prm, const PsiData* data ) const
+{
+	unsigned int m;
+	std::vector< std::vector<double> > out ( prm.size() );
+
+	for ( m=0; m<prm.size(); m++ )
+		out[m] = SpecializedPsychometric<CoreType,SigmoidType>::dnegllikeli ( prm[m], data );
+
+	return out;
+}
+
+#endif
@@ -8,13 +8,15 @@
 #   the copyright and license terms
 #
 ######################################################################
+import ctypes
 import numpy as np
 import swignifit.swignifit_raw as sfr
 import swignifit.utility as sfu
 import operator as op
 
 def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
-        core="ab", priors=None, cuts=None, parametric=True, gammaislambda=False ):
+        core="ab", priors=None, cuts=None, parametric=True, gammaislambda=False,
+        nthreads=1, report=False ):
     """ Parametric bootstrap of a psychometric function.
 
     Parameters
@@ -28,8 +30,10 @@ def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
 
     start : sequence of floats of length number of model parameters
         Generating values for the bootstrap samples. If this is None, the
-        generating value will be the MAP estimate. Length should be 4 for Yes/No
-        and 3 for nAFC.
+        generating value will be the MAP estimate. The bootstrap then fits the
+        data itself, so that the fits of the samples start with the simplex
+        increments of the initial grid search (the fit cache is only used for
+        the jackknife). Length should be 4 for Yes/No and 3 for nAFC.
 
     nsamples : number
         Number of bootstrap samples to be drawn.
@@ -78,13 +82,19 @@ def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
     gammaislambda : boolean
         Set the gamma == lambda prior.
 
+    nthreads : int
+        Number of worker threads that fit the bootstrap samples.
+
+    report : boolean
+        If `True`, a report on the fits is appended to the return values.
+
     Returns
     -------
 
     (samples,estimates,deviance,
     threshold, th_bias, th_acceleration,
     slope, slope_bias, slope_accelerateion
-    Rkd,Rpd,outliers,influential)
+    Rkd,Rpd,outliers,influential[,optimizer])
 
     samples : numpy array, shape: (nsamples, nblocks)
         the bootstrap sampled data
@@ -125,6 +135,11 @@ def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
     influential : numpy array of booleans, length nblocks
         points that are influential observations
 
+    optimizer : dict (only if report is `True`)
+        'bootstrap' and 'jackknife' hold the summed reports of all fits
+        (see `swignifit.utility.optimizer_report`), 'samples' holds the
+        reports of the individual bootstrap samples
+
     Example
     -------
     >>> x = [float(2*k) for k in xrange(6)]
@@ -144,30 +159,23 @@ def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
 
     cuts = sfu.get_cuts(cuts)
     ncuts = len(cuts)
+    estimate = sfu.cached_fit(dataset, pmf, sigmoid, core, priors, gammaislambda)
     if start is not None:
         start = sfu.get_start(start, nparams)
 
-    bs_list = sfr.bootstrap(nsamples, dataset, pmf, cuts, start, True, parametric)
-    jk_list = sfr.jackknifedata(dataset, pmf)
+    bs_list = sfr.bootstrap(nsamples, dataset, pmf, cuts, start, True, parametric, nthreads)
+    jk_list = sfr.jackknifedata(dataset, pmf, sfr.OPTIMIZER_SIMPLEX, estimate)
 
     nblocks = dataset.getNblocks()
 
-    # construct the massive tuple of return values
-    samples = np.zeros((nsamples, nblocks), dtype=np.int32)
-    estimates = np.zeros((nsamples, nparams))
-    deviance = np.zeros((nsamples))
-    thres = np.zeros((nsamples, ncuts))
-    slope = np.zeros((nsamples, ncuts))
-    Rpd = np.zeros((nsamples))
-    Rkd = np.zeros((nsamples))
-    for row_index in xrange(nsamples):
-        samples[row_index] = bs_list.getData(row_index)
-        estimates[row_index] = bs_list.getEst(row_index)
-        deviance[row_index] = bs_list.getdeviance(row_index)
-        thres[row_index] = [bs_list.getThres_byPos(row_index, j) for j in xrange(ncuts)]
-        slope[row_index] = [bs_list.getSlope_byPos(row_index, j) for j in xrange(ncuts)]
-        Rpd[row_index] = bs_list.getRpd(row_index)
-        Rkd[row_index] = bs_list.getRkd(row_index)
+    # construct the massive tuple of return values (views of the buffers of bs_list)
+    samples = sfu.buffer_array(bs_list, bs_list.getDataBuffer(), (nsamples, nblocks), ctypes.c_int)
+    estimates = sfu.buffer_array(bs_list, bs_list.getEstBuffer(), (nsamples, nparams))
+    deviance = sfu.buffer_array(bs_list, bs_list.getDevianceBuffer(), (nsamples,))
+    thres = sfu.buffer_array(bs_list, bs_list.getThresBuffer(), (nsamples, ncuts))
+    slope = sfu.buffer_array(bs_list, bs_list.getSlopeBuffer(), (nsamples, ncuts))
+    Rpd = sfu.buffer_array(bs_list, bs_list.getRpdBuffer(), (nsamples,))
+    Rkd = sfu.buffer_array(bs_list, bs_list.getRkdBuffer(), (nsamples,))
 
     thacc = np.zeros((ncuts))
     thbias = np.zeros((ncuts))
@@ -193,10 +201,17 @@ def bootstrap(data, start=None, nsamples=2000, nafc=2, sigmoid="logistic",
         outliers[block] = jk_list.outlier(block)
         influential[block] = jk_list.influential(block, ci_lower, ci_upper)
 
+    if report:
+        optimizer = { 'bootstrap' : sfu.optimizer_report ( bs_list.getOptimizerTotal() ),
+                'jackknife' : sfu.optimizer_report ( jk_list.getOptimizerTotal() ),
+                'samples' : [sfu.optimizer_report ( bs_list.getOptimizerReport(i) ) for i in xrange(nsamples)] }
+        return samples, estimates, deviance, thres, thbias, thacc, slope, slbias, slacc, Rpd, Rkd, outliers, influential, optimizer
+
     return samples, estimates, deviance, thres, thbias, thacc, slope, slbias, slacc, Rpd, Rkd, outliers, influential
 
 def mcmc( data, start=None, nsamples=10000, nafc=2, sigmoid='logistic',
-        core='mw0.1', priors=None, stepwidths=None, sampler="MetropolisHastings", gammaislambda=False):
+        core='mw0.1', priors=None, stepwidths=None, sampler="MetropolisHastings", gammaislambda=False,
+        burnin=0, thin=1):
     """ Markov Chain Monte Carlo sampling for a psychometric function.
 
     Parameters
@@ -268,6 +283,17 @@ def mcmc( data, start=None, nsamples=10000, nafc=2, sigmoid='logistic',
     gammaislambda : boolean
         Set the gamma == lambda prior.
 
+    burnin : int
+        Number of samples at the start of the chain that are discarded by the
+        sampler. No posterior predictives or diagnostics are determined for
+        them.
+
+    thin : int
+        Only every thin-th sample of the chain is kept. In total,
+        burnin+nsamples*thin samples are drawn.
+        The EnsembleSampler moves all its walkers burnin+nsamples*thin
+        times and returns nsamples samples for each walker.
+
 
     Output
     ------
@@ -332,15 +358,16 @@ def mcmc( data, start=None, nsamples=10000, nafc=2, sigmoid='logistic',
         start = sfu.get_start(start, nparams)
     else:
         # use mapestimate
-        opt = sfr.PsiOptimizer(pmf, dataset)
-        start = opt.optimize(pmf, dataset)
+        start = sfu.cached_fit(dataset, pmf, sigmoid, core, priors, gammaislambda)
 
     proposal = sfr.GaussRandom()
     if sampler not in sfu.sampler_dict.keys():
         raise sfu.PsignifitException("The sampler: " + sampler + " is not available.")
+    elif sampler in ("NUTS", "EnsembleSampler"):
+        # these samplers do not use a proposal distribution
+        sampler  = sfu.sampler_dict[sampler](pmf, dataset)
     else:
         sampler  = sfu.sampler_dict[sampler](pmf, dataset, proposal)
-    sampler.setTheta(start)
 
     if stepwidths != None:
         stepwidths = np.array(stepwidths)
@@ -362,28 +389,23 @@ def mcmc( data, start=None, nsamples=10000, nafc=2, sigmoid='logistic',
             else:
                 sampler.setStepSize(sfr.vector_double(stepwidths))
 
-    post = sampler.sample(nsamples)
+    # the EnsembleSampler places its walkers around start with the step sizes
+    # that are set at this point
+    sampler.setTheta(start)
+
+    post = sampler.sample(nsamples, burnin, thin)
+    # the EnsembleSampler stores nsamples samples for each walker
+    nsamples = post.getNsamples()
 
     nblocks = dataset.getNblocks()
 
-    estimates = np.zeros((nsamples, nparams))
-    deviance = np.zeros(nsamples)
-    posterior_predictive_data = np.zeros((nsamples, nblocks))
-    posterior_predictive_deviances = np.zeros(nsamples)
-    posterior_predictive_Rpd = np.zeros(nsamples)
-    posterior_predictive_Rkd = np.zeros(nsamples)
-    logposterior_ratios = np.zeros((nsamples, nblocks))
-
-    for i in xrange(nsamples):
-        for j in xrange(nparams):
-            estimates[i, j] = post.getEst(i, j)
-        deviance[i] = post.getdeviance(i)
-        for j in xrange(nblocks):
-            posterior_predictive_data[i, j] = post.getppData(i, j)
-            logposterior_ratios[i,j] = post.getlogratio(i,j)
-        posterior_predictive_deviances[i] = post.getppDeviance(i)
-        posterior_predictive_Rpd[i] = post.getppRpd(i)
-        posterior_predictive_Rkd[i] = post.getppRkd(i)
+    estimates = sfu.buffer_array(post, post.getEstBuffer(), (nsamples, nparams))
+    deviance = sfu.buffer_array(post, post.getDevianceBuffer(), (nsamples,))
+    posterior_predictive_data = sfu.buffer_array(post, post.getppDataBuffer(), (nsamples, nblocks), ctypes.c_int).astype(float)
+    posterior_predictive_deviances = sfu.buffer_array(post, post.getppDevianceBuffer(), (nsamples,))
+    posterior_predictive_Rpd = sfu.buffer_array(post, post.getppRpdBuffer(), (nsamples,))
+    posterior_predictive_Rkd = sfu.buffer_array(post, post.getppRkdBuffer(), (nsamples,))
+    logposterior_ratios = sfu.buffer_array(post, post.getlogratioBuffer(), (nsamples, nblocks))
 
     accept_rate = post.get_accept_rate()
 
@@ -392,7 +414,7 @@ def mcmc( data, start=None, nsamples=10000, nafc=2, sigmoid='logistic',
         posterior_predictive_Rkd, logposterior_ratios, accept_rate)
 
 def mapestimate ( data, nafc=2, sigmoid='logistic', core='ab', priors=None,
-        cuts = None, start=None, gammaislambda=False):
+        cuts = None, start=None, gammaislambda=False, report=False):
     """ MAP or constrained maximum likelihood estimation for a psychometric function.
 
     Parameters
@@ -447,12 +469,17 @@ def mapestimate ( data, nafc=2, sigmoid='logistic', core='ab', priors=None,
 
     start : sequence of floats of length number of model parameters
         Values at which to start the optimization, if None the starting value is
-        determined using a coarse grid search.
+        determined using a coarse grid search. If None, the estimate is taken
+        from the fit cache if possible (see `swignifit.utility.set_fitcache`).
+
+    report : boolean
+        If `True`, a report on the fit is appended to the output. The model
+        is fitted even if the estimate is in the fit cache.
 
     Output
     ------
 
-    estimate, fisher, thres, slope, deviance
+    estimate, fisher, thres, slope, deviance[, optimizer]
 
     estimate : numpy array length nparams
         the map/cml estimate
@@ -469,6 +496,9 @@ def mapestimate ( data, nafc=2, sigmoid='logistic', core='ab', priors=None,
     deviance : numpy array length 1
         the deviance for the estimate
 
+    optimizer : dict (only if report is `True`)
+        report on the fit (see `swignifit.utility.optimizer_report`)
+
     Example
     -------
     >>> x = [float(2*k) for k in xrange(6)]
@@ -489,9 +519,13 @@ def mapestimate ( data, nafc=2, sigmoid='logistic', core='ab', priors=None,
 
     cuts = sfu.get_cuts(cuts)
 
-    opt = sfr.PsiOptimizer(pmf, dataset)
-    estimate = opt.optimize(pmf, dataset, sfu.get_start(start, nparams) if start is not
-            None else None)
+    optreport = sfr.PsiOptimizerReport()
+    if start is None and not report:
+        estimate = sfu.cached_fit(dataset, pmf, sigmoid, core, priors, gammaislambda)
+    else:
+        opt = sfr.PsiOptimizer(pmf, dataset)
+        estimate = opt.optimize(pmf, dataset, sfu.get_start(start, nparams) if start is not
+                None else None, optreport)
     H = pmf.ddnegllikeli(estimate, dataset)
     thres = [pmf.getThres(estimate, c) for c in cuts]
     slope = [pmf.getSlope(estimate, th) for th in thres]
@@ -506,6 +540,9 @@ def mapestimate ( data, nafc=2, sigmoid='logistic', core='ab', priors=None,
     slope = np.array(slope)
     deviance = np.array(deviance)
 
+    if report:
+        return estimate, fisher, thres, slope, deviance, sfu.optimizer_report ( optreport )
+
     return estimate, fisher, thres, slope, deviance
 
 def diagnostics(data, params, nafc=2, sigmoid='logistic', core='ab', cuts=None, gammaislambda=False):
@@ -644,20 +681,22 @@ def asir ( data, nsamples=2000, nafc=2, sigmoid="logistic",
         core="mw0.1", priors=None, gammaislambda=False, propose=25 ):
     dataset, pmf, nparams = sfu.make_dataset_and_pmf ( data, nafc, sigmoid, core, priors, gammaislambda=gammaislambda )
 
-    posterior = sfr.independent_marginals ( pmf, dataset )
+    estimate = sfu.cached_fit ( dataset, pmf, sigmoid, core, priors, gammaislambda )
+    posterior = sfr.independent_marginals ( pmf, dataset, sfr.OPTIMIZER_SIMPLEX, estimate )
     if nsamples > 0:
         samples   = sfr.sample_posterior ( pmf, dataset, posterior, nsamples, propose )
         sfr.sample_diagnostics ( pmf, dataset, samples )
 
-        out = {'mcestimates': np.array( [ [samples.getEst ( i, par ) for par in xrange ( nparams ) ] for i in xrange ( nsamples )]),
-            'mcdeviance': np.array( [ samples.getdeviance ( i ) for i in xrange ( nsamples ) ] ),
-            'mcRpd':                    np.array ( [ samples.getRpd ( i ) for i in xrange ( nsamples ) ] ),
-            'mcRkd':                    np.array ( [ samples.getRkd ( i ) for i in xrange ( nsamples ) ] ),
-            'posterior_predictive_data': np.array ( [ samples.getppData ( i ) for i in xrange ( nsamples ) ] ),
-            'posterior_predictive_deviance': np.array ( [ samples.getppDeviance ( i ) for i in xrange ( nsamples ) ] ),
-            'posterior_predictive_Rpd': np.array ( [ samples.getppRpd ( i ) for i in xrange ( nsamples ) ] ),
-            'posterior_predictive_Rkd': np.array ( [ samples.getppRkd ( i ) for i in xrange ( nsamples ) ] ),
-            'logposterior_ratios':      np.array ( [ [samples.getlogratio ( i,j ) for j in xrange(len(data)) ] for i in xrange ( nsamples ) ] ),
+        nblocks = dataset.getNblocks()
+        out = {'mcestimates': sfu.buffer_array ( samples, samples.getEstBuffer (), (nsamples, nparams) ),
+            'mcdeviance': sfu.buffer_array ( samples, samples.getDevianceBuffer (), (nsamples,) ),
+            'mcRpd':                    sfu.buffer_array ( samples, samples.getRpdBuffer (), (nsamples,) ),
+            'mcRkd':                    sfu.buffer_array ( samples, samples.getRkdBuffer (), (nsamples,) ),
+            'posterior_predictive_data': sfu.buffer_array ( samples, samples.getppDataBuffer (), (nsamples, nblocks), ctypes.c_int ),
+            'posterior_predictive_deviance': sfu.buffer_array ( samples, samples.getppDevianceBuffer (), (nsamples,) ),
+            'posterior_predictive_Rpd': sfu.buffer_array ( samples, samples.getppRpdBuffer (), (nsamples,) ),
+            'posterior_predictive_Rkd': sfu.buffer_array ( samples, samples.getppRkdBuffer (), (nsamples,) ),
+            'logposterior_ratios':      sfu.buffer_array ( samples, samples.getlogratioBuffer (), (nsamples, nblocks) ),
             'duplicates':               samples.get_accept_rate (),
             'posterior_approximations_py': [posterior.get_posterior(i) for i in xrange ( nparams ) ],
             'posterior_approximations_str': [r"$\mathcal{N}(%.2f,%.2f)$" % (posterior.get_posterior(0).getprm(0),posterior.get_posterior(0).getprm(1)),
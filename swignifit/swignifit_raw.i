@@ -35,6 +35,7 @@ using std::ptrdiff_t;
 namespace std {
     %template(vector_double) vector<double>;
     %template(vector_int) vector<int>;
+    %template(vector_vector_double) vector< vector<double> >;
 };
 
 // include methods for dealing with double pointers
@@ -52,6 +53,9 @@ namespace std {
 
 %include "std_string.i"
 
+// internal helper of the likelihood computations
+%ignore PsiVirtualParts;
+
 // we need to ignore the second constructor for PsiData since swig can't handle
 // this type of overloading TODO write a factory method in python that
 // implements this functionality
@@ -74,3 +78,7 @@ namespace std {
 %include "linalg.h"
 %include "getstart.h"
 %include "integrate.h"
+%include "specialized.h"
+%include "fitcache.h"
+%include "mcsummary.h"
+%include "checkpoint.h"
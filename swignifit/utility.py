@@ -15,6 +15,7 @@ __docformat__ = "restructuredtext"
 
 import operator as op
 import re
+import ctypes
 import numpy as np
 import swignifit_raw as sfr
 
@@ -163,6 +164,43 @@ def make_dataset_and_pmf(data, nafc, sigmoid, core, priors, gammaislambda=False
     pmf, nparams = make_pmf(dataset, nafc, sigmoid, core, priors, gammaislambda)
     return dataset, pmf, nparams
 
+# MAP estimates of all analyses in this session
+fitcache = sfr.PsiFitCache()
+
+def set_fitcache(filename=""):
+    """Replace the cache of MAP estimates.
+
+    Parameters
+    ----------
+    filename : string
+        File that backs the cache. Estimates that are already stored in this
+        file are available immediately, new estimates are appended. If empty,
+        estimates are only cached for the current session.
+
+    """
+    global fitcache
+    fitcache = sfr.PsiFitCache(filename)
+
+def cached_fit(dataset, pmf, sigmoid, core, priors, gammaislambda=False):
+    """Get the MAP estimate from the fit cache or fit the model.
+
+    Parameters
+    ----------
+    see: make_dataset_and_pmf
+
+    Returns
+    -------
+    estimate : vector_double
+        MAP estimate.
+
+    """
+    if priors is None:
+        priorstring = "None"
+    else:
+        priorstring = ",".join([str(p) for p in priors])
+    key = sfr.PsiFitCache.makekey(dataset, str(core), str(sigmoid), gammaislambda, priorstring, sfr.OPTIMIZER_SIMPLEX)
+    return fitcache.fit(key, pmf, dataset, sfr.OPTIMIZER_SIMPLEX)
+
 def get_sigmoid(descriptor):
     """Convert string representation of sigmoid to PsiSigmoid object.
 
@@ -398,3 +436,61 @@ def make_pilotsample ( mcsamples ):
     for i in xrange ( N ):
         pilot.setEst ( i, mcsamples[i,:], -1 )
     return pilot
+
+def buffer_array ( owner, pointer, shape, ctype=ctypes.c_double ):
+    """wrap a buffer of a sample list as an array without copying
+
+    Parameters
+    ----------
+    owner : PsiMClist
+        list that owns the buffer. The array keeps a reference to it.
+    pointer : swig pointer
+        as returned by one of the get...Buffer() methods of the list
+    shape : tuple
+        shape of the buffer (buffers are row major with one row per sample)
+    ctype : ctypes type
+        ctypes.c_double for double buffers, ctypes.c_int for int buffers
+
+    Returns
+    -------
+    array : numpy array
+        read only view of the buffer (use copy() to modify the values)
+    """
+    n = int ( np.prod ( shape ) )
+    if n == 0:
+        arr = np.zeros ( shape, dtype=np.dtype ( ctype ) )
+    else:
+        buf = ( ctype * n ).from_address ( int ( pointer ) )
+        buf._owner = owner
+        arr = np.ctypeslib.as_array ( buf ).reshape ( shape )
+    # writing to the view would silently change the samples that the list reports
+    arr.flags.writeable = False
+    return arr
+
+def optimizer_report ( report ):
+    """convert a PsiOptimizerReport to a dictionary
+
+    Parameters
+    ----------
+    report : PsiOptimizerReport
+        report of one or more fits
+
+    Returns
+    -------
+    report : dict
+        with keys 'nevaluations', 'ngradients', 'niterations', 'nshrinks',
+        'simplexsize', 'fspread', 'walltime' and 'termination'. Termination
+        is one of 'simplexsize', 'fvalues', 'maxiter' and 'decrease'.
+    """
+    terminations = { sfr.TERMINATION_SIMPLEXSIZE : 'simplexsize',
+            sfr.TERMINATION_FVALUES : 'fvalues',
+            sfr.TERMINATION_MAXITER : 'maxiter',
+            sfr.TERMINATION_DECREASE : 'decrease' }
+    return { 'nevaluations' : report.nevaluations,
+            'ngradients' : report.ngradients,
+            'niterations' : report.niterations,
+            'nshrinks' : report.nshrinks,
+            'simplexsize' : report.simplexsize,
+            'fspread' : report.fspread,
+            'walltime' : report.walltime,
+            'termination' : terminations[report.termination] }
@@ -85,3 +85,11 @@ class TestUtility(ut.TestCase):
         # operator.isNumberType() on an ndarry is always true
         cuts = np.array([1.0, 2.0, 3.0])
         sfu.get_cuts(cuts)
+
+    def test_buffer_array_read_only(self):
+        samples = sfr.MCMCList(10, 3, 6)
+        estimates = sfu.buffer_array(samples, samples.getEstBuffer(), (10, 3))
+        self.assertEqual((10, 3), estimates.shape)
+        self.assertFalse(estimates.flags.writeable)
+        self.assertRaises((ValueError, RuntimeError), estimates.__setitem__, (0, 0), 1.)
+        self.assertFalse(sfu.buffer_array(samples, None, (0, 3)).flags.writeable)
@@ -34,7 +34,11 @@ psipp_sources = [
     "src/linalg.cc",
     "src/getstart.cc",
     "src/prior.cc",
-    "src/integrate.cc"]
+    "src/integrate.cc",
+    "src/specialized.cc",
+    "src/fitcache.cc",
+    "src/mcsummary.cc",
+    "src/checkpoint.cc"]
 
 # swignifit interface, override the definition in `setup.py`
 swignifit = Extension('swignifit._swignifit_raw',